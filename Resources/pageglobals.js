@@ -1,4 +1,4 @@
-function quasar_authenticate(socket) {
+function quasar_authenticate(socket, encoding) {
     var auth = {
         method: "auth",
         params: {
@@ -6,9 +6,409 @@ function quasar_authenticate(socket) {
         }
     };
 
+    if (encoding) {
+        auth.params.encoding = encoding;
+
+        if (encoding === "cbor") {
+            socket.binaryType = "arraybuffer";
+        }
+    }
+
     socket.send(JSON.stringify(auth));
 }
 
+function quasar_channel_available() {
+    return typeof QWebChannel !== "undefined" && typeof qt !== "undefined" && !!qt.webChannelTransport;
+}
+
+function quasar_channel_transport(callback) {
+    // A page has a single channel, shared by every socket it creates
+    if (quasar_channel_transport.transport) {
+        callback(quasar_channel_transport.transport);
+        return;
+    }
+
+    if (quasar_channel_transport.pending) {
+        quasar_channel_transport.pending.push(callback);
+        return;
+    }
+
+    quasar_channel_transport.pending = [callback];
+
+    new QWebChannel(qt.webChannelTransport, function (channel) {
+        var transport = channel.objects.quasar;
+        var pending = quasar_channel_transport.pending;
+        var i;
+
+        function deliver(type, init) {
+            var socket = quasar_channel_transport.current;
+            if (socket) {
+                socket.dispatch(type, init);
+            }
+        }
+
+        transport.textMessage.connect(function (msg) {
+            deliver("message", { data: msg });
+        });
+
+        transport.binaryMessage.connect(function (b64) {
+            var raw = atob(b64);
+            var bytes = new Uint8Array(raw.length);
+            for (var j = 0; j < raw.length; j++) {
+                bytes[j] = raw.charCodeAt(j);
+            }
+            deliver("message", { data: bytes.buffer });
+        });
+
+        transport.closed.connect(function (reason) {
+            var socket = quasar_channel_transport.current;
+            if (socket) {
+                quasar_channel_transport.current = null;
+                socket.readyState = 3;
+                socket.dispatch("close", { code: 1000, reason: reason, wasClean: true });
+            }
+        });
+
+        quasar_channel_transport.transport = transport;
+        quasar_channel_transport.pending = null;
+
+        for (i = 0; i < pending.length; i++) {
+            pending[i](transport);
+        }
+    });
+}
+
+// WebSocket look-alike passing messages through the page's QWebChannel
+function QuasarChannelSocket() {
+    var self = this;
+
+    this.readyState = 0;
+    this.binaryType = "blob";
+    this.onopen = null;
+    this.onmessage = null;
+    this.onerror = null;
+    this.onclose = null;
+    this.listeners = {};
+
+    quasar_channel_transport(function (transport) {
+        if (self.readyState !== 0) {
+            return;
+        }
+
+        var previous = quasar_channel_transport.current;
+        if (previous) {
+            previous.readyState = 3;
+            previous.dispatch("close", { code: 1000, reason: "Replaced", wasClean: true });
+        }
+
+        self.transport = transport;
+        quasar_channel_transport.current = self;
+        transport.open();
+
+        self.readyState = 1;
+
+        // The transport may be handed over synchronously, so open is deferred like a real
+        // WebSocket's to let the caller set onopen first
+        setTimeout(function () {
+            if (self.readyState === 1) {
+                self.dispatch("open", {});
+            }
+        }, 0);
+    });
+}
+
+QuasarChannelSocket.prototype.dispatch = function (type, init) {
+    var evt = Object.assign({ type: type, target: this }, init);
+    var handler = this["on" + type];
+    var list = this.listeners[type] || [];
+
+    if (handler) {
+        handler.call(this, evt);
+    }
+
+    for (var i = 0; i < list.length; i++) {
+        list[i].call(this, evt);
+    }
+};
+
+QuasarChannelSocket.prototype.addEventListener = function (type, listener) {
+    (this.listeners[type] = this.listeners[type] || []).push(listener);
+};
+
+QuasarChannelSocket.prototype.removeEventListener = function (type, listener) {
+    var list = this.listeners[type] || [];
+    var idx = list.indexOf(listener);
+    if (idx >= 0) {
+        list.splice(idx, 1);
+    }
+};
+
+QuasarChannelSocket.prototype.send = function (data) {
+    if (this.readyState !== 1) {
+        throw new Error("Quasar channel is not open");
+    }
+
+    if (typeof data !== "string") {
+        if (!QuasarChannelSocket.decoder) {
+            QuasarChannelSocket.decoder = new TextDecoder("utf-8");
+        }
+        data = QuasarChannelSocket.decoder.decode(data);
+    }
+
+    this.transport.send(data);
+};
+
+QuasarChannelSocket.prototype.close = function () {
+    if (this.readyState === 3) {
+        return;
+    }
+
+    if (this.readyState === 1 && quasar_channel_transport.current === this) {
+        quasar_channel_transport.current = null;
+        this.transport.close();
+    }
+
+    this.readyState = 3;
+    this.dispatch("close", { code: 1000, reason: "", wasClean: true });
+};
+
 function quasar_create_websocket() {
-    return new WebSocket("wss://127.0.0.1:%1");
+    // Widgets hosted by Quasar talk to the Data Server in-process when they can
+    if (quasar_channel_available()) {
+        return new QuasarChannelSocket();
+    }
+
+    return new WebSocket("%3://127.0.0.1:%1");
+}
+
+function quasar_send(socket, msg) {
+    // The channel carries strings, so there is nothing to gain from encoding
+    if (socket instanceof QuasarChannelSocket) {
+        socket.send(JSON.stringify(msg));
+        return;
+    }
+
+    // Binary UTF-8 frames are parsed by the Data Server without decoding them to text first
+    if (!quasar_send.encoder) {
+        quasar_send.encoder = new TextEncoder();
+    }
+
+    socket.send(quasar_send.encoder.encode(JSON.stringify(msg)));
+}
+
+function quasar_decode_cbor(buffer) {
+    var view = new DataView(buffer);
+    var utf8 = new TextDecoder("utf-8");
+    var offset = 0;
+
+    function readLength(info) {
+        var val;
+
+        if (info < 24) {
+            return info;
+        }
+
+        switch (info) {
+            case 24:
+                val = view.getUint8(offset);
+                offset += 1;
+                return val;
+            case 25:
+                val = view.getUint16(offset);
+                offset += 2;
+                return val;
+            case 26:
+                val = view.getUint32(offset);
+                offset += 4;
+                return val;
+            case 27:
+                val = view.getUint32(offset) * 4294967296 + view.getUint32(offset + 4);
+                offset += 8;
+                return val;
+        }
+
+        throw new Error("Unsupported CBOR length encoding " + info);
+    }
+
+    function readHalf() {
+        var half = view.getUint16(offset);
+        var exp = (half >> 10) & 0x1f;
+        var mant = half & 0x3ff;
+        var val;
+
+        offset += 2;
+
+        if (exp === 0) {
+            val = mant * Math.pow(2, -24);
+        } else if (exp !== 31) {
+            val = (mant + 1024) * Math.pow(2, exp - 25);
+        } else {
+            val = (mant === 0) ? Infinity : NaN;
+        }
+
+        return (half & 0x8000) ? -val : val;
+    }
+
+    function readTypedArray(tag, bytes) {
+        // copy out of the frame so that the typed array is properly aligned
+        var copy = bytes.slice().buffer;
+
+        switch (tag) {
+            case 78:
+                return new Int32Array(copy);
+            case 85:
+                return new Float32Array(copy);
+            case 86:
+                return new Float64Array(copy);
+        }
+
+        return bytes;
+    }
+
+    function readItem() {
+        var initial = view.getUint8(offset++);
+        var major = initial >> 5;
+        var info = initial & 0x1f;
+        var len, i, val;
+
+        switch (major) {
+            case 0:
+                return readLength(info);
+            case 1:
+                return -1 - readLength(info);
+            case 2:
+                len = readLength(info);
+                val = new Uint8Array(buffer, offset, len);
+                offset += len;
+                return val;
+            case 3:
+                len = readLength(info);
+                val = utf8.decode(new Uint8Array(buffer, offset, len));
+                offset += len;
+                return val;
+            case 4:
+                len = readLength(info);
+                val = new Array(len);
+                for (i = 0; i < len; i++) {
+                    val[i] = readItem();
+                }
+                return val;
+            case 5:
+                len = readLength(info);
+                val = {};
+                for (i = 0; i < len; i++) {
+                    var key = readItem();
+                    val[key] = readItem();
+                }
+                return val;
+            case 6:
+                len = readLength(info);
+                val = readItem();
+                if (val instanceof Uint8Array) {
+                    return readTypedArray(len, val);
+                }
+                return val;
+            case 7:
+                switch (info) {
+                    case 20:
+                        return false;
+                    case 21:
+                        return true;
+                    case 22:
+                        return null;
+                    case 23:
+                        return undefined;
+                    case 25:
+                        return readHalf();
+                    case 26:
+                        val = view.getFloat32(offset);
+                        offset += 4;
+                        return val;
+                    case 27:
+                        val = view.getFloat64(offset);
+                        offset += 8;
+                        return val;
+                }
+                break;
+        }
+
+        throw new Error("Unsupported CBOR item " + initial);
+    }
+
+    return readItem();
+}
+
+function quasar_decode(data) {
+    if (typeof data === "string") {
+        return JSON.parse(data);
+    }
+
+    return quasar_decode_cbor(data);
+}
+
+function quasar_apply_patch(prev, patch) {
+    var next, i, j, key, vals;
+
+    if ("value" in patch) {
+        return patch.value;
+    }
+
+    if ("splice" in patch) {
+        if (ArrayBuffer.isView(prev)) {
+            next = new prev.constructor(patch.len);
+            next.set(prev.length > patch.len ? prev.subarray(0, patch.len) : prev);
+        } else {
+            next = prev.slice(0, patch.len);
+            next.length = patch.len;
+        }
+
+        for (i = 0; i < patch.splice.length; i++) {
+            vals = patch.splice[i][1];
+            for (j = 0; j < vals.length; j++) {
+                next[patch.splice[i][0] + j] = vals[j];
+            }
+        }
+
+        return next;
+    }
+
+    next = Object.assign({}, prev);
+
+    if (patch.set) {
+        for (key in patch.set) {
+            next[key] = patch.set[key];
+        }
+    }
+
+    if (patch.unset) {
+        for (i = 0; i < patch.unset.length; i++) {
+            delete next[patch.unset[i]];
+        }
+    }
+
+    return next;
+}
+
+function quasar_update_data(store, msg) {
+    var updated = false;
+    var target, source;
+
+    if (msg.data) {
+        for (target in msg.data) {
+            store[target] = Object.assign(store[target] || {}, msg.data[target]);
+        }
+        updated = true;
+    }
+
+    if (msg.delta) {
+        for (target in msg.delta) {
+            store[target] = store[target] || {};
+            for (source in msg.delta[target]) {
+                store[target][source] = quasar_apply_patch(store[target][source], msg.delta[target][source]);
+            }
+        }
+        updated = true;
+    }
+
+    return updated;
 }
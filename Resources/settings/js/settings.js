@@ -14,6 +14,10 @@ function getTableSelections(table, key) {
 function initialize_global(data) {
     var dat = data["data"]["settings"]["global"];
     $("input#global\\/dataport").val(dat.dataport);
+    $("input#global\\/datasecure").prop("checked", dat.datasecure);
+    $("input#global\\/datalocal").prop("checked", dat.datalocal);
+    $("input#global\\/outlimit").val(dat.outlimit);
+    $("input[name='global\\/outpolicy']").val([dat.outpolicy]);
     $("input[name='global\\/loglevel']").val([dat.loglevel]);
     $("textarea#global\\/cookies").val(dat.cookies);
     $("input#global\\/savelog").checked = dat.savelog;
@@ -0,0 +1,335 @@
+#include "dataclient.h"
+
+#include <QDebug>
+
+namespace
+{
+    //! Merges target data or delta maps of a message into those of a pending message
+    /*!
+        \param[in,out]  pending     Pending target map
+        \param[in]      incoming    Incoming target map
+        \param[in]      ordered     Whether entries already present must not be replaced (delta patches)
+        \param[in]      blocked     Entries that incoming entries must not be merged over, may be null
+        \return true if merged, false on conflict
+    */
+    bool mergeTargets(QCborMap& pending, const QCborMap& incoming, bool ordered, const QCborMap* blocked)
+    {
+        for (auto it = incoming.constBegin(); it != incoming.constEnd(); ++it)
+        {
+            QCborValue existing = pending.value(it.key());
+            QCborMap   block    = blocked ? blocked->value(it.key()).toMap() : QCborMap();
+
+            if (existing.isUndefined() && !it.value().isMap())
+            {
+                pending[it.key()] = it.value();
+                continue;
+            }
+
+            if (!it.value().isMap() || (!existing.isUndefined() && !existing.isMap()))
+            {
+                return false;
+            }
+
+            QCborMap sources = existing.toMap();
+            QCborMap add     = it.value().toMap();
+
+            for (auto sit = add.constBegin(); sit != add.constEnd(); ++sit)
+            {
+                // Patches apply on top of the previous value so they must stay in order
+                if ((ordered && sources.contains(sit.key())) || block.contains(sit.key()))
+                {
+                    return false;
+                }
+
+                sources[sit.key()] = sit.value();
+            }
+
+            pending[it.key()] = sources;
+        }
+
+        return true;
+    }
+
+    //! Checks whether a message only carries delta patches
+    bool isDeltaMessage(const QCborMap& msg)
+    {
+        return msg.size() == 1 && msg.contains(QStringLiteral("delta"));
+    }
+}
+
+DataClient::DataClient(QObject* parent) : QObject(parent) {}
+
+DataClient::~DataClient() {}
+
+void DataClient::beginBatch()
+{
+    m_batchdepth++;
+}
+
+void DataClient::endBatch()
+{
+    if (m_batchdepth > 0 && --m_batchdepth == 0)
+    {
+        flushBatch();
+    }
+}
+
+void DataClient::setOutboundLimits(qint64 highwater, int maxframes, OutboundPolicy policy)
+{
+    m_highwater = highwater;
+    m_maxframes = qMax(1, maxframes);
+    m_policy    = policy;
+}
+
+void DataClient::sendFrame(const DataFrame& frame, DataEncoding encoding)
+{
+    if (m_closing || frame.isEmpty())
+    {
+        return;
+    }
+
+    if (m_outqueue.empty() && bytesToWrite() < m_highwater)
+    {
+        transmitFrame(frame, encoding);
+        return;
+    }
+
+    if (!m_congested)
+    {
+        m_congested = true;
+        qWarning() << "Data client" << objectName() << "is not keeping up," << bytesToWrite() << "bytes pending";
+    }
+
+    switch (m_policy)
+    {
+        case OUTBOUND_DISCONNECT:
+            m_dropped++;
+            m_closing = true;
+
+            // Closing may tear down subscriptions, which must not happen in the middle of sending data to them
+            QMetaObject::invokeMethod(
+                this,
+                [this] { close(QStringLiteral("Client is not keeping up")); },
+                Qt::QueuedConnection);
+            return;
+
+        case OUTBOUND_COALESCE:
+            if (coalesceFrame(frame, encoding))
+            {
+                return;
+            }
+            break;
+
+        case OUTBOUND_DROP_OLDEST:
+        default:
+            break;
+    }
+
+    m_outqueue.push_back({frame, encoding});
+
+    while (int(m_outqueue.size()) > m_maxframes)
+    {
+        dropOldestFrame();
+    }
+
+    m_peakqueued = qMax(m_peakqueued, int(m_outqueue.size()));
+}
+
+void DataClient::drainOutbound()
+{
+    while (!m_outqueue.empty() && bytesToWrite() < m_highwater)
+    {
+        OutboundFrame out = std::move(m_outqueue.front());
+        m_outqueue.pop_front();
+
+        transmitFrame(out.frame, out.encoding);
+    }
+
+    if (m_congested && m_outqueue.empty())
+    {
+        m_congested = false;
+        qInfo() << "Data client" << objectName() << "caught up," << m_dropped << "messages dropped so far";
+    }
+}
+
+void DataClient::transmitFrame(const DataFrame& frame, DataEncoding encoding)
+{
+    switch (encoding)
+    {
+        case DATA_ENCODING_CBOR:
+            sendBinaryMessage(frame.toCbor());
+            break;
+
+        case DATA_ENCODING_JSON:
+        default:
+            sendTextMessage(frame.toText());
+            break;
+    }
+}
+
+bool DataClient::coalesceFrame(const DataFrame& frame, DataEncoding encoding)
+{
+    const QString   data = QStringLiteral("data");
+    const QCborMap& msg  = frame.message();
+
+    if (isDeltaMessage(msg))
+    {
+        // A patch is useless once the value it applies to is gone. Dropping it changes the
+        // resync epoch, so the next update sends the full value, which is then coalesced.
+        m_dropped++;
+        m_resyncepoch++;
+        return true;
+    }
+
+    if (m_outqueue.empty() || msg.size() != 1 || !msg.contains(data))
+    {
+        return false;
+    }
+
+    OutboundFrame&  last    = m_outqueue.back();
+    const QCborMap& lastmsg = last.frame.message();
+
+    if (last.encoding != encoding || lastmsg.size() != 1 || !lastmsg.contains(data))
+    {
+        return false;
+    }
+
+    // Later values replace earlier ones
+    QCborMap targets = lastmsg.value(data).toMap();
+
+    if (!mergeTargets(targets, msg.value(data).toMap(), false, nullptr))
+    {
+        return false;
+    }
+
+    QCborMap merged;
+    merged[data] = targets;
+
+    last.frame = DataFrame(merged);
+    m_coalesced++;
+
+    return true;
+}
+
+void DataClient::dropOldestFrame()
+{
+    m_outqueue.pop_front();
+    m_dropped++;
+    m_resyncepoch++;
+
+    // Patches queued after the dropped message may have been computed against it
+    for (auto it = m_outqueue.begin(); it != m_outqueue.end();)
+    {
+        if (isDeltaMessage(it->frame.message()))
+        {
+            it = m_outqueue.erase(it);
+            m_dropped++;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void DataClient::queueBatchMessage(const QCborMap& msg, DataEncoding encoding)
+{
+    if ((!m_batch.isEmpty() || !m_batcherrs.isEmpty()) && encoding != m_batchencoding)
+    {
+        flushBatch();
+    }
+
+    m_batchencoding = encoding;
+
+    if (!mergeBatchMessage(msg))
+    {
+        flushBatch();
+        mergeBatchMessage(msg);
+    }
+}
+
+void DataClient::flushBatch()
+{
+    if (m_batch.isEmpty() && m_batcherrs.isEmpty())
+    {
+        return;
+    }
+
+    QCborMap msg = m_batch;
+
+    if (!m_batcherrs.isEmpty())
+    {
+        msg[QStringLiteral("errors")] = (m_batcherrs.size() == 1) ? m_batcherrs.at(0) : QCborValue(m_batcherrs);
+    }
+
+    m_batch     = QCborMap();
+    m_batcherrs = QCborArray();
+
+    // Send directly as DataFrame::sendTo() would queue the message again while batching
+    sendFrame(DataFrame(msg), m_batchencoding);
+}
+
+bool DataClient::mergeBatchMessage(const QCborMap& msg)
+{
+    const QString data   = QStringLiteral("data");
+    const QString delta  = QStringLiteral("delta");
+    const QString errors = QStringLiteral("errors");
+
+    QCborMap merged = m_batch;
+
+    for (auto it = msg.constBegin(); it != msg.constEnd(); ++it)
+    {
+        const QString key = it.key().toString();
+
+        if (key == errors)
+        {
+            continue;
+        }
+
+        if (key == data || key == delta)
+        {
+            if (!it.value().isMap())
+            {
+                return false;
+            }
+
+            // Clients apply data before delta, so data may not be merged over a pending patch
+            QCborMap   targets = merged.value(key).toMap();
+            QCborMap   patches = merged.value(delta).toMap();
+            const bool isdelta = (key == delta);
+
+            if (!mergeTargets(targets, it.value().toMap(), isdelta, isdelta ? nullptr : &patches))
+            {
+                return false;
+            }
+
+            merged[key] = targets;
+        }
+        else if (merged.contains(key))
+        {
+            return false;
+        }
+        else
+        {
+            merged[key] = it.value();
+        }
+    }
+
+    m_batch = merged;
+
+    const QCborValue errs = msg.value(errors);
+
+    if (errs.isArray())
+    {
+        for (const auto& e : errs.toArray())
+        {
+            m_batcherrs.append(e);
+        }
+    }
+    else if (!errs.isUndefined())
+    {
+        m_batcherrs.append(errs);
+    }
+
+    return true;
+}
@@ -0,0 +1,237 @@
+/*! \file
+    \brief Defines the DataClient class, a Data Server client connection independent of its transport
+*/
+
+#pragma once
+
+#include "dataframe.h"
+
+#include <QByteArray>
+#include <QCborArray>
+#include <QCborMap>
+#include <QObject>
+#include <QString>
+
+#include <deque>
+
+#ifndef PAPI_EXPORT
+#    ifdef PLUGINAPI_LIB
+#        define PAPI_EXPORT Q_DECL_EXPORT
+#    else
+#        define PAPI_EXPORT Q_DECL_IMPORT
+#    endif // PLUGINAPI_LIB
+#endif     // PAPI_EXPORT
+
+//! Default amount of data, in bytes, a client may have pending in its transport before messages are queued
+#define QUASAR_OUTBOUND_DEFAULT_HIGHWATER (1024 * 1024)
+
+//! Default number of messages that may be queued for a client that is not keeping up
+#define QUASAR_OUTBOUND_DEFAULT_MAXFRAMES 64
+
+//! A client connected to the Data Server
+/*! Clients may be connected through a WebSocket or a local socket. The Data Server
+    and extensions only address clients through this interface, so that every
+    transport shares the same protocol handling.
+*/
+class PAPI_EXPORT DataClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Policies applied to outgoing messages while a client is not keeping up
+    enum OutboundPolicy : uint8_t
+    {
+        OUTBOUND_DROP_OLDEST = 0, //!< Queue messages, dropping the oldest ones once the queue is full
+        OUTBOUND_COALESCE,        //!< Queue messages, merging data messages so that only the latest value of each Data Source is kept
+        OUTBOUND_DISCONNECT       //!< Disconnect the client
+    };
+
+    //! Constructs a client connection
+    /*!
+        \param[in]  parent  Parent element in Qt object tree
+    */
+    explicit DataClient(QObject* parent = nullptr);
+    virtual ~DataClient();
+
+    //! Sends a text message to the client
+    /*!
+        \param[in]  message Message to send
+    */
+    virtual void sendTextMessage(const QString& message) = 0;
+
+    //! Sends a binary message to the client
+    /*!
+        \param[in]  message Message to send
+    */
+    virtual void sendBinaryMessage(const QByteArray& message) = 0;
+
+    //! Closes the connection to the client
+    /*!
+        \param[in]  reason  Reason for closing the connection
+    */
+    virtual void close(const QString& reason) = 0;
+
+    /*! Gets the amount of data handed to the transport that has not been sent yet
+        \return number of pending bytes
+    */
+    virtual qint64 bytesToWrite() const = 0;
+
+    //! Sets the limits applied to outgoing messages
+    /*! Once more than \p highwater bytes are pending in the transport, further messages are
+        queued and handled according to \p policy until the client catches up.
+        \param[in]  highwater   Pending bytes above which messages are queued
+        \param[in]  maxframes   Maximum number of queued messages
+        \param[in]  policy      Policy applied while the client is not keeping up
+        \sa OutboundPolicy
+    */
+    void setOutboundLimits(qint64 highwater, int maxframes, OutboundPolicy policy);
+
+    //! Sends a frame to the client, subject to the outbound limits
+    /*!
+        \param[in]  frame       Frame to send
+        \param[in]  encoding    Wire encoding negotiated by the client
+        \sa DataFrame::sendTo(), setOutboundLimits()
+    */
+    void sendFrame(const DataFrame& frame, DataEncoding encoding);
+
+    /*! Gets the resync epoch of this client
+        The epoch changes whenever a message is dropped, so that delta subscriptions
+        know to send the full value again.
+        \return current resync epoch
+    */
+    uint64_t resyncEpoch() const { return m_resyncepoch; }
+
+    //! Pauses or resumes delivery of subscribed data to this client
+    /*! A paused client stays subscribed, but is skipped when data is sent to subscribers,
+        and Data Sources whose subscribers are all paused are not polled.
+        \param[in]  paused  Whether the client is paused
+        \sa DataExtension::setSubscriberPaused()
+    */
+    void setPaused(bool paused) { m_paused = paused; }
+
+    /*! Checks whether delivery of subscribed data to this client is paused
+        \return true if paused, false otherwise
+    */
+    bool isPaused() const { return m_paused; }
+
+    /*! Gets the number of messages currently queued
+        \return queue depth
+    */
+    int queuedFrames() const { return int(m_outqueue.size()); }
+
+    /*! Gets the largest number of messages that have been queued at once
+        \return peak queue depth
+    */
+    int peakQueuedFrames() const { return m_peakqueued; }
+
+    /*! Gets the number of messages dropped because the client was not keeping up
+        \return dropped message count
+    */
+    uint64_t droppedFrames() const { return m_dropped; }
+
+    /*! Gets the number of messages merged into an already queued message
+        \return coalesced message count
+    */
+    uint64_t coalescedFrames() const { return m_coalesced; }
+
+    //! Starts holding outgoing messages in a reply batch
+    /*! Messages sent to the client through DataFrame::sendTo() while a batch is held are
+        merged into as few messages as possible, and sent once every holder has called
+        endBatch(). Batches may be nested. A batch must not be held across asynchronous work,
+        as it would also hold back the data of subscriptions.
+        \sa endBatch(), isBatching()
+    */
+    void beginBatch();
+
+    //! Releases a hold on the reply batch, sending the merged messages if it was the last one
+    /*!
+        \sa beginBatch()
+    */
+    void endBatch();
+
+    /*! Checks whether outgoing messages are currently being batched
+        \return true if a batch is held, false otherwise
+    */
+    bool isBatching() const { return m_batchdepth > 0; }
+
+    //! Adds a message to the current reply batch
+    /*! Messages that cannot be merged with the pending batch flush it first.
+        \param[in]  msg         Message contents
+        \param[in]  encoding    Wire encoding negotiated by the client
+        \sa DataFrame::sendTo()
+    */
+    void queueBatchMessage(const QCborMap& msg, DataEncoding encoding);
+
+signals:
+    //! Emitted when a text message is received from the client
+    void textMessageReceived(QString message);
+
+    //! Emitted instead of textMessageReceived() by transports that receive text as raw UTF-8
+    void utf8MessageReceived(QByteArray message);
+
+    //! Emitted when a binary message is received from the client
+    void binaryMessageReceived(QByteArray message);
+
+    //! Emitted when the client disconnects
+    void disconnected();
+
+protected:
+    //! Sends queued messages while the transport is below the high water mark
+    /*! Transports call this whenever data has been written out.
+    */
+    void drainOutbound();
+
+private:
+    //! Queued outgoing message
+    struct OutboundFrame
+    {
+        DataFrame    frame;    //!< Message
+        DataEncoding encoding; //!< Wire encoding
+    };
+
+    //! Hands a frame to the transport
+    /*!
+        \param[in]  frame       Frame to send
+        \param[in]  encoding    Wire encoding
+    */
+    void transmitFrame(const DataFrame& frame, DataEncoding encoding);
+
+    //! Merges a data message into the last queued message, or drops a delta message
+    /*!
+        \param[in]  frame       Frame to send
+        \param[in]  encoding    Wire encoding
+        \return true if the frame was handled, false if it still needs to be queued
+    */
+    bool coalesceFrame(const DataFrame& frame, DataEncoding encoding);
+
+    //! Drops the oldest queued message, along with queued patches that depended on it
+    void dropOldestFrame();
+
+    //! Sends the pending batch, if any
+    void flushBatch();
+
+    //! Merges a message into the pending batch
+    /*!
+        \param[in]  msg Message contents
+        \return true if merged, false if the message conflicts with the pending batch
+    */
+    bool mergeBatchMessage(const QCborMap& msg);
+
+    int          m_batchdepth    = 0;                  //!< Number of active batch holds
+    QCborMap     m_batch;                              //!< Pending merged message
+    QCborArray   m_batcherrs;                          //!< Pending errors
+    DataEncoding m_batchencoding = DATA_ENCODING_JSON; //!< Encoding of the pending batch
+
+    std::deque<OutboundFrame> m_outqueue;                                        //!< Messages waiting for the transport to catch up
+    qint64                    m_highwater   = QUASAR_OUTBOUND_DEFAULT_HIGHWATER; //!< Pending bytes above which messages are queued
+    int                       m_maxframes   = QUASAR_OUTBOUND_DEFAULT_MAXFRAMES; //!< Maximum number of queued messages
+    OutboundPolicy            m_policy      = OUTBOUND_COALESCE;                 //!< Policy applied while congested
+    bool                      m_congested   = false;                             //!< Whether the client is currently not keeping up
+    bool                      m_closing     = false;                             //!< Whether the client is being disconnected
+    int                       m_peakqueued  = 0;                                 //!< Peak queue depth
+    uint64_t                  m_dropped     = 0;                                 //!< Dropped message count
+    uint64_t                  m_coalesced   = 0;                                 //!< Coalesced message count
+    uint64_t                  m_resyncepoch = 0;                                 //!< Changes whenever a message is dropped
+
+    bool m_paused = false; //!< Whether delivery of subscribed data is paused
+};
@@ -0,0 +1,229 @@
+#include "datadelta.h"
+#include "extension_support_internal.h"
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <QCborArray>
+#include <QCborMap>
+
+namespace
+{
+    //! Unchanged runs shorter than this are folded into the surrounding splice
+    constexpr qsizetype SPLICE_MERGE_GAP = 4;
+
+    //! Ranges of changed array elements, as [begin, end) pairs
+    using SpliceRanges = std::vector<std::pair<qsizetype, qsizetype>>;
+
+    QCborValue replacement(const QCborValue& cur)
+    {
+        QCborMap patch;
+        patch[QStringLiteral("value")] = cur;
+        return patch;
+    }
+
+    qsizetype typedArrayElementSize(const QCborValue& val)
+    {
+        if (!val.isTag() || !val.taggedValue().isByteArray())
+        {
+            return 0;
+        }
+
+        switch (static_cast<quint64>(val.tag()))
+        {
+            case QUASAR_TYPED_ARRAY_INT32:
+            case QUASAR_TYPED_ARRAY_FLOAT32:
+                return 4;
+
+            case QUASAR_TYPED_ARRAY_FLOAT64:
+                return 8;
+        }
+
+        return 0;
+    }
+
+    //! Collects changed element ranges. Elements past the end of the previous array always count as changed.
+    template <typename Equal>
+    SpliceRanges diffRanges(qsizetype prevlen, qsizetype curlen, Equal equal, qsizetype& changed)
+    {
+        SpliceRanges ranges;
+
+        changed = 0;
+
+        for (qsizetype i = 0; i < curlen; i++)
+        {
+            if (i < prevlen && equal(i))
+            {
+                continue;
+            }
+
+            changed++;
+
+            if (!ranges.empty() && i - ranges.back().second <= SPLICE_MERGE_GAP)
+            {
+                ranges.back().second = i + 1;
+            }
+            else
+            {
+                ranges.emplace_back(i, i + 1);
+            }
+        }
+
+        return ranges;
+    }
+
+    template <typename Slice>
+    QCborValue splicePatch(qsizetype curlen, const SpliceRanges& ranges, Slice slice)
+    {
+        QCborArray splices;
+
+        for (const auto& [begin, end] : ranges)
+        {
+            splices.append(QCborArray{begin, slice(begin, end)});
+        }
+
+        QCborMap patch;
+        patch[QStringLiteral("len")]    = curlen;
+        patch[QStringLiteral("splice")] = splices;
+        return patch;
+    }
+
+    bool diffTypedArray(const QCborValue& prev, const QCborValue& cur, qsizetype elemsize, QCborValue& patch)
+    {
+        const QByteArray prevbytes = prev.taggedValue().toByteArray();
+        const QByteArray curbytes  = cur.taggedValue().toByteArray();
+
+        if (prevbytes == curbytes)
+        {
+            return false;
+        }
+
+        const qsizetype prevlen = prevbytes.size() / elemsize;
+        const qsizetype curlen  = curbytes.size() / elemsize;
+        qsizetype       changed;
+
+        auto ranges = diffRanges(
+            prevlen, curlen,
+            [&](qsizetype i) {
+                return std::memcmp(prevbytes.constData() + i * elemsize, curbytes.constData() + i * elemsize, elemsize) == 0;
+            },
+            changed);
+
+        if (changed * 2 > curlen)
+        {
+            // Mostly changed, a full value is cheaper than the splices
+            patch = replacement(cur);
+            return true;
+        }
+
+        patch = splicePatch(curlen, ranges, [&](qsizetype begin, qsizetype end) {
+            return QCborValue(cur.tag(), curbytes.mid(begin * elemsize, (end - begin) * elemsize));
+        });
+
+        return true;
+    }
+
+    bool diffArray(const QCborArray& prev, const QCborArray& cur, QCborValue& patch)
+    {
+        if (prev == cur)
+        {
+            return false;
+        }
+
+        qsizetype changed;
+
+        auto ranges = diffRanges(prev.size(), cur.size(), [&](qsizetype i) { return prev.at(i) == cur.at(i); }, changed);
+
+        if (changed * 2 > cur.size())
+        {
+            patch = replacement(cur);
+            return true;
+        }
+
+        patch = splicePatch(cur.size(), ranges, [&](qsizetype begin, qsizetype end) {
+            QCborArray vals;
+
+            for (qsizetype i = begin; i < end; i++)
+            {
+                vals.append(cur.at(i));
+            }
+
+            return QCborValue(vals);
+        });
+
+        return true;
+    }
+
+    bool diffMap(const QCborMap& prev, const QCborMap& cur, QCborValue& patch)
+    {
+        QCborMap   set;
+        QCborArray unset;
+
+        for (auto it = cur.constBegin(); it != cur.constEnd(); ++it)
+        {
+            auto pit = prev.constFind(it.key());
+
+            if (pit == prev.constEnd() || pit.value() != it.value())
+            {
+                set[it.key()] = it.value();
+            }
+        }
+
+        for (auto it = prev.constBegin(); it != prev.constEnd(); ++it)
+        {
+            if (!cur.contains(it.key()))
+            {
+                unset.append(it.key());
+            }
+        }
+
+        if (set.isEmpty() && unset.isEmpty())
+        {
+            return false;
+        }
+
+        QCborMap p;
+
+        if (!set.isEmpty())
+        {
+            p[QStringLiteral("set")] = set;
+        }
+
+        if (!unset.isEmpty())
+        {
+            p[QStringLiteral("unset")] = unset;
+        }
+
+        patch = p;
+        return true;
+    }
+}
+
+bool computeDataDelta(const QCborValue& prev, const QCborValue& cur, QCborValue& patch)
+{
+    if (prev.isMap() && cur.isMap())
+    {
+        return diffMap(prev.toMap(), cur.toMap(), patch);
+    }
+
+    if (prev.isArray() && cur.isArray())
+    {
+        return diffArray(prev.toArray(), cur.toArray(), patch);
+    }
+
+    qsizetype elemsize = typedArrayElementSize(cur);
+
+    if (elemsize && prev.isTag() && prev.tag() == cur.tag() && typedArrayElementSize(prev) == elemsize)
+    {
+        return diffTypedArray(prev, cur, elemsize, patch);
+    }
+
+    if (prev == cur)
+    {
+        return false;
+    }
+
+    patch = replacement(cur);
+    return true;
+}
@@ -0,0 +1,27 @@
+/*! \file
+    \brief Computes delta patches between successive values of a Data Source
+
+    Delta patches are sent to subscribers that opted into delta streams
+    instead of the full value of a Data Source. A patch is a map holding
+    exactly one of the following forms:
+
+    - **{"value": v}** replaces the previous value with \a v
+    - **{"set": {k: v, ...}, "unset": [k, ...]}** updates an object in place,
+      setting each listed key to its new value and removing the unset keys
+    - **{"len": n, "splice": [[i, [v, ...]], ...]}** resizes an array to \a n
+      elements and overwrites the elements starting at each index \a i.
+      Spliced values of typed arrays are themselves typed arrays of the same type.
+*/
+
+#pragma once
+
+#include <QCborValue>
+
+//! Computes the patch that turns one value of a Data Source into the next
+/*!
+    \param[in]  prev    Previous value, as last sent to the subscriber
+    \param[in]  cur     Current value
+    \param[out] patch   Patch that turns \a prev into \a cur
+    \return true if the values differ and \a patch was set, false if they are equal
+*/
+bool computeDataDelta(const QCborValue& prev, const QCborValue& cur, QCborValue& patch);
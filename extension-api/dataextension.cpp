@@ -1,29 +1,78 @@
 #include "dataextension.h"
+#include "dataclient.h"
+#include "datadelta.h"
+#include "extensionhost.h"
 
 #include <extension_support_internal.h>
-#include <unordered_set>
+
+#include <algorithm>
+#include <unordered_map>
 
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QLibrary>
+#include <QPointer>
+#include <QRunnable>
 #include <QSettings>
-#include <QTimer>
-#include <QtWebSockets/QWebSocket>
+#include <QThread>
+#include <QThreadPool>
 
 //! Ensure c strings are null terminated and converted to a utf8 QString
 #define CHAR_TO_UTF8(d, x) \
     x[sizeof(x) - 1] = 0;  \
     d                = QString::fromUtf8(x);
 
-uintmax_t DataExtension::_uid = 0;
+namespace
+{
+    //! Runs a get_data call on the worker pool
+    class DataFetchTask : public QRunnable
+    {
+    public:
+        explicit DataFetchTask(std::function<void()> fn) : m_fn(std::move(fn)) {}
+
+        void run() override { m_fn(); }
+
+    private:
+        std::function<void()> m_fn;
+    };
+
+    //! Collects the results of a multi-source client poll so that they are sent in a single message
+    struct PendingPoll
+    {
+        QPointer<DataClient>            client;        //!< Requesting client, cleared if it disconnects before the poll completes
+        DataEncoding                    encoding;      //!< Wire encoding negotiated by the client
+        QCborMap                        data;          //!< Data collected so far
+        QCborArray                      errs;          //!< Errors collected so far
+        size_t                          remaining = 0; //!< Number of sources still being polled
+        DataExtension::DataPollCallback done;          //!< Called with the collected results once every source is done
+    };
+}
 
-DataExtension::DataExtension(quasar_ext_info_t* p, extension_destroy destroyfunc, QString path, QObject* parent) :
+std::atomic<uintmax_t> DataExtension::_uid{0};
+
+DataExtension::DataExtension(quasar_ext_info_t* p,
+                             extension_destroy  destroyfunc,
+                             QString            path,
+                             DataScheduler*     scheduler,
+                             QObject*           parent,
+                             ExtensionHost*     host,
+                             void*              context) :
     QObject(parent),
     m_extension(p),
     m_destroyfunc(destroyfunc),
-    m_libpath(path)
+    m_host(host),
+    m_builtincontext(context),
+    m_libpath(path),
+    m_scheduler(scheduler)
 {
+    // Owned from here on, so that the host process goes away if construction fails
+    if (m_host)
+    {
+        m_host->setParent(this);
+        m_host->attach(this);
+    }
+
     if (nullptr == m_extension)
     {
         throw std::invalid_argument("null extension info struct");
@@ -55,6 +104,11 @@ DataExtension::DataExtension(quasar_ext_info_t* p, extension_destroy destroyfunc
     QSettings settings;
 
     // register data sources
+    //
+    // Reserve the uids of every source at once, so that they are contiguous even if other
+    // extensions are being loaded at the same time
+    m_uidbase = DataExtension::_uid.fetch_add(m_extension->numDataSources) + 1;
+
     if (nullptr != m_extension->dataSources)
     {
         for (unsigned int i = 0; i < m_extension->numDataSources; i++)
@@ -72,14 +126,15 @@ DataExtension::DataExtension(quasar_ext_info_t* p, extension_destroy destroyfunc
             DataSource& source = m_datasources[srcname];
             source.enabled     = settings.value(getSettingsKey(source.name + QUASAR_DP_ENABLED), true).toBool();
             source.name        = srcname;
-            source.uid = m_extension->dataSources[i].uid = ++DataExtension::_uid;
+            source.uid = m_extension->dataSources[i].uid = m_uidbase + m_sourcesbyuid.size();
             source.rate      = settings.value(getSettingsKey(source.name + QUASAR_DP_RATE_PREFIX), (qlonglong) m_extension->dataSources[i].rate).toLongLong();
             source.validtime = m_extension->dataSources[i].validtime;
 
             // Initialize type specific fields
             if (source.rate == QUASAR_POLLING_SIGNALED)
             {
-                source.locks = std::make_unique<DataLock>();
+                source.locks    = std::make_unique<DataLock>();
+                source.pushring = std::make_unique<DataPushRing>();
             }
 
             if (source.rate == QUASAR_POLLING_CLIENT)
@@ -87,18 +142,36 @@ DataExtension::DataExtension(quasar_ext_info_t* p, extension_destroy destroyfunc
                 source.expiry = std::chrono::system_clock::now();
             }
 
-            // If data source is extension signaled or async poll
-            if (source.rate <= QUASAR_POLLING_CLIENT)
+            // Timer based and client polled sources may have their values published by the extension
+            if (source.rate >= QUASAR_POLLING_CLIENT)
+            {
+                source.published = std::make_unique<DataPublishBuffer>();
+            }
+
+            if (source.rate > QUASAR_POLLING_CLIENT)
             {
-                connect(this, &DataExtension::dataReady, this, &DataExtension::handleDataReadySignal, Qt::QueuedConnection);
+                source.ticks = std::make_unique<std::atomic<uint64_t>>(0);
             }
+
+            // Values of the ordered map never move, so the index can point into it
+            m_sourcesbyuid.push_back(&source);
         }
     }
 
+    m_fetchwaiters.resize(m_sourcesbyuid.size());
+
+    // Data ready signals of extension signaled and async poll sources
+    connect(this, &DataExtension::dataReady, this, &DataExtension::handleDataReadySignal, Qt::QueuedConnection);
+
+    // get_data calls for timer ticks and client polls run on a bounded pool, so that a slow
+    // extension only holds up its own Data Sources
+    m_workers = new QThreadPool(this);
+    m_workers->setMaxThreadCount(qBound(1, static_cast<int>(m_datasources.size()), QThread::idealThreadCount()));
+
     // create settings
-    if (m_extension->create_settings)
+    if (m_host ? m_host->hasSettings() : m_extension->create_settings != nullptr)
     {
-        m_settings.reset(m_extension->create_settings());
+        m_settings.reset(m_host ? m_host->createSettings() : m_extension->create_settings());
 
         if (!m_settings)
         {
@@ -158,7 +231,7 @@ DataExtension::DataExtension(quasar_ext_info_t* p, extension_destroy destroyfunc
     }
 
     // initialize the extension
-    if (!m_extension->init(this))
+    if (!(m_host ? m_host->init() : m_extension->init(this)))
     {
         throw std::runtime_error("extension init() failed");
     }
@@ -171,7 +244,17 @@ DataExtension::DataExtension(quasar_ext_info_t* p, extension_destroy destroyfunc
 
 DataExtension::~DataExtension()
 {
-    if (nullptr != m_extension->shutdown)
+    // Results of in-flight calls are discarded along with this object
+    if (m_workers)
+    {
+        m_workers->waitForDone();
+    }
+
+    if (m_host)
+    {
+        m_host->shutdown();
+    }
+    else if (nullptr != m_extension->shutdown)
     {
         m_extension->shutdown(this);
     }
@@ -179,19 +262,48 @@ DataExtension::~DataExtension()
     // Do some explicit cleanup
     for (auto it = m_datasources.begin(); it != m_datasources.end(); ++it)
     {
-        it.value().timer.reset();
+        destroyTimer(it.value());
         it.value().locks.reset();
 
         it.value().subscribers.clear();
     }
 
-    // extension is responsible for cleanup of quasar_ext_info_t*
-    m_destroyfunc(m_extension);
+    m_clientsources.clear();
+
+    // extension is responsible for cleanup of quasar_ext_info_t*, hosted ones clean up in their host process
+    if (m_destroyfunc)
+    {
+        m_destroyfunc(m_extension);
+    }
+
     m_extension = nullptr;
 }
 
-DataExtension* DataExtension::load(QString libpath, QObject* parent)
+DataExtension* DataExtension::load(QString libpath, DataScheduler* scheduler, QObject* parent, bool isolated)
 {
+    if (isolated)
+    {
+        ExtensionHost* host = new ExtensionHost(libpath);
+
+        if (!host->start())
+        {
+            qWarning() << "Failed to start the extension host of" << libpath;
+            delete host;
+            return nullptr;
+        }
+
+        try
+        {
+            // The host is owned by the extension even if construction fails
+            return new DataExtension(host->info(), nullptr, libpath, scheduler, parent, host);
+        } catch (std::exception e)
+        {
+            qWarning() << "Exception: '" << e.what() << "' while initializing " << libpath;
+        }
+
+        return nullptr;
+    }
+
     QLibrary lib(libpath);
 
     if (!lib.load())
@@ -219,7 +331,7 @@ DataExtension* DataExtension::load(QString libpath, QObject* parent)
 
     try
     {
-        DataExtension* extension = new DataExtension(p, destroyfunc, libpath, parent);
+        DataExtension* extension = new DataExtension(p, destroyfunc, libpath, scheduler, parent);
         return extension;
     } catch (std::exception e)
     {
@@ -229,7 +341,26 @@ DataExtension* DataExtension::load(QString libpath, QObject* parent)
     return nullptr;
 }
 
-bool DataExtension::addSubscriber(QString source, QWebSocket* subscriber, QString widgetName)
+DataExtension* DataExtension::loadBuiltin(quasar_ext_info_t* p, void* context, DataScheduler* scheduler, QObject* parent)
+{
+    if (!p || !p->init || !p->shutdown || !p->get_data || !p->fields || !p->dataSources)
+    {
+        qWarning() << "Built-in extension data missing";
+        return nullptr;
+    }
+
+    try
+    {
+        return new DataExtension(p, nullptr, QString(), scheduler, parent, nullptr, context);
+    } catch (std::exception e)
+    {
+        qWarning() << "Exception: '" << e.what() << "' while initializing built-in extension " << p->fields->name;
+    }
+
+    return nullptr;
+}
+
+bool DataExtension::addSubscriber(QString source, DataClient* subscriber, QString widgetName, DataEncoding encoding, bool delta, int64_t rate)
 {
     if (!subscriber)
     {
@@ -237,14 +368,16 @@ bool DataExtension::addSubscriber(QString source, QWebSocket* subscriber, QStrin
         return false;
     }
 
-    if (!m_datasources.count(source))
+    auto sit = m_datasources.find(source);
+
+    if (sit == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in extension " << m_name << " by widget " << widgetName;
         return false;
     }
 
     // XXX maybe needs locks
-    DataSource& dsrc = m_datasources[source];
+    DataSource& dsrc = sit.value();
 
     if (dsrc.rate == QUASAR_POLLING_CLIENT)
     {
@@ -252,25 +385,30 @@ bool DataExtension::addSubscriber(QString source, QWebSocket* subscriber, QStrin
         return false;
     }
 
-    dsrc.subscribers.insert(subscriber);
+    // A (re)subscribed delta subscriber always starts from a keyframe
+    DataSubscriber& sub = dsrc.subscribers[subscriber];
+    sub.encoding        = encoding;
+    sub.delta           = delta;
+    sub.generation      = 0;
+    sub.rate            = std::max<int64_t>(0, rate);
+    sub.sent            = QCborValue();
+
+    m_clientsources[subscriber].insert(source);
 
-    if (dsrc.rate > QUASAR_POLLING_CLIENT)
+    // Subscriptions of a paused client do not start the timer
+    if (dsrc.rate > QUASAR_POLLING_CLIENT && hasActiveSubscribers(dsrc))
     {
         createTimer(dsrc);
+        updateTimerRate(dsrc);
     }
 
     // Send settings if applicable
-    auto payload = craftSettingsMessage();
-
-    if (!payload.isEmpty())
-    {
-        subscriber->sendTextMessage(payload);
-    }
+    craftSettingsMessage().sendTo(subscriber, encoding);
 
     return true;
 }
 
-void DataExtension::removeSubscriber(QWebSocket* subscriber)
+void DataExtension::removeSubscriber(DataClient* subscriber)
 {
     if (!subscriber)
     {
@@ -278,25 +416,98 @@ void DataExtension::removeSubscriber(QWebSocket* subscriber)
         return;
     }
 
-    // Removes subscriber from all data sources
+    auto it = m_clientsources.find(subscriber);
 
-    for (auto it = m_datasources.begin(); it != m_datasources.end(); ++it)
+    if (it == m_clientsources.end())
+    {
+        return;
+    }
+
+    // Removes subscriber from the data sources it is subscribed to
+    for (const QString& name : it->second)
+    {
+        auto sit = m_datasources.find(name);
+
+        if (sit != m_datasources.end())
+        {
+            detachSubscriber(sit.value(), subscriber);
+        }
+    }
+
+    m_clientsources.erase(it);
+}
+
+void DataExtension::setSubscriberPaused(DataClient* subscriber, bool paused)
+{
+    auto it = m_clientsources.find(subscriber);
+
+    if (it == m_clientsources.end())
+    {
+        return;
+    }
+
+    for (const QString& name : it->second)
     {
-        // Log if unsubscribed succeeded
-        if (it.value().subscribers.erase(subscriber))
+        auto sit = m_datasources.find(name);
+
+        if (sit == m_datasources.end() || sit.value().rate <= QUASAR_POLLING_CLIENT)
         {
-            qInfo() << "Widget unsubscribed from extension " << m_name << " data source " << it.key();
+            // Signaled sources resume on their next signal
+            continue;
         }
 
-        // Stop timer if no subscribers
-        if (it.value().subscribers.empty())
+        DataSource& dsrc = sit.value();
+
+        if (paused)
         {
-            it.value().timer.reset();
+            if (!hasActiveSubscribers(dsrc))
+            {
+                destroyTimer(dsrc);
+            }
+            else
+            {
+                updateTimerRate(dsrc);
+            }
+        }
+        else
+        {
+            createTimer(dsrc);
+            updateTimerRate(dsrc);
+
+            if (dsrc.enabled)
+            {
+                sendFreshData(dsrc, subscriber);
+            }
         }
     }
 }
 
-void DataExtension::pollAndSendData(QString source, QWebSocket* client, QString widgetName)
+bool DataExtension::removeSubscriber(QString source, DataClient* subscriber)
+{
+    if (!subscriber)
+    {
+        qWarning() << "Null subscriber";
+        return false;
+    }
+
+    auto it = m_clientsources.find(subscriber);
+
+    if (it == m_clientsources.end() || !it->second.erase(source))
+    {
+        return false;
+    }
+
+    if (it->second.empty())
+    {
+        m_clientsources.erase(it);
+    }
+
+    auto sit = m_datasources.find(source);
+
+    return sit != m_datasources.end() && detachSubscriber(sit.value(), subscriber);
+}
+
+void DataExtension::pollAndSendData(QString source, DataClient* client, QString widgetName, DataEncoding encoding)
 {
     if (!client)
     {
@@ -304,49 +515,86 @@ void DataExtension::pollAndSendData(QString source, QWebSocket* client, QString
         return;
     }
 
+    // Cached results are sent right away and join the request batch, if any. Polled ones are
+    // sent on their own, as the batch is only held while its requests are handled
+    QPointer<DataClient> target(client);
+
+    pollData(source, client, widgetName, encoding, [this, target, encoding](const QCborMap& data, const QCborArray& errs) {
+        if (!target)
+        {
+            return;
+        }
+
+        craftDataMessage(data, errs).sendTo(target, encoding);
+    });
+}
+
+void DataExtension::pollData(QString source, DataClient* client, QString widgetName, DataEncoding encoding, DataPollCallback done)
+{
     QStringList dlist = source.split(',', QString::SkipEmptyParts);
 
-    QJsonObject data;
-    QJsonArray  errs;
+    auto poll      = std::make_shared<PendingPoll>();
+    poll->client   = client;
+    poll->encoding = encoding;
+    poll->done     = std::move(done);
+
+    std::vector<DataSource*> sources;
 
     for (QString& src : dlist)
     {
-        if (!m_datasources.count(src))
+        auto sit = m_datasources.find(src);
+
+        if (sit == m_datasources.end())
         {
             QString m = "Unknown data source " + src + " requested in extension " + m_name + " by widget " + widgetName;
-            errs.append(m);
+            poll->errs.append(m);
             qWarning() << m;
             continue;
         }
 
-        // XXX maybe needs locks
-        DataSource& dsrc   = m_datasources[src];
-        auto        result = getDataFromSource(data, dsrc);
+        sources.push_back(&sit.value());
+    }
 
-        switch (result)
-        {
-            case GET_DATA_FAILED:
-            {
-                QString m = "getDataFromSource(" + src + ") failed in extension " + m_name + " requested by widget " + widgetName;
-                errs.append(m);
-                qWarning() << m;
-            }
-            break;
-            case GET_DATA_DELAYED:
-                // add to poll queue
-                dsrc.pollqueue.push_back(client);
-                break;
-            case GET_DATA_SUCCESS:
-                // done. do nothing
-                break;
-        }
+    if (sources.empty())
+    {
+        poll->done(poll->data, poll->errs);
+        return;
     }
 
-    QString message = craftDataMessage(data, errs);
+    // Set up the count first as cached results complete immediately
+    poll->remaining = sources.size();
 
-    if (!message.isEmpty())
+    for (DataSource* dsrc : sources)
     {
-        client->sendTextMessage(message);
+        fetchDataFromSource(*dsrc, [this, poll, widgetName, dsrc](DataSourceReturnState result, const QCborValue& dat) {
+            const QString& name = dsrc->name;
+
+            switch (result)
+            {
+                case GET_DATA_FAILED:
+                {
+                    QString m = "getDataFromSource(" + name + ") failed in extension " + m_name + " requested by widget " + widgetName;
+                    poll->errs.append(m);
+                    qWarning() << m;
+                }
+                break;
+                case GET_DATA_DELAYED:
+                    // add to poll queue
+                    if (poll->client)
+                    {
+                        dsrc->pollqueue.push_back({poll->client, poll->encoding});
+                    }
+                    break;
+                case GET_DATA_SUCCESS:
+                    poll->data[name] = dat;
+                    break;
+            }
+
+            if (--poll->remaining == 0)
+            {
+                poll->done(poll->data, poll->errs);
+            }
+        });
     }
 }
 
@@ -354,25 +602,38 @@ void DataExtension::sendDataToSubscribers(DataSource& source)
 {
     // XXX maybe needs locks
 
-    // Only send if there are subscribers
-    if (!source.subscribers.empty())
+    // Hosted extensions are called on the worker pool, so that a hung host does not hold up this thread
+    if (m_host && hasActiveSubscribers(source))
     {
-        QJsonObject data;
+        fetchDataFromSource(source, [this, src = &source](DataSourceReturnState result, const QCborValue& dat) {
+            if (result == GET_DATA_SUCCESS)
+            {
+                QCborMap data;
+                data[src->name] = dat;
 
-        getDataFromSource(data, source);
+                fanOutData(*src, data);
+            }
 
-        QString message = craftDataMessage(data);
+            signalDataProcessed(*src);
+        });
 
-        if (!message.isEmpty())
-        {
-            for (auto sub : source.subscribers)
-            {
-                sub->sendTextMessage(message);
-            }
-        }
+        return;
+    }
+
+    // Only send if there are active subscribers
+    if (hasActiveSubscribers(source))
+    {
+        QCborMap data;
+
+        getDataFromSource(data, source);
+        fanOutData(source, data);
     }
 
-    // Signal data processed
+    signalDataProcessed(source);
+}
+
+void DataExtension::signalDataProcessed(DataSource& source)
+{
     if (nullptr != source.locks)
     {
         {
@@ -381,6 +642,138 @@ void DataExtension::sendDataToSubscribers(DataSource& source)
         }
 
         source.locks->cv.notify_one();
+
+        // Hosted extensions wait in their own process
+        if (m_host)
+        {
+            m_host->dataProcessed(source.uid);
+        }
+    }
+}
+
+void DataExtension::tickDataSource(DataSource& source)
+{
+    // Ticks are coalesced while a get_data call for the source is still in flight
+    if (!hasActiveSubscribers(source) || !m_fetchwaiters[source.uid - m_uidbase].empty())
+    {
+        return;
+    }
+
+    // Counted before the call is made, so that get_data sees its own tick
+    if (source.ticks)
+    {
+        ++*source.ticks;
+    }
+
+    fetchDataFromSource(source, [this, src = &source](DataSourceReturnState result, const QCborValue& dat) {
+        if (result != GET_DATA_SUCCESS)
+        {
+            return;
+        }
+
+        QCborMap data;
+        data[src->name] = dat;
+
+        fanOutData(*src, data);
+    });
+}
+
+void DataExtension::fanOutData(DataSource& source, const QCborMap& data)
+{
+    // Build the frame once per tick; subscribers sharing an encoding share the encoded buffer
+    const DataFrame frame = craftDataMessage(data);
+
+    if (!frame.isEmpty())
+    {
+        bool hasdelta = std::any_of(source.subscribers.begin(), source.subscribers.end(), [](const auto& p) { return p.second.delta; });
+
+        QCborValue cur = data.value(source.name);
+        DataFrame  deltaframe;
+        bool       unchanged = false;
+        bool       keyframe  = true;
+
+        if (hasdelta)
+        {
+            // The patch is computed once per tick and shared by all delta subscribers at the previous generation
+            QCborValue patch;
+
+            if (!source.lastdat.isUndefined() && source.generation % QUASAR_DELTA_KEYFRAME_TICKS != 0)
+            {
+                keyframe  = false;
+                unchanged = !computeDataDelta(source.lastdat, cur, patch);
+
+                if (!unchanged)
+                {
+                    deltaframe = craftDeltaMessage(source.name, patch);
+                }
+            }
+
+            source.lastdat = cur;
+        }
+        else
+        {
+            source.lastdat = QCborValue();
+        }
+
+        source.generation++;
+
+        // Subscribers at a slower rate take a tick once their interval has elapsed, give or take half a tick
+        const auto now = std::chrono::steady_clock::now();
+
+        if (source.lastfanout.time_since_epoch().count())
+        {
+            source.ticklen = now - source.lastfanout;
+        }
+
+        source.lastfanout = now;
+
+        for (auto& [sub, state] : source.subscribers)
+        {
+            // Paused subscribers pick up from the value they were last sent once resumed
+            if (sub->isPaused())
+            {
+                continue;
+            }
+
+            if (state.rate > source.tickrate && now - state.lastsent < std::chrono::milliseconds(state.rate) - source.ticklen / 2)
+            {
+                continue;
+            }
+
+            // Taken before sending, so that a message dropped by this send also forces a full value next time
+            uint64_t epoch = sub->resyncEpoch();
+
+            if (!state.delta || keyframe || state.generation == 0 || state.epoch != epoch)
+            {
+                frame.sendTo(sub, state.encoding);
+            }
+            else if (state.generation + 1 == source.generation)
+            {
+                if (!unchanged)
+                {
+                    deltaframe.sendTo(sub, state.encoding);
+                }
+            }
+            else
+            {
+                // Skipped ticks, so patch from the value this subscriber was last sent
+                QCborValue patch;
+
+                if (computeDataDelta(state.sent, cur, patch))
+                {
+                    craftDeltaMessage(source.name, patch).sendTo(sub, state.encoding);
+                }
+            }
+
+            state.generation = source.generation;
+            state.epoch      = epoch;
+            state.lastsent   = now;
+
+            if (state.delta)
+            {
+                state.sent = cur;
+            }
+        }
     }
 }
 
@@ -504,13 +897,15 @@ QJsonObject DataExtension::getMetadataJSON(bool settings_only)
 
 void DataExtension::setDataSourceEnabled(QString source, bool enabled)
 {
-    if (!m_datasources.count(source))
+    auto sit = m_datasources.find(source);
+
+    if (sit == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in extension " << m_name;
         return;
     }
 
-    DataSource& data = m_datasources[source];
+    DataSource& data = sit.value();
 
     // Set if changed
     if (data.enabled != enabled)
@@ -521,28 +916,30 @@ void DataExtension::setDataSourceEnabled(QString source, bool enabled)
         QSettings settings;
         settings.setValue(getSettingsKey(source + QUASAR_DP_ENABLED), data.enabled);
 
-        if (data.enabled && data.rate > QUASAR_POLLING_CLIENT && !data.subscribers.empty())
+        if (data.enabled && data.rate > QUASAR_POLLING_CLIENT && hasActiveSubscribers(data))
         {
             // Create timer if not exist
             createTimer(data);
         }
-        else if (data.timer)
+        else
         {
-            // Delete the timer if enabled
-            data.timer.reset();
+            // Stop the timer if disabled
+            destroyTimer(data);
         }
     }
 }
 
 void DataExtension::setDataSourceRefresh(QString source, int64_t msec)
 {
-    if (!m_datasources.count(source))
+    auto sit = m_datasources.find(source);
+
+    if (sit == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in extension " << m_name;
         return;
     }
 
-    DataSource& data = m_datasources[source];
+    DataSource& data = sit.value();
 
     if (msec <= 0)
     {
@@ -560,10 +957,7 @@ void DataExtension::setDataSourceRefresh(QString source, int64_t msec)
         settings.setValue(getSettingsKey(source + QUASAR_DP_RATE_PREFIX), (qlonglong) data.rate);
 
         // Refresh timer if exists
-        if (nullptr != data.timer)
-        {
-            data.timer->setInterval(data.rate);
-        }
+        updateTimerRate(data);
     }
 }
 
@@ -657,9 +1051,16 @@ void DataExtension::setAllSettings(const QJsonObject& setjs)
 
 void DataExtension::updateExtensionSettings()
 {
-    if (m_settings && m_extension->update)
+    if (m_settings && (m_host || m_extension->update))
     {
-        m_extension->update(m_settings.get());
+        if (m_host)
+        {
+            m_host->update(m_settings.get());
+        }
+        else
+        {
+            m_extension->update(m_settings.get());
+        }
 
         propagateSettingsToAllUniqueSubscribers();
     }
@@ -667,13 +1068,15 @@ void DataExtension::updateExtensionSettings()
 
 void DataExtension::emitDataReady(QString source)
 {
-    if (!m_datasources.count(source))
+    auto sit = m_datasources.find(source);
+
+    if (sit == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in extension " << m_name;
         return;
     }
 
-    DataSource& data = m_datasources[source];
+    DataSource& data = sit.value();
 
     if (data.locks)
     {
@@ -681,16 +1084,58 @@ void DataExtension::emitDataReady(QString source)
     }
 }
 
+void DataExtension::emitDataReady(size_t uid)
+{
+    DataSource* data = getSource(uid);
+
+    if (!data)
+    {
+        qWarning() << "Unknown data source uid " << uid << " requested in extension " << m_name;
+        return;
+    }
+
+    if (data->locks)
+    {
+        // Skips the string round trip of the dataReady signal
+        QMetaObject::invokeMethod(this, [this, data] { handleDataReady(*data); }, Qt::QueuedConnection);
+    }
+}
+
+uint64_t DataExtension::getTickCount(size_t uid)
+{
+    DataSource* data = getSource(uid);
+
+    return (data && data->ticks) ? data->ticks->load() : 0;
+}
+
 void DataExtension::waitDataProcessed(QString source)
 {
-    if (!m_datasources.count(source))
+    auto sit = m_datasources.find(source);
+
+    if (sit == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in extension " << m_name;
         return;
     }
 
-    DataSource& data = m_datasources[source];
+    waitProcessed(sit.value());
+}
+
+void DataExtension::waitDataProcessed(size_t uid)
+{
+    DataSource* data = getSource(uid);
 
+    if (!data)
+    {
+        qWarning() << "Unknown data source uid " << uid << " requested in extension " << m_name;
+        return;
+    }
+
+    waitProcessed(*data);
+}
+
+void DataExtension::waitProcessed(DataSource& data)
+{
     if (data.locks)
     {
         std::unique_lock<std::mutex> lk(data.locks->mutex);
@@ -699,45 +1144,205 @@ void DataExtension::waitDataProcessed(QString source)
     }
 }
 
+DataPublishBuffer* DataExtension::getPublishBuffer(QString source)
+{
+    auto it = m_datasources.find(source);
+
+    if (it == m_datasources.end())
+    {
+        qWarning() << "Unknown data source " << source << " requested in extension " << m_name;
+        return nullptr;
+    }
+
+    return getPublishBuffer(it.value().uid);
+}
+
+DataPublishBuffer* DataExtension::getPublishBuffer(size_t uid)
+{
+    DataSource* data = getSource(uid);
+
+    if (!data)
+    {
+        qWarning() << "Unknown data source uid " << uid << " requested in extension " << m_name;
+        return nullptr;
+    }
+
+    if (!data->published)
+    {
+        qWarning() << "Data source " << data->name << " in extension " << m_name << " does not accept published data";
+        return nullptr;
+    }
+
+    return data->published.get();
+}
+
+bool DataExtension::configurePushRing(QString source, size_t capacity, quasar_push_overflow_t policy)
+{
+    auto it = m_datasources.find(source);
+
+    if (it == m_datasources.end() || !it.value().pushring)
+    {
+        qWarning() << "Data source " << source << " in extension " << m_name << " does not accept pushed data";
+        return false;
+    }
+
+    it.value().pushring = std::make_unique<DataPushRing>(capacity, policy);
+
+    return true;
+}
+
+DataPushRing* DataExtension::getPushRing(QString source)
+{
+    auto it = m_datasources.find(source);
+
+    if (it == m_datasources.end())
+    {
+        qWarning() << "Unknown data source " << source << " requested in extension " << m_name;
+        return nullptr;
+    }
+
+    return getPushRing(it.value().uid);
+}
+
+DataPushRing* DataExtension::getPushRing(size_t uid)
+{
+    DataSource* data = getSource(uid);
+
+    if (!data)
+    {
+        qWarning() << "Unknown data source uid " << uid << " requested in extension " << m_name;
+        return nullptr;
+    }
+
+    if (!data->pushring)
+    {
+        qWarning() << "Data source " << data->name << " in extension " << m_name << " does not accept pushed data";
+        return nullptr;
+    }
+
+    return data->pushring.get();
+}
+
+bool DataExtension::commitPush(QString source)
+{
+    auto it = m_datasources.find(source);
+
+    if (it == m_datasources.end())
+    {
+        qWarning() << "Unknown data source " << source << " requested in extension " << m_name;
+        return false;
+    }
+
+    return commitPush(it.value().uid);
+}
+
+bool DataExtension::commitPush(size_t uid)
+{
+    DataPushRing* ring = getPushRing(uid);
+
+    if (!ring || !ring->commit())
+    {
+        return false;
+    }
+
+    // A single queued drain covers every frame pushed until it starts
+    if (ring->requestDrain())
+    {
+        QMetaObject::invokeMethod(this, [this, src = getSource(uid)] { drainPushRing(*src); }, Qt::QueuedConnection);
+    }
+
+    return true;
+}
+
+void DataExtension::drainPushRing(DataSource& source)
+{
+    DataPushRing* ring = source.pushring.get();
+
+    ring->beginDrain();
+
+    QCborValue dat;
+    size_t     count = 0;
+
+    while (count < ring->capacity() && ring->pop(dat))
+    {
+        count++;
+
+        if (source.enabled && hasActiveSubscribers(source))
+        {
+            QCborMap data;
+            data[source.name] = dat;
+
+            fanOutData(source, data);
+        }
+    }
+
+    // Leave the event loop to others before taking on the rest
+    if (!ring->empty() && ring->requestDrain())
+    {
+        QMetaObject::invokeMethod(this, [this, src = &source] { drainPushRing(*src); }, Qt::QueuedConnection);
+    }
+}
+
 void DataExtension::handleDataReadySignal(QString source)
 {
-    if (!m_datasources.count(source))
+    auto sit = m_datasources.find(source);
+
+    if (sit == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in extension " << m_name;
         return;
     }
 
-    DataSource& dsrc = m_datasources[source];
+    handleDataReady(sit.value());
+}
 
+void DataExtension::handleDataReady(DataSource& dsrc)
+{
     if (dsrc.rate == QUASAR_POLLING_CLIENT)
     {
         // pop poll queue
-        QJsonObject data;
-        auto        result = getDataFromSource(data, dsrc);
-
-        switch (result)
-        {
-            case GET_DATA_FAILED:
-                qWarning() << "getDataFromSource(" << source << ") in extension " << m_name << " failed";
-                break;
-            case GET_DATA_DELAYED:
-                qWarning() << "getDataFromSource(" << source << ") in extension " << m_name << " returns delayed data on signal ready";
-                break;
-            case GET_DATA_SUCCESS:
+        auto answer = [this, src = &dsrc](DataSourceReturnState result, const QCborValue& dat) {
+            switch (result)
             {
-                QString message = craftDataMessage(data);
-
-                if (!message.isEmpty())
+                case GET_DATA_FAILED:
+                    qWarning() << "getDataFromSource(" << src->name << ") in extension " << m_name << " failed";
+                    break;
+                case GET_DATA_DELAYED:
+                    qWarning() << "getDataFromSource(" << src->name << ") in extension " << m_name << " returns delayed data on signal ready";
+                    break;
+                case GET_DATA_SUCCESS:
                 {
-                    // XXX maybe needs locks
-                    while (!dsrc.pollqueue.empty())
+                    QCborMap data;
+                    data[src->name] = dat;
+
+                    const DataFrame frame = craftDataMessage(data);
+
+                    if (!frame.isEmpty())
                     {
-                        dsrc.pollqueue.front()->sendTextMessage(message);
-                        dsrc.pollqueue.pop_front();
+                        // XXX maybe needs locks
+                        while (!src->pollqueue.empty())
+                        {
+                            auto& [client, encoding] = src->pollqueue.front();
+                            frame.sendTo(client, encoding);
+                            src->pollqueue.pop_front();
+                        }
                     }
+                    break;
                 }
-                break;
             }
+        };
+
+        if (m_host)
+        {
+            // Hosted extensions are called on the worker pool, so that a hung host does not hold up this thread
+            fetchDataFromSource(dsrc, answer);
+        }
+        else
+        {
+            QCborMap data;
+            auto     result = getDataFromSource(data, dsrc);
+
+            answer(result, data.value(dsrc.name));
         }
     }
     else
@@ -751,47 +1356,163 @@ void DataExtension::createTimer(DataSource& data)
 {
     if (data.enabled && !data.timer)
     {
-        // Timer creation required
-        data.timer = std::make_unique<QTimer>(this);
-        connect(data.timer.get(), &QTimer::timeout, [this, &data] { sendDataToSubscribers(data); });
+        // Sources sharing a rate, or multiples of it, tick on the same scheduler wakeup
+        data.tickrate = getTickRate(data);
+        data.timer    = m_scheduler->add(data.tickrate, [this, &data] { tickDataSource(data); });
+    }
+}
+
+bool DataExtension::detachSubscriber(DataSource& data, DataClient* subscriber)
+{
+    if (!data.subscribers.erase(subscriber))
+    {
+        return false;
+    }
+
+    qInfo() << "Widget unsubscribed from extension " << m_name << " data source " << data.name;
+
+    // Stop timer if no active subscribers, otherwise follow the fastest remaining subscriber
+    if (!hasActiveSubscribers(data))
+    {
+        destroyTimer(data);
+    }
+    else if (data.rate > QUASAR_POLLING_CLIENT)
+    {
+        updateTimerRate(data);
+    }
+
+    return true;
+}
+
+bool DataExtension::hasActiveSubscribers(const DataSource& data) const
+{
+    return std::any_of(data.subscribers.begin(), data.subscribers.end(), [](const auto& p) { return !p.first->isPaused(); });
+}
+
+void DataExtension::sendFreshData(DataSource& data, DataClient* subscriber)
+{
+    const auto           requested = std::chrono::steady_clock::now();
+    QPointer<DataClient> client    = subscriber;
+
+    fetchDataFromSource(data, [this, client, src = &data, requested](DataSourceReturnState result, const QCborValue& dat) {
+        if (result != GET_DATA_SUCCESS || !client || client->isPaused())
+        {
+            return;
+        }
+
+        auto it = src->subscribers.find(client);
+
+        // Already sent by a tick that shared this get_data call
+        if (it == src->subscribers.end() || it->second.lastsent >= requested)
+        {
+            return;
+        }
+
+        DataSubscriber& state = it->second;
+
+        QCborMap msg;
+        msg[src->name] = dat;
+
+        craftDataMessage(msg).sendTo(client, state.encoding);
+
+        // The shared patch of the next tick does not apply to this value, so delta subscribers get a full one
+        state.generation = 0;
+        state.lastsent   = std::chrono::steady_clock::now();
+        state.sent       = state.delta ? dat : QCborValue();
+    });
+}
+
+int64_t DataExtension::getTickRate(const DataSource& data)
+{
+    int64_t fastest = 0;
+
+    for (const auto& [sub, state] : data.subscribers)
+    {
+        if (sub->isPaused())
+        {
+            continue;
+        }
+
+        // Subscribers may only ask for a slower rate than the configured one
+        int64_t r = std::max(state.rate, data.rate);
+
+        if (!fastest || r < fastest)
+        {
+            fastest = r;
+        }
+    }
+
+    return fastest ? fastest : data.rate;
+}
+
+void DataExtension::updateTimerRate(DataSource& data)
+{
+    int64_t rate = getTickRate(data);
+
+    if (data.timer && rate != data.tickrate)
+    {
+        m_scheduler->setInterval(data.timer, rate);
+    }
 
-        data.timer->start(data.rate);
+    data.tickrate = rate;
+}
+
+void DataExtension::destroyTimer(DataSource& data)
+{
+    if (data.timer)
+    {
+        m_scheduler->remove(data.timer);
+        data.timer = 0;
     }
 }
 
-QString DataExtension::craftDataMessage(const QJsonObject& data, const QJsonArray& errors)
+DataFrame DataExtension::craftDataMessage(const QCborMap& data, const QCborArray& errors)
 {
     if (data.isEmpty() && errors.isEmpty())
     {
         // No data
-        return QString();
+        return DataFrame();
     }
 
-    QJsonObject msg;
+    QCborMap msg;
 
     if (!data.isEmpty())
     {
-        msg["data"] = QJsonObject{{m_name, data}};
+        QCborMap extdata;
+        extdata[m_name]             = data;
+        msg[QStringLiteral("data")] = extdata;
     }
 
     if (!errors.isEmpty())
     {
-        if (errors.count() == 1)
+        if (errors.size() == 1)
         {
-            msg["errors"] = errors.at(0);
+            msg[QStringLiteral("errors")] = errors.at(0);
         }
         else
         {
-            msg["errors"] = errors;
+            msg[QStringLiteral("errors")] = errors;
         }
     }
 
-    QJsonDocument doc(msg);
+    return DataFrame(msg);
+}
+
+DataFrame DataExtension::craftDeltaMessage(const QString& source, const QCborValue& patch)
+{
+    QCborMap srcdata;
+    srcdata[source] = patch;
+
+    QCborMap extdata;
+    extdata[m_name] = srcdata;
 
-    return QString::fromUtf8(doc.toJson());
+    QCborMap msg;
+    msg[QStringLiteral("delta")] = extdata;
+
+    return DataFrame(msg);
 }
 
-DataExtension::DataSourceReturnState DataExtension::getDataFromSource(QJsonObject& data, DataSource& src)
+bool DataExtension::getDataFromCache(DataSource& src, DataSourceReturnState& result, QCborValue& dat)
 {
     using namespace std::chrono;
 
@@ -803,8 +1524,9 @@ DataExtension::DataSourceReturnState DataExtension::getDataFromSource(QJsonObjec
         if (src.expiry >= system_clock::now())
         {
             // If data hasn't expired yet, use the cached data
-            data[src.name] = src.cacheddat;
-            return GET_DATA_SUCCESS;
+            dat    = src.cacheddat;
+            result = GET_DATA_SUCCESS;
+            return true;
         }
     }
 
@@ -812,19 +1534,32 @@ DataExtension::DataSourceReturnState DataExtension::getDataFromSource(QJsonObjec
     {
         // honour enabled flag
         qWarning() << "Data source " << src.name << " is disabled";
-        return GET_DATA_FAILED;
+        result = GET_DATA_FAILED;
+        return true;
     }
 
-    QJsonValue dat;
+    // Published values never call into the extension. This always runs on this object's thread,
+    // which makes it the publish buffer's only consumer.
+    if (src.published && src.published->read(dat))
+    {
+        result = GET_DATA_SUCCESS;
+        return true;
+    }
 
-    // Poll extension for data source
-    if (!m_extension->get_data(src.uid, &dat))
+    return false;
+}
+
+DataExtension::DataSourceReturnState DataExtension::processDataResult(DataSource& src, bool ok, const QCborValue& dat)
+{
+    using namespace std::chrono;
+
+    if (!ok)
     {
         qWarning() << "get_data(" << m_name << ", " << src.name << ") failed";
         return GET_DATA_FAILED;
     }
 
-    if (dat.isNull())
+    if (dat.isUndefined() || dat.isNull())
     {
         if (src.rate == QUASAR_POLLING_CLIENT)
         {
@@ -844,37 +1579,98 @@ DataExtension::DataSourceReturnState DataExtension::getDataFromSource(QJsonObjec
         src.expiry    = system_clock::now() + milliseconds(src.validtime);
     }
 
-    data[src.name] = dat;
-
     return GET_DATA_SUCCESS;
 }
 
-QString DataExtension::craftSettingsMessage()
+DataExtension::DataSourceReturnState DataExtension::getDataFromSource(QCborMap& data, DataSource& src)
 {
-    QString payload;
+    DataSourceReturnState result;
+    QCborValue            dat;
 
+    if (!getDataFromCache(src, result, dat))
+    {
+        // Poll extension for data source
+        bool ok = m_host ? m_host->getData(src.uid, &dat) : m_extension->get_data(src.uid, &dat);
+
+        result = processDataResult(src, ok, dat);
+    }
+
+    if (result == GET_DATA_SUCCESS)
+    {
+        data[src.name] = dat;
+    }
+
+    return result;
+}
+
+void DataExtension::fetchDataFromSource(DataSource& src, DataFetchCallback done)
+{
+    DataSourceReturnState result;
+    QCborValue            dat;
+
+    if (getDataFromCache(src, result, dat))
+    {
+        done(result, dat);
+        return;
+    }
+
+    auto& waiters = m_fetchwaiters[src.uid - m_uidbase];
+    waiters.push_back(std::move(done));
+
+    if (waiters.size() > 1)
+    {
+        // Share the get_data call already in flight
+        return;
+    }
+
+    m_workers->start(new DataFetchTask([this, host = m_host, getdata = m_extension->get_data, uid = src.uid] {
+        QCborValue dat;
+        bool       ok = host ? host->getData(uid, &dat) : getdata(uid, &dat);
+
+        // Marshal the result back to this object's thread for fan-out
+        QMetaObject::invokeMethod(
+            this,
+            [this, uid, ok, dat] {
+                auto waiters = std::move(m_fetchwaiters[uid - m_uidbase]);
+                m_fetchwaiters[uid - m_uidbase].clear();
+
+                auto result = processDataResult(*getSource(uid), ok, dat);
+
+                for (auto& cb : waiters)
+                {
+                    cb(result, dat);
+                }
+            },
+            Qt::QueuedConnection);
+    }));
+}
+
+DataFrame DataExtension::craftSettingsMessage()
+{
     if (m_settings)
     {
         auto mdat = getMetadataJSON(true);
         auto msg  = QJsonObject{{"data", QJsonObject{{"settings", QJsonObject{{m_name, mdat}}}}}};
 
-        QJsonDocument doc(msg);
-        payload = QString::fromUtf8(doc.toJson());
+        return DataFrame(msg);
     }
 
-    return payload;
+    return DataFrame();
 }
 
 void DataExtension::propagateSettingsToAllUniqueSubscribers()
 {
     if (m_settings)
     {
-        std::unordered_set<QWebSocket*> unique_subs;
+        std::unordered_map<DataClient*, DataEncoding> unique_subs;
 
         // Collect unique subscribers
         for (auto& source : m_datasources)
         {
-            unique_subs.insert(source.second.subscribers.begin(), source.second.subscribers.end());
+            for (auto& [sub, state] : source.second.subscribers)
+            {
+                unique_subs.emplace(sub, state.encoding);
+            }
         }
 
         auto payload = craftSettingsMessage();
@@ -882,9 +1678,9 @@ void DataExtension::propagateSettingsToAllUniqueSubscribers()
         if (!payload.isEmpty())
         {
             // Send the payload
-            for (auto sub : unique_subs)
+            for (auto& [sub, encoding] : unique_subs)
             {
-                sub->sendTextMessage(payload);
+                payload.sendTo(sub, encoding);
             }
         }
     }
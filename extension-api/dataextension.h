@@ -6,21 +6,34 @@
 
 #include <qstring_hash_impl.h>
 
+#include <dataframe.h>
+#include <datapublish.h>
+#include <datapush.h>
+#include <datascheduler.h>
 #include <extension_types.h>
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <deque>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
-#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <tsl/ordered_map.h>
 
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
 #include <QJsonArray>
-#include <QJsonValue>
 #include <QObject>
-#include <QTimer>
+
+class ExtensionHost;
 
 //! Internal setting prefix for Data Source enabled UI toggle
 #define QUASAR_DP_ENABLED "/enabled"
@@ -34,7 +47,9 @@
 #    define PAPI_EXPORT Q_DECL_IMPORT
 #endif // PLUGINAPI_LIB
 
-QT_FORWARD_DECLARE_CLASS(QWebSocket)
+QT_FORWARD_DECLARE_CLASS(QThreadPool)
+
+class DataClient;
 
 /*! Holds the mutex and accompanying conditional variable for
     asynchronous or extension signaled Data Sources.
@@ -46,6 +61,21 @@ struct DataLock
     bool                    processed = false; //!< Bool value to trigger conditional variable notification
 };
 
+//! Number of ticks between full keyframes sent to delta subscribers
+#define QUASAR_DELTA_KEYFRAME_TICKS 100
+
+//! Struct holding the state of a single subscription to a Data Source
+struct DataSubscriber
+{
+    DataEncoding                          encoding   = DATA_ENCODING_JSON; //!< Wire encoding negotiated by the subscriber
+    bool                                  delta      = false;              //!< Whether the subscriber receives delta patches instead of full values
+    uint64_t                              generation = 0;                  //!< Generation of the last value sent to the subscriber \sa DataSource.generation
+    uint64_t                              epoch      = 0;                  //!< Client resync epoch when the last value was sent \sa DataClient::resyncEpoch()
+    int64_t                               rate       = 0;                  //!< Requested interval between values in milliseconds, 0 for every value
+    std::chrono::steady_clock::time_point lastsent;                        //!< Time the last value was sent to the subscriber
+    QCborValue                            sent;                            //!< Last value sent to a delta subscriber, patched from when it skips ticks
+};
+
 //! Struct containing internal resources for a Data Source
 struct DataSource
 {
@@ -58,18 +88,32 @@ struct DataSource
                         //!< quasar_polling_type_t
 
     // subscription type source fields
-    std::unique_ptr<QTimer> timer;       //!< QTimer for timer based subscription sources
-    std::set<QWebSocket*>   subscribers; //!< Set of widgets (i.e. its WebSocket instance) subscribed to this source
+    DataScheduler::TaskId                 timer    = 0; //!< Scheduler task for timer based subscription sources, 0 if not scheduled \sa DataScheduler
+    int64_t                               tickrate = 0; //!< Interval the timer runs at, the fastest rate among subscribers \sa DataSubscriber.rate
+    std::map<DataClient*, DataSubscriber> subscribers;  //!< Widgets (i.e. its client connection) subscribed to this source \sa DataSubscriber
+    std::chrono::steady_clock::time_point lastfanout;   //!< Time data was last sent to subscribers
+    std::chrono::steady_clock::duration   ticklen{};    //!< Time between the last two fan outs, used to decimate for slower subscribers
+
+    std::unique_ptr<std::atomic<uint64_t>> ticks; //!< Number of timer ticks, read from worker threads \sa getTickCount()
+
+    // delta subscription fields
+    QCborValue lastdat;        //!< Last value sent to subscribers, used to compute delta patches
+    uint64_t   generation = 0; //!< Number of values sent to subscribers. Delta patches are only valid for subscribers at the previous generation
 
     // poll type
-    std::deque<QWebSocket*> pollqueue; //!< Queue of widgets (i.e. its WebSocket instance) waiting for polled data
-    QJsonValue              cacheddat; //!< Cached data for polled data with a validity duration \sa quasar_data_source_t.rate, quasar_data_source_t.validtime,
+    std::deque<std::pair<DataClient*, DataEncoding>> pollqueue; //!< Queue of widgets (i.e. its client connection) waiting for polled data
+    QCborValue              cacheddat; //!< Cached data for polled data with a validity duration \sa quasar_data_source_t.rate, quasar_data_source_t.validtime,
                                        //!< quasar_polling_type_t
     std::chrono::system_clock::time_point
         expiry; //!< Expiry time of cached data \sa quasar_data_source_t.rate, quasar_data_source_t.validtime, quasar_polling_type_t
 
     // signaled type source fields
     std::unique_ptr<DataLock> locks; //!< Mutex/cv for asynchronous or extension signaled sources \sa DataLock
+
+    std::unique_ptr<DataPushRing> pushring; //!< Frames pushed by the extension for signaled sources \sa quasar_push_commit()
+
+    // published data fields
+    std::unique_ptr<DataPublishBuffer> published; //!< Latest value published by the extension, used instead of get_data once set \sa quasar_publish_commit()
 };
 
 //! Shorthand for m_datasources type
@@ -80,6 +124,8 @@ class PAPI_EXPORT DataExtension : public QObject
 {
     Q_OBJECT;
 
+    friend class ExtensionHost;
+
     //! Defines valid return values for getDataFromSource()
     enum DataSourceReturnState : int8_t
     {
@@ -88,6 +134,9 @@ class PAPI_EXPORT DataExtension : public QObject
         GET_DATA_SUCCESS = 1   //!< data successfully retrieved
     };
 
+    //! Shorthand type for fetchDataFromSource() callbacks
+    using DataFetchCallback = std::function<void(DataSourceReturnState, const QCborValue&)>;
+
 public:
     //! Shorthand type for quasar_extension_load()
     using extension_load = std::add_pointer_t<quasar_ext_info_t*(void)>;
@@ -95,42 +144,110 @@ public:
     //! Shorthand type for quasar_extension_destroy()
     using extension_destroy = std::add_pointer_t<void(quasar_ext_info_t*)>;
 
+    //! Shorthand type for the completion callback of pollData(), given the data by source and any errors
+    using DataPollCallback = std::function<void(const QCborMap&, const QCborArray&)>;
+
     //! DataExtension destructor
     ~DataExtension();
 
     //! Data Source uid counter
-    static uintmax_t _uid;
+    /*! Holds the last uid handed out. Extensions reserve a block of uids at once, as they may be loaded concurrently
+    */
+    static std::atomic<uintmax_t> _uid;
 
     //! Load an extension
     /*!
-        \param[in]  libpath Path to library file
-        \param[in]  parent  Parent element in Qt object tree
+        \param[in]  libpath     Path to library file
+        \param[in]  scheduler   Scheduler driving timer-based Data Sources
+        \param[in]  parent      Parent element in Qt object tree
+        \param[in]  isolated    Whether to run the extension in its own host process \sa ExtensionHost
+        \return Pointer to a DataExtension instance if successful, nullptr otherwise
+    */
+    static DataExtension* load(QString libpath, DataScheduler* scheduler, QObject* parent = nullptr, bool isolated = false);
+
+    //! Creates an extension built into Quasar
+    /*! Built-in extensions have no library, their info struct is provided and kept alive by the caller.
+        \param[in]  p           Extension info struct
+        \param[in]  context     Object implementing the extension, handed back by getBuiltinContext()
+        \param[in]  scheduler   Scheduler driving timer-based Data Sources
+        \param[in]  parent      Parent element in Qt object tree
         \return Pointer to a DataExtension instance if successful, nullptr otherwise
     */
-    static DataExtension* load(QString libpath, QObject* parent = nullptr);
+    static DataExtension* loadBuiltin(quasar_ext_info_t* p, void* context, DataScheduler* scheduler, QObject* parent = nullptr);
+
+    /*! Gets the object implementing a built-in extension, for its functions to find it from the handle
+        \return context given to loadBuiltin(), nullptr for extension libraries
+    */
+    void* getBuiltinContext() { return m_builtincontext; };
 
     //! Adds a subscriber to a Data Source
     /*!
         \param[in]  source      Data Source identifier
-        \param[in]  subscriber  Subscriber widget's websocket connection instance
+        \param[in]  subscriber  Subscriber widget's client connection
         \param[in]  widgetName  Widget name
+        \param[in]  encoding    Wire encoding negotiated by the subscriber
+        \param[in]  delta       Whether the subscriber receives delta patches instead of full values \sa datadelta.h
+        \param[in]  rate        Requested interval between values in milliseconds, or 0 for every value.
+                                Rates faster than the Data Source's configured rate receive every value.
         \return true if successful, false otherwise
     */
-    bool addSubscriber(QString source, QWebSocket* subscriber, QString widgetName);
+    bool addSubscriber(QString      source,
+                       DataClient*  subscriber,
+                       QString      widgetName,
+                       DataEncoding encoding = DATA_ENCODING_JSON,
+                       bool         delta    = false,
+                       int64_t      rate     = 0);
 
     //! Removes a subscriber from all Data Sources
-    /*! Invoked when a widget is closed or disconnects
-        \param[in]  subscriber  Subscriber widget's websocket connection instance
+    /*! Invoked when a widget is closed or disconnects. Only visits the sources the subscriber is subscribed to.
+        \param[in]  subscriber  Subscriber widget's client connection
+    */
+    void removeSubscriber(DataClient* subscriber);
+
+    //! Removes a subscriber from a single Data Source
+    /*! Invoked when a widget unsubscribes. The source's timer stops once its last subscriber leaves.
+        \param[in]  source      Data Source identifier
+        \param[in]  subscriber  Subscriber widget's client connection
+        \return true if the subscriber was subscribed to the source, false otherwise
+    */
+    bool removeSubscriber(QString source, DataClient* subscriber);
+
+    //! Pauses or resumes a subscriber on all of its Data Sources
+    /*! Invoked after DataClient::setPaused(). Timers of sources left without active subscribers stop,
+        and resumed subscribers of timer-based sources are sent a fresh value right away.
+        \param[in]  subscriber  Subscriber widget's client connection
+        \param[in]  paused      Whether the subscriber was paused or resumed
+        \sa DataClient::setPaused()
     */
-    void removeSubscriber(QWebSocket* subscriber);
+    void setSubscriberPaused(DataClient* subscriber, bool paused);
+
+    /*! Checks whether a client is subscribed to any of this extension's Data Sources
+        \param[in]  subscriber  Subscriber widget's client connection
+        \return true if subscribed to at least one Data Source, false otherwise
+    */
+    bool hasSubscriber(DataClient* subscriber) const { return m_clientsources.count(subscriber) > 0; }
 
     //! Polls the extension for data and sends it to the requesting widget
     /*! Called when the extension receives a widget "poll" request
         \param[in]  source      Data Source identifier
-        \param[in]  client      Requesting widget's websocket connection instance
+        \param[in]  client      Requesting widget's client connection
         \param[in]  widgetName  Widget name
+        \param[in]  encoding    Wire encoding negotiated by the client
     */
-    void pollAndSendData(QString source, QWebSocket* client, QString widgetName);
+    void pollAndSendData(QString source, DataClient* client, QString widgetName, DataEncoding encoding = DATA_ENCODING_JSON);
+
+    //! Polls the extension for data without sending it
+    /*! Every source is retrieved on the worker pool, and done is called on this object's thread
+        once all of them returned, so that the caller can merge the results with other extensions'.
+        Sources that delay their data are answered to the client separately when the data is ready.
+        \param[in]  source      Comma separated Data Source identifiers
+        \param[in]  client      Requesting widget's client connection
+        \param[in]  widgetName  Widget name
+        \param[in]  encoding    Wire encoding negotiated by the client
+        \param[in]  done        Called with the retrieved data by source and any errors
+        \sa pollAndSendData()
+    */
+    void pollData(QString source, DataClient* client, QString widgetName, DataEncoding encoding, DataPollCallback done);
 
     /*! Gets path to library file
         \return path to library file
@@ -197,6 +314,77 @@ public:
     */
     void waitDataProcessed(QString source);
 
+    /*! Schedules the data of a Data Source to be sent, looked up by uid
+        \param[in]  uid     Data Source uid
+        \sa quasar_signal_data_ready_uid()
+    */
+    void emitDataReady(size_t uid);
+
+    /*! Gets the number of times the timer of a Data Source ticked. May be called from any thread
+        Lets built-in sources tell the get_data calls of ticks from those of queries and new subscribers.
+        \param[in]  uid     Data Source uid
+        \return number of ticks, 0 for sources that are not timer based
+    */
+    uint64_t getTickCount(size_t uid);
+
+    /*! Waits for a set of data to be sent to clients before processing the next set, looked up by uid
+        \param[in]  uid     Data Source uid
+        \sa quasar_signal_wait_processed_uid()
+    */
+    void waitDataProcessed(size_t uid);
+
+    /*! Gets the buffer the extension publishes a Data Source's values into
+        \param[in]  source  Data Source identifier
+        \return Publish buffer, nullptr if the source is unknown or extension signaled
+        \sa quasar_publish_begin(), quasar_publish_commit()
+    */
+    DataPublishBuffer* getPublishBuffer(QString source);
+
+    /*! Gets the buffer the extension publishes a Data Source's values into, looked up by uid
+        \param[in]  uid     Data Source uid
+        \return Publish buffer, nullptr if the source is unknown or extension signaled
+        \sa quasar_publish_begin_uid(), quasar_publish_commit_uid()
+    */
+    DataPublishBuffer* getPublishBuffer(size_t uid);
+
+    /*! Replaces the push ring of a Data Source
+        Only valid while the extension is initializing, before anything was pushed.
+        \param[in]  source      Data Source identifier
+        \param[in]  capacity    Number of frames the ring holds
+        \param[in]  policy      What to do when the ring is full
+        \return true if successful, false if the source is unknown or not extension signaled
+        \sa quasar_push_configure()
+    */
+    bool configurePushRing(QString source, size_t capacity, quasar_push_overflow_t policy);
+
+    /*! Gets the ring the extension pushes a Data Source's frames into
+        \param[in]  source  Data Source identifier
+        \return Push ring, nullptr if the source is unknown or not extension signaled
+        \sa quasar_push_begin(), quasar_push_commit()
+    */
+    DataPushRing* getPushRing(QString source);
+
+    /*! Gets the ring the extension pushes a Data Source's frames into, looked up by uid
+        \param[in]  uid     Data Source uid
+        \return Push ring, nullptr if the source is unknown or not extension signaled
+        \sa quasar_push_begin_uid(), quasar_push_commit_uid()
+    */
+    DataPushRing* getPushRing(size_t uid);
+
+    /*! Pushes the frame written into a Data Source's push ring and schedules a drain if needed
+        \param[in]  source  Data Source identifier
+        \return true if pushed, false if dropped or the source is unknown
+        \sa quasar_push_commit()
+    */
+    bool commitPush(QString source);
+
+    /*! Pushes the frame written into a Data Source's push ring, looked up by uid
+        \param[in]  uid     Data Source uid
+        \return true if pushed, false if dropped or the source is unknown
+        \sa quasar_push_commit_uid()
+    */
+    bool commitPush(size_t uid);
+
 signals:
     /*! Qt data ready signal
         \param[in]  source  Data Source identifier
@@ -212,15 +400,41 @@ private slots:
     void handleDataReadySignal(QString source);
 
 private:
+    /*! Gets a Data Source by uid
+        \param[in]  uid     Data Source uid
+        \return Data Source, nullptr if the uid does not belong to this extension
+    */
+    DataSource* getSource(size_t uid) { return uid - m_uidbase < m_sourcesbyuid.size() ? m_sourcesbyuid[uid - m_uidbase] : nullptr; }
+
+    /*! Sends the data of an async-polled or signaled source once the extension signaled it ready
+        \param[in]  dsrc    Reference to the Data Source object
+        \sa handleDataReadySignal()
+    */
+    void handleDataReady(DataSource& dsrc);
+
+    /*! Waits until the last set of data of a signaled source was sent
+        \param[in]  data    Reference to the Data Source object
+    */
+    static void waitProcessed(DataSource& data);
+
     //! DataExtension constructor
     /*! DataExtension::load() should be used to load and create a DataExtension instance
         \param[in]  p           extension info struct
         \param[in]  destroyfunc Function pointer to the extension destroy function
         \param[in]  path        Library path
+        \param[in]  scheduler   Scheduler driving timer-based Data Sources
         \param[in]  parent      Qt parent object
+        \param[in]  host        Host process running the extension, if isolated. Taken over by this object
+        \param[in]  context     Object implementing a built-in extension \sa loadBuiltin()
         \sa quasar_ext_info_t, quasar_extension_destroy()
     */
-    DataExtension(quasar_ext_info_t* p, extension_destroy destroyfunc, QString path, QObject* parent = nullptr);
+    DataExtension(quasar_ext_info_t* p,
+                  extension_destroy  destroyfunc,
+                  QString            path,
+                  DataScheduler*     scheduler,
+                  QObject*           parent  = nullptr,
+                  ExtensionHost*     host    = nullptr,
+                  void*              context = nullptr);
 
     // Helpers
 
@@ -244,37 +458,135 @@ private:
     void setDataSourceRefresh(QString source, int64_t msec);
 
     //! Retrieves data from the extension and sends it to all subscribers
-    /*! Called when extension data is ready to be sent (by both timer and signal)
+    /*! Called when extension signaled data is ready to be sent
         \param[in]  source  Data Source
     */
     void sendDataToSubscribers(DataSource& source);
 
-    /*! Creates and initializes the timer for a timer-based source (if it does not exist)
+    //! Releases quasar_signal_wait_processed() once signaled data was sent
+    /*! \param[in]  source  Data Source
+    */
+    void signalDataProcessed(DataSource& source);
+
+    //! Retrieves data from the extension on the worker pool and sends it to all subscribers
+    /*! Called on every timer tick. Ticks are skipped while the previous tick's get_data call is still running.
+        \param[in]  source  Data Source
+        \sa fetchDataFromSource()
+    */
+    void tickDataSource(DataSource& source);
+
+    //! Sends data retrieved from a Data Source to all of its subscribers
+    /*!
+        \param[in]  source  Data Source
+        \param[in]  data    Data retrieved from the source \sa getDataFromSource()
+    */
+    void fanOutData(DataSource& source, const QCborMap& data);
+
+    /*! Sends the frames pushed into a Data Source's push ring to its subscribers
+        At most a ring's capacity of frames is sent per call, another drain is scheduled for the rest.
+        \param[in]  source  Reference to the Data Source object
+    */
+    void drainPushRing(DataSource& source);
+
+    /*! Schedules the ticks of a timer-based source (if not already scheduled)
         \param[in,out]  data    Reference to the Data Source object
         \sa DataSource.timer
     */
     void createTimer(DataSource& data);
 
+    /*! Detaches a subscriber from a Data Source, stopping or rescheduling its timer as needed
+        \param[in,out]  data        Reference to the Data Source object
+        \param[in]      subscriber  Subscriber widget's client connection
+        \return true if the subscriber was subscribed to the source, false otherwise
+    */
+    bool detachSubscriber(DataSource& data, DataClient* subscriber);
+
+    /*! Checks whether a Data Source has subscribers that are not paused
+        \param[in]  data    Reference to the Data Source object
+        \return true if at least one subscriber is not paused, false otherwise
+        \sa DataClient::isPaused()
+    */
+    bool hasActiveSubscribers(const DataSource& data) const;
+
+    /*! Retrieves a fresh value from a timer-based source and sends it to a single subscriber
+        \param[in]  data        Reference to the Data Source object
+        \param[in]  subscriber  Subscriber widget's client connection
+        \sa setSubscriberPaused()
+    */
+    void sendFreshData(DataSource& data, DataClient* subscriber);
+
+    /*! Gets the interval a timer-based source should tick at
+        \param[in]  data    Reference to the Data Source object
+        \return the fastest rate among active subscribers, no faster than the source's configured rate
+        \sa DataSource.tickrate
+    */
+    int64_t getTickRate(const DataSource& data);
+
+    /*! Reschedules a timer-based source after its rate or subscribers changed
+        \param[in,out]  data    Reference to the Data Source object
+        \sa getTickRate()
+    */
+    void updateTimerRate(DataSource& data);
+
+    /*! Stops the ticks of a timer-based source (if scheduled)
+        \param[in,out]  data    Reference to the Data Source object
+        \sa DataSource.timer
+    */
+    void destroyTimer(DataSource& data);
+
     /*! Crafts the data message to be sent to clients
-        \param[in]  data    JSON Object containing the data to be sent to the client
+        The message is encoded at most once per wire encoding so that it can be shared by all recipients.
+        \param[in]  data    Map containing the data to be sent to the client
         \param[in]  errors  Errors occurred that are also sent to the client
         \return The data message
+        \sa DataFrame
+    */
+    DataFrame craftDataMessage(const QCborMap& data, const QCborArray& errors = QCborArray());
+
+    /*! Crafts the delta message to be sent to delta subscribers
+        \param[in]  source  Data Source identifier
+        \param[in]  patch   Delta patch for the source \sa computeDataDelta()
+        \return The delta message
     */
-    QString craftDataMessage(const QJsonObject& data, const QJsonArray& errors = QJsonArray());
+    DataFrame craftDeltaMessage(const QString& source, const QCborValue& patch);
 
-    /*! Retrieves data from a data source and saves it to the supplied JSON object as JSON data
-        \param[in]  data    Reference to the JSON object to save data to
+    /*! Retrieves data from a data source and saves it to the supplied map
+        \param[in]  data    Reference to the map to save data to
         \param[in]  src     Reference to the Data Source object
         \return DataSourceReturnState value determining state of data retrieval
         \sa DataSourceReturnState
     */
-    DataSourceReturnState getDataFromSource(QJsonObject& data, DataSource& src);
+    DataSourceReturnState getDataFromSource(QCborMap& data, DataSource& src);
+
+    /*! Retrieves data from a data source on the worker pool
+        Requests for a source that is already being retrieved share the get_data call in flight.
+        \param[in]  src     Reference to the Data Source object
+        \param[in]  done    Called on this object's thread with the result and the retrieved data
+        \sa DataSourceReturnState
+    */
+    void fetchDataFromSource(DataSource& src, DataFetchCallback done);
+
+    /*! Answers a data request without calling into the extension, if possible
+        \param[in]  src     Reference to the Data Source object
+        \param[out] result  Result of the request, if answered
+        \param[out] dat     Cached data, if answered successfully
+        \return true if the request was answered, false if get_data needs to be called
+    */
+    bool getDataFromCache(DataSource& src, DataSourceReturnState& result, QCborValue& dat);
+
+    /*! Processes the return of a get_data call, caching the data if applicable
+        \param[in]  src     Reference to the Data Source object
+        \param[in]  ok      Return value of get_data
+        \param[in]  dat     Data set by get_data
+        \return DataSourceReturnState value determining state of data retrieval
+    */
+    DataSourceReturnState processDataResult(DataSource& src, bool ok, const QCborValue& dat);
 
     /*! Crafts the custom settings message to be sent to subscribers
         \return The settings message
         \sa updateExtensionSettings()
     */
-    QString craftSettingsMessage();
+    DataFrame craftSettingsMessage();
 
     /*! Propagates custom setting value changes to the extension
         as well as all unique subscribers
@@ -290,8 +602,10 @@ private:
 
     // Members
 
-    quasar_ext_info_t* m_extension;   //!< Extension info data \sa quasar_ext_info_t
-    extension_destroy  m_destroyfunc; //!< Extension destroy function \sa quasar_ext_destroy()
+    quasar_ext_info_t* m_extension;      //!< Extension info data \sa quasar_ext_info_t
+    extension_destroy  m_destroyfunc;    //!< Extension destroy function \sa quasar_ext_destroy()
+    ExtensionHost*     m_host           = nullptr; //!< Host process running the extension, if isolated. Calls go through it instead of m_extension
+    void*              m_builtincontext = nullptr; //!< Object implementing a built-in extension \sa loadBuiltin()
 
     std::unique_ptr<quasar_settings_t> m_settings; //!< Extension settings \sa quasar_settings_t
 
@@ -303,5 +617,13 @@ private:
     QString m_version;  //!< Extension version string
     QString m_url;      //!< Extension url, if any
 
-    DataSourceMapType m_datasources; //!< Map of Data Sources provided by this extension
+    DataSourceMapType        m_datasources;  //!< Map of Data Sources provided by this extension
+    std::vector<DataSource*> m_sourcesbyuid; //!< Data Sources by uid, offset by m_uidbase. Uids of an extension are contiguous
+    uintmax_t                m_uidbase = 0;  //!< Uid of the first Data Source
+
+    std::unordered_map<DataClient*, std::unordered_set<QString>> m_clientsources; //!< Data Sources each subscriber is subscribed to
+
+    DataScheduler*                              m_scheduler;         //!< Scheduler driving timer-based Data Sources
+    QThreadPool*                                m_workers = nullptr; //!< Worker pool running get_data calls
+    std::vector<std::vector<DataFetchCallback>> m_fetchwaiters;      //!< Callbacks waiting on in-flight get_data calls, by uid offset by m_uidbase
 };
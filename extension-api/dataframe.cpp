@@ -0,0 +1,280 @@
+#include "dataframe.h"
+#include "dataclient.h"
+#include "extension_support_internal.h"
+
+#include <cmath>
+#include <cstring>
+
+#include <QCborArray>
+#include <QCborValue>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocale>
+
+namespace
+{
+    //! Largest integer magnitude that survives a round trip through a double
+    constexpr double MAX_SAFE_INTEGER = 9007199254740992.0;
+
+    void writeJsonNumber(QByteArray& out, double d)
+    {
+        if (!std::isfinite(d))
+        {
+            // JSON has no representation for these, same as QJsonDocument
+            out.append("null");
+        }
+        else if (std::trunc(d) == d && std::fabs(d) <= MAX_SAFE_INTEGER)
+        {
+            out.append(QByteArray::number(static_cast<qint64>(d)));
+        }
+        else
+        {
+            out.append(QByteArray::number(d, 'g', QLocale::FloatingPointShortest));
+        }
+    }
+
+    void writeJsonString(QByteArray& out, const QString& str)
+    {
+        static const char hex[] = "0123456789abcdef";
+
+        const QByteArray utf8 = str.toUtf8();
+
+        out.append('"');
+
+        for (char c : utf8)
+        {
+            switch (c)
+            {
+                case '"':
+                    out.append("\\\"");
+                    break;
+                case '\\':
+                    out.append("\\\\");
+                    break;
+                case '\n':
+                    out.append("\\n");
+                    break;
+                case '\r':
+                    out.append("\\r");
+                    break;
+                case '\t':
+                    out.append("\\t");
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20)
+                    {
+                        out.append("\\u00");
+                        out.append(hex[(c >> 4) & 0xf]);
+                        out.append(hex[c & 0xf]);
+                    }
+                    else
+                    {
+                        out.append(c);
+                    }
+                    break;
+            }
+        }
+
+        out.append('"');
+    }
+
+    template <typename T>
+    void writeJsonTypedArray(QByteArray& out, const QByteArray& bytes)
+    {
+        const int   count = bytes.size() / int(sizeof(T));
+        const char* in    = bytes.constData();
+
+        out.append('[');
+
+        for (int i = 0; i < count; i++)
+        {
+            T v;
+            std::memcpy(&v, in + i * sizeof(T), sizeof(T));
+
+            if (i)
+            {
+                out.append(',');
+            }
+
+            writeJsonNumber(out, static_cast<double>(v));
+        }
+
+        out.append(']');
+    }
+
+    bool writeJsonTag(QByteArray& out, const QCborValue& val)
+    {
+        const QCborValue tagged = val.taggedValue();
+
+        if (!tagged.isByteArray())
+        {
+            return false;
+        }
+
+        switch (static_cast<quint64>(val.tag()))
+        {
+            case QUASAR_TYPED_ARRAY_INT32:
+                writeJsonTypedArray<qint32>(out, tagged.toByteArray());
+                return true;
+
+            case QUASAR_TYPED_ARRAY_FLOAT32:
+                writeJsonTypedArray<float>(out, tagged.toByteArray());
+                return true;
+
+            case QUASAR_TYPED_ARRAY_FLOAT64:
+                writeJsonTypedArray<double>(out, tagged.toByteArray());
+                return true;
+        }
+
+        return false;
+    }
+
+    void writeJson(QByteArray& out, const QCborValue& val)
+    {
+        switch (val.type())
+        {
+            case QCborValue::False:
+                out.append("false");
+                return;
+
+            case QCborValue::True:
+                out.append("true");
+                return;
+
+            case QCborValue::Integer:
+                out.append(QByteArray::number(val.toInteger()));
+                return;
+
+            case QCborValue::Double:
+                writeJsonNumber(out, val.toDouble());
+                return;
+
+            case QCborValue::String:
+                writeJsonString(out, val.toString());
+                return;
+
+            case QCborValue::Array:
+            {
+                const QCborArray arr = val.toArray();
+                bool             sep = false;
+
+                out.append('[');
+                for (const auto& v : arr)
+                {
+                    if (sep)
+                    {
+                        out.append(',');
+                    }
+
+                    writeJson(out, v);
+                    sep = true;
+                }
+                out.append(']');
+                return;
+            }
+
+            case QCborValue::Map:
+            {
+                const QCborMap map = val.toMap();
+                bool           sep = false;
+
+                out.append('{');
+                for (auto it = map.constBegin(); it != map.constEnd(); ++it)
+                {
+                    if (sep)
+                    {
+                        out.append(',');
+                    }
+
+                    writeJsonString(out, it.key().toString());
+                    out.append(':');
+                    writeJson(out, it.value());
+                    sep = true;
+                }
+                out.append('}');
+                return;
+            }
+
+            case QCborValue::Null:
+            case QCborValue::Undefined:
+                out.append("null");
+                return;
+
+            case QCborValue::Tag:
+                if (writeJsonTag(out, val))
+                {
+                    return;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        // Anything else is rare enough to go through Qt's own conversion
+        const QByteArray wrapped = QJsonDocument(QJsonArray{val.toJsonValue()}).toJson(QJsonDocument::Compact);
+        out.append(wrapped.constData() + 1, wrapped.size() - 2);
+    }
+}
+
+DataFrame::DataFrame(const QJsonObject& msg) : m_msg(QCborMap::fromJsonObject(msg)) {}
+
+DataFrame::DataFrame(const QCborMap& msg) : m_msg(msg) {}
+
+const QString& DataFrame::toText() const
+{
+    if (m_text.isNull() && !m_msg.isEmpty())
+    {
+        QByteArray json;
+        writeJson(json, m_msg);
+        m_text = QString::fromUtf8(json);
+    }
+
+    return m_text;
+}
+
+const QByteArray& DataFrame::toCbor() const
+{
+    if (m_cbor.isNull() && !m_msg.isEmpty())
+    {
+        m_cbor = m_msg.toCborValue().toCbor();
+    }
+
+    return m_cbor;
+}
+
+void DataFrame::sendTo(DataClient* client, DataEncoding encoding) const
+{
+    if (!client || isEmpty())
+    {
+        return;
+    }
+
+    if (client->isBatching())
+    {
+        client->queueBatchMessage(m_msg, encoding);
+        return;
+    }
+
+    client->sendFrame(*this, encoding);
+}
+
+DataEncoding DataFrame::encodingFromString(const QString& name, bool* ok)
+{
+    if (ok)
+    {
+        *ok = true;
+    }
+
+    if (name == QLatin1String("cbor"))
+    {
+        return DATA_ENCODING_CBOR;
+    }
+
+    if (name != QLatin1String("json") && ok)
+    {
+        *ok = false;
+    }
+
+    return DATA_ENCODING_JSON;
+}
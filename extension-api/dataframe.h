@@ -0,0 +1,99 @@
+/*! \file
+    \brief Defines the DataFrame class and the wire encodings supported by the Data Server
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QCborMap>
+#include <QJsonObject>
+#include <QString>
+
+#ifndef PAPI_EXPORT
+#    ifdef PLUGINAPI_LIB
+#        define PAPI_EXPORT Q_DECL_EXPORT
+#    else
+#        define PAPI_EXPORT Q_DECL_IMPORT
+#    endif // PLUGINAPI_LIB
+#endif     // PAPI_EXPORT
+
+class DataClient;
+
+//! Defines the wire encodings a client can negotiate during the auth handshake
+enum DataEncoding : uint8_t
+{
+    DATA_ENCODING_JSON = 0, //!< Compact JSON sent as text frames (default)
+    DATA_ENCODING_CBOR      //!< CBOR sent as binary frames. Typed array data is sent as RFC 8746 typed arrays
+};
+
+//! An outgoing Data Server message
+/*! A DataFrame is built once and then handed to every recipient of the message.
+    Each wire encoding is produced at most once per frame, on first use, and the
+    encoded buffer is implicitly shared by every client it is sent to.
+
+    Messages are held as CBOR values so that typed array data set by extensions
+    stays a single contiguous buffer until it is encoded. The JSON encoding
+    expands typed arrays into plain number arrays.
+*/
+class PAPI_EXPORT DataFrame
+{
+public:
+    //! Constructs an empty frame
+    DataFrame() = default;
+
+    //! Constructs a frame for a message
+    /*!
+        \param[in]  msg Message contents
+    */
+    explicit DataFrame(const QJsonObject& msg);
+
+    //! Constructs a frame for a message
+    /*!
+        \param[in]  msg Message contents
+    */
+    explicit DataFrame(const QCborMap& msg);
+
+    /*! Checks whether this frame carries a message
+        \return true if the frame is empty, false otherwise
+    */
+    bool isEmpty() const { return m_msg.isEmpty(); }
+
+    /*! Gets the message carried by this frame
+        \return the message contents
+    */
+    const QCborMap& message() const { return m_msg; }
+
+    /*! Gets the compact JSON encoding of this frame
+        \return JSON text
+    */
+    const QString& toText() const;
+
+    /*! Gets the CBOR encoding of this frame
+        \return CBOR data
+    */
+    const QByteArray& toCbor() const;
+
+    //! Sends this frame to a client
+    /*! If the client is holding a reply batch, the message is merged into the batch instead.
+        Otherwise it is subject to the client's outbound limits.
+        \param[in]  client      Recipient client connection
+        \param[in]  encoding    Wire encoding negotiated by the client
+        \sa DataEncoding, DataClient::beginBatch(), DataClient::sendFrame()
+    */
+    void sendTo(DataClient* client, DataEncoding encoding) const;
+
+    //! Parses an encoding name as sent by clients in the auth handshake
+    /*!
+        \param[in]  name    Encoding name ("json" or "cbor")
+        \param[out] ok      Set to false if the name is not a known encoding
+        \return The encoding, or \ref DATA_ENCODING_JSON if unknown
+    */
+    static DataEncoding encodingFromString(const QString& name, bool* ok = nullptr);
+
+private:
+    QCborMap           m_msg;  //!< Message contents
+    mutable QString    m_text; //!< Cached JSON encoding
+    mutable QByteArray m_cbor; //!< Cached CBOR encoding
+};
@@ -0,0 +1,30 @@
+#include "datapublish.h"
+
+DataPublishBuffer::DataPublishBuffer() {}
+
+void DataPublishBuffer::commit()
+{
+    // Hand the written buffer over and take the middle one, whether or not the consumer saw it
+    uint8_t prev = m_middle.exchange(m_write | FRESH, std::memory_order_acq_rel);
+    m_write      = static_cast<uint8_t>(prev & ~FRESH);
+
+    m_published.store(true, std::memory_order_release);
+}
+
+bool DataPublishBuffer::read(QCborValue& dat)
+{
+    if (!m_published.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    if (m_middle.load(std::memory_order_relaxed) & FRESH)
+    {
+        uint8_t prev = m_middle.exchange(m_read, std::memory_order_acq_rel);
+        m_read       = static_cast<uint8_t>(prev & ~FRESH);
+    }
+
+    dat = m_buffers[m_read];
+
+    return true;
+}
@@ -0,0 +1,58 @@
+/*! \file
+    \brief Defines the DataPublishBuffer class, the triple buffer holding values published by extensions
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <QCborValue>
+
+#ifndef PAPI_EXPORT
+#    ifdef PLUGINAPI_LIB
+#        define PAPI_EXPORT Q_DECL_EXPORT
+#    else
+#        define PAPI_EXPORT Q_DECL_IMPORT
+#    endif // PLUGINAPI_LIB
+#endif     // PAPI_EXPORT
+
+//! Triple buffer holding the latest value an extension published for a Data Source
+/*! The producer fills the write buffer and commits it, which swaps it with the middle
+    buffer. The consumer swaps the middle buffer with its read buffer whenever a newer
+    value was committed. Neither side ever waits for the other, and the consumer always
+    reads the latest complete value.
+
+    There may be a single producer thread and a single consumer thread.
+
+    \sa quasar_publish_begin(), quasar_publish_commit()
+*/
+class PAPI_EXPORT DataPublishBuffer
+{
+public:
+    DataPublishBuffer();
+
+    /*! Gets the buffer to write the next value into. Producer only
+        \return write buffer, holding a stale value
+    */
+    QCborValue* writeBuffer() { return &m_buffers[m_write]; }
+
+    //! Makes the value in the write buffer the latest one. Producer only
+    void commit();
+
+    /*! Gets the latest published value. Consumer only
+        \param[out] dat Latest value
+        \return true if a value was ever published, false otherwise
+    */
+    bool read(QCborValue& dat);
+
+private:
+    //! Set in m_middle when the middle buffer holds a value the consumer has not seen
+    static constexpr uint8_t FRESH = 0x4;
+
+    QCborValue           m_buffers[3];       //!< The three buffers
+    uint8_t              m_write = 0;        //!< Index of the producer's buffer
+    uint8_t              m_read  = 2;        //!< Index of the consumer's buffer
+    std::atomic<uint8_t> m_middle{1};        //!< Index of the middle buffer, with FRESH set if it holds a new value
+    std::atomic<bool>    m_published{false}; //!< Whether any value was committed yet
+};
@@ -0,0 +1,64 @@
+#include "datapush.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+DataPushRing::DataPushRing(size_t capacity, quasar_push_overflow_t policy) : m_slots(std::max<size_t>(1, capacity)), m_policy(policy) {}
+
+QCborValue* DataPushRing::writeSlot()
+{
+    const size_t head = m_head.load(std::memory_order_relaxed);
+
+    // A full ring's next slot is the one the consumer reads next
+    while (head - m_tail.load(std::memory_order_acquire) >= m_slots.size())
+    {
+        if (m_policy != QUASAR_PUSH_WAIT)
+        {
+            m_overflow = true;
+            m_scratch  = QCborValue();
+            return &m_scratch;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    m_overflow = false;
+
+    return &m_slots[head % m_slots.size()];
+}
+
+bool DataPushRing::commit()
+{
+    if (m_overflow)
+    {
+        m_overflow = false;
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Sequentially consistent, so that a drain starting after this either sees the frame or is requested again
+    m_head.store(m_head.load(std::memory_order_relaxed) + 1);
+
+    return true;
+}
+
+bool DataPushRing::pop(QCborValue& dat)
+{
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+
+    if (tail == m_head.load())
+    {
+        return false;
+    }
+
+    QCborValue& slot = m_slots[tail % m_slots.size()];
+
+    // Release the frame here rather than when the producer overwrites it
+    dat  = slot;
+    slot = QCborValue();
+
+    m_tail.store(tail + 1, std::memory_order_release);
+
+    return true;
+}
@@ -0,0 +1,98 @@
+/*! \file
+    \brief Defines the DataPushRing class, the bounded ring holding frames pushed by extensions
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <QCborValue>
+
+#include <extension_types.h>
+
+#ifndef PAPI_EXPORT
+#    ifdef PLUGINAPI_LIB
+#        define PAPI_EXPORT Q_DECL_EXPORT
+#    else
+#        define PAPI_EXPORT Q_DECL_IMPORT
+#    endif // PLUGINAPI_LIB
+#endif     // PAPI_EXPORT
+
+//! Default number of frames a push ring holds
+#define QUASAR_PUSH_DEFAULT_CAPACITY 64
+
+//! Lock-free bounded ring of frames pushed by an extension for a signaled Data Source
+/*! The producer fills the slot returned by writeSlot() and commits it. The consumer pops
+    frames in order. What happens when the producer finds the ring full depends on the
+    overflow policy \sa quasar_push_overflow_t
+
+    The producer also requests a drain after committing. Only the first request after the
+    consumer started its last drain returns true, so that a burst of frames is drained in
+    a single batch.
+
+    There may be a single producer thread and a single consumer thread.
+
+    \sa quasar_push_begin(), quasar_push_commit()
+*/
+class PAPI_EXPORT DataPushRing
+{
+public:
+    //! Constructs the ring
+    /*!
+        \param[in]  capacity    Number of frames the ring holds, at least 1
+        \param[in]  policy      What to do when the producer finds the ring full
+    */
+    explicit DataPushRing(size_t capacity = QUASAR_PUSH_DEFAULT_CAPACITY, quasar_push_overflow_t policy = QUASAR_PUSH_DROP_NEWEST);
+
+    /*! Gets the slot to write the next frame into. Producer only
+        Waits for the consumer to free a slot if the ring is full and the policy is \ref QUASAR_PUSH_WAIT.
+        \return slot to write into, holding no value
+    */
+    QCborValue* writeSlot();
+
+    /*! Pushes the frame written into the slot returned by writeSlot(). Producer only
+        \return true if pushed, false if dropped because the ring was full
+    */
+    bool commit();
+
+    /*! Requests a drain of the ring
+        \return true if the consumer needs to be woken up, false if a drain is already pending
+    */
+    bool requestDrain() { return !m_drainpending.exchange(true); }
+
+    //! Marks the start of a drain. Consumer only
+    void beginDrain() { m_drainpending.store(false); }
+
+    /*! Pops the oldest frame. Consumer only
+        \param[out] dat Frame
+        \return true if a frame was popped, false if the ring is empty
+    */
+    bool pop(QCborValue& dat);
+
+    /*! Checks whether the ring holds no frames
+        \return true if empty, false otherwise
+    */
+    bool empty() const { return m_head.load() == m_tail.load(); }
+
+    /*! Gets the number of frames the ring holds
+        \return ring capacity
+    */
+    size_t capacity() const { return m_slots.size(); }
+
+    /*! Gets the number of frames dropped because the ring was full
+        \return dropped frame count
+    */
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<QCborValue> m_slots;               //!< Frame slots
+    quasar_push_overflow_t  m_policy;              //!< Overflow policy
+    QCborValue              m_scratch;             //!< Slot handed to the producer when a frame is going to be dropped
+    bool                    m_overflow = false;    //!< Whether the frame being written is going to be dropped. Producer only
+    std::atomic<size_t>     m_head{0};             //!< Number of frames pushed
+    std::atomic<size_t>     m_tail{0};             //!< Number of frames popped
+    std::atomic<bool>       m_drainpending{false}; //!< Whether a drain was requested and has not started yet
+    std::atomic<uint64_t>   m_dropped{0};          //!< Number of frames dropped
+};
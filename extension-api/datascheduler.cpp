@@ -0,0 +1,185 @@
+#include "datascheduler.h"
+
+#include <algorithm>
+
+#include <QTimer>
+
+using namespace std::chrono;
+
+namespace
+{
+    //! Tasks due within this much of a wakeup run on that wakeup instead of arming the timer again
+    constexpr milliseconds SCHEDULER_SLACK{1};
+}
+
+DataScheduler::DataScheduler(QObject* parent) : QObject(parent), m_timer(new QTimer(this)), m_origin(clock::now())
+{
+    m_timer->setSingleShot(true);
+
+    // Coarse timers may fire up to 5% off, which would break phase alignment between tasks
+    m_timer->setTimerType(Qt::PreciseTimer);
+
+    connect(m_timer, &QTimer::timeout, this, &DataScheduler::run);
+}
+
+DataScheduler::~DataScheduler() {}
+
+DataScheduler::TaskId DataScheduler::add(int64_t interval, TaskFunc fn)
+{
+    TaskId id = m_nextid++;
+
+    Task& task    = m_tasks[id];
+    task.interval = milliseconds(std::max<int64_t>(1, interval));
+    task.fn       = std::move(fn);
+    task.due      = nextAligned(clock::now(), task.interval);
+
+    schedule(id, task);
+    arm();
+
+    return id;
+}
+
+void DataScheduler::remove(TaskId id)
+{
+    if (!m_tasks.erase(id))
+    {
+        return;
+    }
+
+    if (m_tasks.empty())
+    {
+        m_timer->stop();
+        m_heap = HeapType();
+    }
+}
+
+void DataScheduler::setInterval(TaskId id, int64_t interval)
+{
+    auto it = m_tasks.find(id);
+
+    if (it == m_tasks.end())
+    {
+        return;
+    }
+
+    Task& task = it->second;
+
+    task.interval = milliseconds(std::max<int64_t>(1, interval));
+    task.due      = nextAligned(clock::now(), task.interval);
+
+    schedule(id, task);
+    arm();
+}
+
+DataScheduler::clock::time_point DataScheduler::nextAligned(clock::time_point after, milliseconds interval) const
+{
+    return m_origin + interval * ((after - m_origin) / interval + 1);
+}
+
+void DataScheduler::schedule(TaskId id, Task& task)
+{
+    task.sequence++;
+    m_heap.push({task.due, id, task.sequence});
+}
+
+void DataScheduler::arm()
+{
+    // Discard entries of removed and rescheduled tasks
+    while (!m_heap.empty())
+    {
+        const HeapEntry& top = m_heap.top();
+        auto             it  = m_tasks.find(top.id);
+
+        if (it != m_tasks.end() && it->second.sequence == top.sequence)
+        {
+            break;
+        }
+
+        m_heap.pop();
+    }
+
+    if (m_heap.empty())
+    {
+        m_timer->stop();
+        return;
+    }
+
+    auto wait = ceil<milliseconds>(m_heap.top().due - clock::now());
+
+    m_timer->start(static_cast<int>(std::max<int64_t>(0, wait.count())));
+}
+
+void DataScheduler::run()
+{
+    const auto now = clock::now();
+
+    std::vector<TaskId> due;
+    milliseconds        shortest = milliseconds::max();
+
+    m_stats.wakeups++;
+
+    while (!m_heap.empty() && m_heap.top().due <= now + SCHEDULER_SLACK)
+    {
+        HeapEntry entry = m_heap.top();
+        m_heap.pop();
+
+        auto it = m_tasks.find(entry.id);
+
+        if (it == m_tasks.end() || it->second.sequence != entry.sequence)
+        {
+            continue;
+        }
+
+        Task& task = it->second;
+
+        if (now > task.due)
+        {
+            m_stats.maxlateness = std::max<int64_t>(m_stats.maxlateness, duration_cast<microseconds>(now - task.due).count());
+        }
+
+        // Skip ticks that were missed entirely rather than running them back to back
+        auto next = task.due + task.interval;
+
+        if (next <= now)
+        {
+            auto skipped = (now - task.due) / task.interval;
+
+            m_stats.missed += skipped;
+            next = task.due + task.interval * (skipped + 1);
+        }
+
+        task.due = next;
+        schedule(entry.id, task);
+
+        shortest = std::min(shortest, task.interval);
+        due.push_back(entry.id);
+    }
+
+    for (TaskId id : due)
+    {
+        auto it = m_tasks.find(id);
+
+        // Tasks may be removed by earlier tasks of the same wakeup
+        if (it == m_tasks.end())
+        {
+            continue;
+        }
+
+        // Copied, as the task may remove itself
+        TaskFunc fn = it->second.fn;
+
+        m_stats.ticks++;
+        fn();
+    }
+
+    const auto busy = clock::now() - now;
+
+    m_stats.maxbusy = std::max<int64_t>(m_stats.maxbusy, duration_cast<microseconds>(busy).count());
+
+    if (!due.empty() && busy > shortest)
+    {
+        m_stats.overruns++;
+    }
+
+    arm();
+}
@@ -0,0 +1,138 @@
+/*! \file
+    \brief Defines the DataScheduler class, the single timer driving all timer-based Data Sources
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include <QObject>
+
+#ifndef PAPI_EXPORT
+#    ifdef PLUGINAPI_LIB
+#        define PAPI_EXPORT Q_DECL_EXPORT
+#    else
+#        define PAPI_EXPORT Q_DECL_IMPORT
+#    endif // PLUGINAPI_LIB
+#endif     // PAPI_EXPORT
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+//! Tick statistics collected by the DataScheduler
+struct DataSchedulerStats
+{
+    uint64_t wakeups     = 0; //!< Number of times the scheduler woke up
+    uint64_t ticks       = 0; //!< Number of task ticks run
+    uint64_t missed      = 0; //!< Number of task ticks skipped because the previous one ran too late
+    uint64_t overruns    = 0; //!< Number of wakeups that took longer than the shortest scheduled interval
+    int64_t  maxlateness = 0; //!< Largest delay between a tick's due time and the time it ran, in microseconds
+    int64_t  maxbusy     = 0; //!< Longest time spent running the ticks of a single wakeup, in microseconds
+};
+
+//! Schedules the periodic ticks of all timer-based Data Sources on a single timer
+/*! Tasks are kept in a min-heap ordered by their next due time, and a single precise
+    QTimer is armed for the earliest one. Due times are aligned to multiples of each
+    task's interval from a common origin, so that tasks with equal intervals, or
+    intervals that are multiples of each other, run on the same wakeup.
+
+    A task that falls behind skips the ticks it missed rather than running them back to
+    back, and the missed ticks are counted in the scheduler's statistics.
+*/
+class PAPI_EXPORT DataScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Identifies a scheduled task. 0 is never a valid task
+    using TaskId = uint64_t;
+
+    //! Shorthand type for task callbacks
+    using TaskFunc = std::function<void()>;
+
+    //! Constructs the scheduler
+    /*!
+        \param[in]  parent  Parent element in Qt object tree
+    */
+    explicit DataScheduler(QObject* parent = nullptr);
+    ~DataScheduler();
+
+    //! Schedules a periodic task
+    /*!
+        \param[in]  interval    Interval between ticks, in milliseconds
+        \param[in]  fn          Function to run on every tick
+        \return Task identifier
+    */
+    TaskId add(int64_t interval, TaskFunc fn);
+
+    //! Removes a task
+    /*!
+        \param[in]  id  Task identifier, ignored if 0 or unknown
+    */
+    void remove(TaskId id);
+
+    //! Changes the interval of a task
+    /*! The task is realigned to the new interval.
+        \param[in]  id          Task identifier
+        \param[in]  interval    Interval between ticks, in milliseconds
+    */
+    void setInterval(TaskId id, int64_t interval);
+
+    /*! Gets the tick statistics collected so far
+        \return scheduler statistics
+    */
+    const DataSchedulerStats& stats() const { return m_stats; }
+
+    /*! Gets the number of scheduled tasks
+        \return number of tasks
+    */
+    size_t taskCount() const { return m_tasks.size(); }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    //! A scheduled task
+    struct Task
+    {
+        std::chrono::milliseconds interval;     //!< Interval between ticks
+        TaskFunc                  fn;           //!< Tick function
+        clock::time_point         due;          //!< Next due time
+        uint64_t                  sequence = 0; //!< Changes whenever the task is rescheduled, invalidating older heap entries
+    };
+
+    //! Heap entry. Entries of removed or rescheduled tasks are discarded when they reach the top
+    struct HeapEntry
+    {
+        clock::time_point due;      //!< Due time
+        TaskId            id;       //!< Task identifier
+        uint64_t          sequence; //!< Task sequence at the time of scheduling
+
+        bool operator>(const HeapEntry& o) const { return due > o.due; }
+    };
+
+    //! Min-heap of due times
+    using HeapType = std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>>;
+
+    //! Gets the first aligned due time of an interval after a point in time
+    clock::time_point nextAligned(clock::time_point after, std::chrono::milliseconds interval) const;
+
+    //! Pushes a task's current due time on the heap
+    void schedule(TaskId id, Task& task);
+
+    //! Arms the timer for the earliest due task
+    void arm();
+
+    //! Runs all due tasks
+    void run();
+
+    QTimer*                          m_timer;      //!< The only timer
+    clock::time_point                m_origin;     //!< Common origin of all aligned due times
+    std::unordered_map<TaskId, Task> m_tasks;      //!< Scheduled tasks
+    HeapType                         m_heap;       //!< Due times, earliest first
+    TaskId                           m_nextid = 1; //!< Next task identifier
+    DataSchedulerStats               m_stats;      //!< Tick statistics
+};
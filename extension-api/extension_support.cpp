@@ -2,14 +2,16 @@
 #include "extension_support_internal.h"
 
 #include "dataextension.h"
+#include "hostprotocol.h"
 
 #include <type_traits>
 
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
 #include <QDebug>
-#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QJsonValue>
 
 void quasar_log(quasar_log_level_t level, const char* msg)
 {
@@ -52,7 +54,7 @@ quasar_selection_options_t* quasar_create_selection_setting(void)
 
 quasar_data_handle quasar_set_data_string(quasar_data_handle hData, const char* data)
 {
-    QJsonValue* ref = static_cast<QJsonValue*>(hData);
+    QCborValue* ref = static_cast<QCborValue*>(hData);
 
     if (ref)
     {
@@ -65,13 +67,48 @@ quasar_data_handle quasar_set_data_string(quasar_data_handle hData, const char*
 }
 
 template <typename T, typename = std::enable_if_t<std::is_same_v<double, T> || std::is_same_v<int, T> || std::is_same_v<bool, T>, T>>
-quasar_data_handle set_basic_json_type(quasar_data_handle hData, T data)
+quasar_data_handle set_basic_data_type(quasar_data_handle hData, T data)
 {
-    QJsonValue* ref = static_cast<QJsonValue*>(hData);
+    QCborValue* ref = static_cast<QCborValue*>(hData);
 
     if (ref)
     {
-        (*ref) = data;
+        (*ref) = QCborValue(data);
+
+        return ref;
+    }
+
+    return nullptr;
+}
+
+template <typename T, typename = std::enable_if_t<std::is_same_v<double, T> || std::is_same_v<float, T> || std::is_same_v<int, T>, T>>
+quasar_data_handle set_typed_array_type(quasar_data_handle hData, const T* buf, size_t len)
+{
+    static_assert(sizeof(int) == 4 && sizeof(float) == 4 && sizeof(double) == 8, "Typed array element sizes do not match RFC 8746");
+
+    QCborValue* ref = static_cast<QCborValue*>(hData);
+
+    if (ref)
+    {
+        QuasarTypedArrayTag tag = QUASAR_TYPED_ARRAY_FLOAT64;
+
+        if constexpr (std::is_same_v<float, T>)
+        {
+            tag = QUASAR_TYPED_ARRAY_FLOAT32;
+        }
+        else if constexpr (std::is_same_v<int, T>)
+        {
+            tag = QUASAR_TYPED_ARRAY_INT32;
+        }
+
+        QByteArray bytes;
+
+        if (buf && len)
+        {
+            bytes = QByteArray(reinterpret_cast<const char*>(buf), static_cast<int>(len * sizeof(T)));
+        }
+
+        (*ref) = QCborValue(QCborTag(tag), bytes);
 
         return ref;
     }
@@ -81,27 +118,27 @@ quasar_data_handle set_basic_json_type(quasar_data_handle hData, T data)
 
 quasar_data_handle quasar_set_data_int(quasar_data_handle hData, int data)
 {
-    return set_basic_json_type(hData, data);
+    return set_basic_data_type(hData, data);
 }
 
 quasar_data_handle quasar_set_data_double(quasar_data_handle hData, double data)
 {
-    return set_basic_json_type(hData, data);
+    return set_basic_data_type(hData, data);
 }
 
 quasar_data_handle quasar_set_data_bool(quasar_data_handle hData, bool data)
 {
-    return set_basic_json_type(hData, data);
+    return set_basic_data_type(hData, data);
 }
 
 quasar_data_handle quasar_set_data_json(quasar_data_handle hData, const char* data)
 {
-    QJsonValue* ref = static_cast<QJsonValue*>(hData);
+    QCborValue* ref = static_cast<QCborValue*>(hData);
 
     if (ref)
     {
         QString str = QString::fromUtf8(data);
-        (*ref)      = QJsonDocument::fromJson(str.toUtf8()).object();
+        (*ref)      = QCborMap::fromJsonObject(QJsonDocument::fromJson(str.toUtf8()).object());
 
         return ref;
     }
@@ -111,11 +148,11 @@ quasar_data_handle quasar_set_data_json(quasar_data_handle hData, const char* da
 
 quasar_data_handle quasar_set_data_binary(quasar_data_handle hData, const char* data, size_t len)
 {
-    QJsonValue* ref = static_cast<QJsonValue*>(hData);
+    QCborValue* ref = static_cast<QCborValue*>(hData);
 
     if (ref)
     {
-        (*ref) = QJsonDocument::fromRawData(data, len).object();
+        (*ref) = QCborMap::fromJsonObject(QJsonDocument::fromRawData(data, len).object());
 
         return ref;
     }
@@ -125,18 +162,18 @@ quasar_data_handle quasar_set_data_binary(quasar_data_handle hData, const char*
 
 quasar_data_handle quasar_set_data_string_array(quasar_data_handle hData, char** arr, size_t len)
 {
-    QJsonValue* ref = static_cast<QJsonValue*>(hData);
+    QCborValue* ref = static_cast<QCborValue*>(hData);
 
     if (ref)
     {
-        QJsonArray jarr;
+        QCborArray carr;
 
         for (size_t i = 0; i < len; i++)
         {
-            jarr.append(QString::fromUtf8(arr[i]));
+            carr.append(QString::fromUtf8(arr[i]));
         }
 
-        (*ref) = jarr;
+        (*ref) = carr;
 
         return ref;
     }
@@ -146,65 +183,32 @@ quasar_data_handle quasar_set_data_string_array(quasar_data_handle hData, char**
 
 quasar_data_handle quasar_set_data_int_array(quasar_data_handle hData, int* arr, size_t len)
 {
-    QJsonValue* ref = static_cast<QJsonValue*>(hData);
-
-    if (ref)
-    {
-        QJsonArray jarr;
-
-        for (size_t i = 0; i < len; i++)
-        {
-            jarr.append(arr[i]);
-        }
-
-        (*ref) = jarr;
-
-        return ref;
-    }
-
-    return nullptr;
+    return set_typed_array_type<int>(hData, arr, len);
 }
 
 quasar_data_handle quasar_set_data_float_array(quasar_data_handle hData, float* arr, size_t len)
 {
-    QJsonValue* ref = static_cast<QJsonValue*>(hData);
-
-    if (ref)
-    {
-        QJsonArray jarr;
-
-        for (size_t i = 0; i < len; i++)
-        {
-            jarr.append((double) arr[i]);
-        }
-
-        (*ref) = jarr;
-
-        return ref;
-    }
-
-    return nullptr;
+    return set_typed_array_type<float>(hData, arr, len);
 }
 
 quasar_data_handle quasar_set_data_double_array(quasar_data_handle hData, double* arr, size_t len)
 {
-    QJsonValue* ref = static_cast<QJsonValue*>(hData);
-
-    if (ref)
-    {
-        QJsonArray jarr;
-
-        for (size_t i = 0; i < len; i++)
-        {
-            jarr.append(arr[i]);
-        }
+    return set_typed_array_type<double>(hData, arr, len);
+}
 
-        (*ref) = jarr;
+quasar_data_handle quasar_set_data_int_buffer(quasar_data_handle hData, const int* buf, size_t len)
+{
+    return set_typed_array_type(hData, buf, len);
+}
 
-        return ref;
-    }
+quasar_data_handle quasar_set_data_float_buffer(quasar_data_handle hData, const float* buf, size_t len)
+{
+    return set_typed_array_type(hData, buf, len);
+}
 
-    return nullptr;
+quasar_data_handle quasar_set_data_double_buffer(quasar_data_handle hData, const double* buf, size_t len)
+{
+    return set_typed_array_type(hData, buf, len);
 }
 
 quasar_settings_t* quasar_add_int(quasar_settings_t* settings, const char* name, const char* description, int min, int max, int step, int dflt)
@@ -412,6 +416,12 @@ bool quasar_get_selection(quasar_settings_t* settings, const char* name, char* b
 
 void quasar_signal_data_ready(quasar_ext_handle handle, const char* source)
 {
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        sink->signalDataReady(sink->sourceUid(source));
+        return;
+    }
+
     DataExtension* ext = static_cast<DataExtension*>(handle);
 
     if (ext)
@@ -422,6 +432,12 @@ void quasar_signal_data_ready(quasar_ext_handle handle, const char* source)
 
 void quasar_signal_wait_processed(quasar_ext_handle handle, const char* source)
 {
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        sink->waitDataProcessed(sink->sourceUid(source));
+        return;
+    }
+
     DataExtension* ext = static_cast<DataExtension*>(handle);
 
     if (ext)
@@ -429,3 +445,216 @@ void quasar_signal_wait_processed(quasar_ext_handle handle, const char* source)
         ext->waitDataProcessed(source);
     }
 }
+
+void quasar_signal_data_ready_uid(quasar_ext_handle handle, size_t uid)
+{
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        sink->signalDataReady(uid);
+        return;
+    }
+
+    DataExtension* ext = static_cast<DataExtension*>(handle);
+
+    if (ext)
+    {
+        ext->emitDataReady(uid);
+    }
+}
+
+void quasar_signal_wait_processed_uid(quasar_ext_handle handle, size_t uid)
+{
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        sink->waitDataProcessed(uid);
+        return;
+    }
+
+    DataExtension* ext = static_cast<DataExtension*>(handle);
+
+    if (ext)
+    {
+        ext->waitDataProcessed(uid);
+    }
+}
+
+quasar_data_handle quasar_publish_begin(quasar_ext_handle handle, const char* source)
+{
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        return sink->publishBegin(sink->sourceUid(source));
+    }
+
+    DataExtension* ext = static_cast<DataExtension*>(handle);
+
+    if (ext)
+    {
+        DataPublishBuffer* buf = ext->getPublishBuffer(source);
+
+        if (buf)
+        {
+            return buf->writeBuffer();
+        }
+    }
+
+    return nullptr;
+}
+
+bool quasar_push_configure(quasar_ext_handle handle, const char* source, size_t capacity, quasar_push_overflow_t policy)
+{
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        return sink->pushConfigure(sink->sourceUid(source), capacity, policy);
+    }
+
+    DataExtension* ext = static_cast<DataExtension*>(handle);
+
+    if (ext)
+    {
+        return ext->configurePushRing(source, capacity, policy);
+    }
+
+    return false;
+}
+
+quasar_data_handle quasar_push_begin(quasar_ext_handle handle, const char* source)
+{
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        return sink->pushBegin(sink->sourceUid(source));
+    }
+
+    DataExtension* ext = static_cast<DataExtension*>(handle);
+
+    if (ext)
+    {
+        DataPushRing* ring = ext->getPushRing(source);
+
+        if (ring)
+        {
+            return ring->writeSlot();
+        }
+    }
+
+    return nullptr;
+}
+
+bool quasar_push_commit(quasar_ext_handle handle, const char* source)
+{
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        return sink->pushCommit(sink->sourceUid(source));
+    }
+
+    DataExtension* ext = static_cast<DataExtension*>(handle);
+
+    if (ext)
+    {
+        return ext->commitPush(source);
+    }
+
+    return false;
+}
+
+quasar_data_handle quasar_push_begin_uid(quasar_ext_handle handle, size_t uid)
+{
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        return sink->pushBegin(uid);
+    }
+
+    DataExtension* ext = static_cast<DataExtension*>(handle);
+
+    if (ext)
+    {
+        DataPushRing* ring = ext->getPushRing(uid);
+
+        if (ring)
+        {
+            return ring->writeSlot();
+        }
+    }
+
+    return nullptr;
+}
+
+bool quasar_push_commit_uid(quasar_ext_handle handle, size_t uid)
+{
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        return sink->pushCommit(uid);
+    }
+
+    DataExtension* ext = static_cast<DataExtension*>(handle);
+
+    if (ext)
+    {
+        return ext->commitPush(uid);
+    }
+
+    return false;
+}
+
+void quasar_publish_commit(quasar_ext_handle handle, const char* source)
+{
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        sink->publishCommit(sink->sourceUid(source));
+        return;
+    }
+
+    DataExtension* ext = static_cast<DataExtension*>(handle);
+
+    if (ext)
+    {
+        DataPublishBuffer* buf = ext->getPublishBuffer(source);
+
+        if (buf)
+        {
+            buf->commit();
+        }
+    }
+}
+
+quasar_data_handle quasar_publish_begin_uid(quasar_ext_handle handle, size_t uid)
+{
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        return sink->publishBegin(uid);
+    }
+
+    DataExtension* ext = static_cast<DataExtension*>(handle);
+
+    if (ext)
+    {
+        DataPublishBuffer* buf = ext->getPublishBuffer(uid);
+
+        if (buf)
+        {
+            return buf->writeBuffer();
+        }
+    }
+
+    return nullptr;
+}
+
+void quasar_publish_commit_uid(quasar_ext_handle handle, size_t uid)
+{
+    if (ExtensionHostSink* sink = ExtensionHostSink::current())
+    {
+        sink->publishCommit(uid);
+        return;
+    }
+
+    DataExtension* ext = static_cast<DataExtension*>(handle);
+
+    if (ext)
+    {
+        DataPublishBuffer* buf = ext->getPublishBuffer(uid);
+
+        if (buf)
+        {
+            buf->commit();
+        }
+    }
+}
@@ -103,7 +103,9 @@ SAPI_EXPORT quasar_data_handle quasar_set_data_binary(quasar_data_handle hData,
 SAPI_EXPORT quasar_data_handle quasar_set_data_string_array(quasar_data_handle hData, char** arr, size_t len);
 
 //! Sets the return data to be an array of integers
-/*! \param[in]  hData   Data handle
+/*! Equivalent to \ref quasar_set_data_int_buffer().
+
+    \param[in]  hData   Data handle
     \param[in]  arr     Array of data to set
     \param[in]  len     Length of array
     \return Data handle if successful, nullptr otherwise
@@ -111,7 +113,9 @@ SAPI_EXPORT quasar_data_handle quasar_set_data_string_array(quasar_data_handle h
 SAPI_EXPORT quasar_data_handle quasar_set_data_int_array(quasar_data_handle hData, int* arr, size_t len);
 
 //! Sets the return data to be an array of floats
-/*! \param[in]  hData   Data handle
+/*! Equivalent to \ref quasar_set_data_float_buffer().
+
+    \param[in]  hData   Data handle
     \param[in]  arr     Array of data to set
     \param[in]  len     Length of array
     \return Data handle if successful, nullptr otherwise
@@ -119,13 +123,45 @@ SAPI_EXPORT quasar_data_handle quasar_set_data_int_array(quasar_data_handle hDat
 SAPI_EXPORT quasar_data_handle quasar_set_data_float_array(quasar_data_handle hData, float* arr, size_t len);
 
 //! Sets the return data to be an array of doubles
-/*! \param[in]  hData   Data handle
+/*! Equivalent to \ref quasar_set_data_double_buffer().
+
+    \param[in]  hData   Data handle
     \param[in]  arr     Array of data to set
     \param[in]  len     Length of array
     \return Data handle if successful, nullptr otherwise
 */
 SAPI_EXPORT quasar_data_handle quasar_set_data_double_array(quasar_data_handle hData, double* arr, size_t len);
 
+//! Sets the return data to be a contiguous buffer of integers
+/*! The buffer is copied into the data handle in a single block and is sent to
+    clients as a typed array where the wire encoding supports it. Prefer this
+    over building arrays element by element for large or frequently updated data.
+
+    \param[in]  hData   Data handle
+    \param[in]  buf     Buffer of data to set
+    \param[in]  len     Number of elements in buffer
+    \return Data handle if successful, nullptr otherwise
+*/
+SAPI_EXPORT quasar_data_handle quasar_set_data_int_buffer(quasar_data_handle hData, const int* buf, size_t len);
+
+//! Sets the return data to be a contiguous buffer of floats
+/*! \param[in]  hData   Data handle
+    \param[in]  buf     Buffer of data to set
+    \param[in]  len     Number of elements in buffer
+    \return Data handle if successful, nullptr otherwise
+    \sa quasar_set_data_int_buffer()
+*/
+SAPI_EXPORT quasar_data_handle quasar_set_data_float_buffer(quasar_data_handle hData, const float* buf, size_t len);
+
+//! Sets the return data to be a contiguous buffer of doubles
+/*! \param[in]  hData   Data handle
+    \param[in]  buf     Buffer of data to set
+    \param[in]  len     Number of elements in buffer
+    \return Data handle if successful, nullptr otherwise
+    \sa quasar_set_data_int_buffer()
+*/
+SAPI_EXPORT quasar_data_handle quasar_set_data_double_buffer(quasar_data_handle hData, const double* buf, size_t len);
+
 //! Creates an integer setting in extension settings
 /*!
     \param[in]  settings    The extension settings handle
@@ -269,6 +305,145 @@ SAPI_EXPORT void quasar_signal_data_ready(quasar_ext_handle handle, const char*
 */
 SAPI_EXPORT void quasar_signal_wait_processed(quasar_ext_handle handle, const char* source);
 
+//! Signals to Quasar that data is ready to be sent to clients, identifying the Data Source by uid
+/*! Equivalent to \ref quasar_signal_data_ready(), without looking up the Data Source by name.
+    Prefer this function for sources that signal at high rates.
+
+    \param[in]  handle  Extension handle
+    \param[in]  uid     Data Source uid assigned by Quasar \sa quasar_data_source_t.uid
+
+    \sa quasar_signal_data_ready()
+*/
+SAPI_EXPORT void quasar_signal_data_ready_uid(quasar_ext_handle handle, size_t uid);
+
+//! Waits for a set of data to be sent to clients before processing the next set, identifying the Data Source by uid
+/*! Equivalent to \ref quasar_signal_wait_processed(), without looking up the Data Source by name.
+
+    \param[in]  handle  Extension handle
+    \param[in]  uid     Data Source uid assigned by Quasar \sa quasar_data_source_t.uid
+
+    \sa quasar_signal_wait_processed()
+*/
+SAPI_EXPORT void quasar_signal_wait_processed_uid(quasar_ext_handle handle, size_t uid);
+
+//! Configures the push ring of a Data Source
+/*! This function is for Data Sources with \ref quasar_data_source_t.rate
+    set to \ref QUASAR_POLLING_SIGNALED, and may only be called from \ref quasar_ext_info_t.init.
+    By default, a push ring holds #QUASAR_PUSH_DEFAULT_CAPACITY frames and drops new frames when full.
+
+    \param[in]  handle      Extension handle
+    \param[in]  source      Data Source identifier
+    \param[in]  capacity    Number of frames the ring holds
+    \param[in]  policy      What to do with new frames when the ring is full
+
+    \return true if successful, false otherwise
+    \sa quasar_push_begin(), quasar_push_commit(), quasar_push_overflow_t
+*/
+SAPI_EXPORT bool quasar_push_configure(quasar_ext_handle handle, const char* source, size_t capacity, quasar_push_overflow_t policy);
+
+//! Gets the data handle to push the next frame of a Data Source into
+/*! This function is for Data Sources with \ref quasar_data_source_t.rate
+    set to \ref QUASAR_POLLING_SIGNALED. It is an alternative to \ref quasar_signal_data_ready()
+    for sources that stream complete frames from a thread of the extension's own.
+
+    Populate the returned handle with the support functions used in get_data, then call
+    \ref quasar_push_commit(). Every committed frame is sent to subscribers in order, without calling
+    \ref quasar_ext_info_t.get_data and without waiting for the frame to be sent.
+    Only a single thread may push to a given Data Source.
+
+    \param[in]  handle  Extension handle
+    \param[in]  source  Data Source identifier
+    \return Data handle if successful, nullptr otherwise
+
+    \sa quasar_push_commit(), quasar_push_configure()
+*/
+SAPI_EXPORT quasar_data_handle quasar_push_begin(quasar_ext_handle handle, const char* source);
+
+//! Pushes the frame populated since \ref quasar_push_begin()
+/*!
+    \param[in]  handle  Extension handle
+    \param[in]  source  Data Source identifier
+
+    \return true if the frame was pushed, false if it was dropped because the ring was full
+    \sa quasar_push_begin(), quasar_push_overflow_t
+*/
+SAPI_EXPORT bool quasar_push_commit(quasar_ext_handle handle, const char* source);
+
+//! Gets the data handle to push the next frame of a Data Source into, identifying the Data Source by uid
+/*! Equivalent to \ref quasar_push_begin(), without looking up the Data Source by name.
+    Prefer this function for sources that push at high rates.
+
+    \param[in]  handle  Extension handle
+    \param[in]  uid     Data Source uid assigned by Quasar \sa quasar_data_source_t.uid
+    \return Data handle if successful, nullptr otherwise
+
+    \sa quasar_push_begin(), quasar_push_commit_uid()
+*/
+SAPI_EXPORT quasar_data_handle quasar_push_begin_uid(quasar_ext_handle handle, size_t uid);
+
+//! Pushes the frame populated since \ref quasar_push_begin_uid()
+/*! Equivalent to \ref quasar_push_commit(), without looking up the Data Source by name.
+
+    \param[in]  handle  Extension handle
+    \param[in]  uid     Data Source uid assigned by Quasar \sa quasar_data_source_t.uid
+
+    \return true if the frame was pushed, false if it was dropped because the ring was full
+    \sa quasar_push_begin_uid()
+*/
+SAPI_EXPORT bool quasar_push_commit_uid(quasar_ext_handle handle, size_t uid);
+
+//! Gets the data handle to publish the next value of a Data Source into
+/*! This function is for Data Sources with \ref quasar_data_source_t.rate
+    set to a refresh rate or \ref QUASAR_POLLING_CLIENT. It lets an extension produce data
+    on its own thread and have Quasar send the latest value whenever the source is due,
+    without calling \ref quasar_ext_info_t.get_data.
+
+    Populate the returned handle with the support functions used in get_data, then call
+    \ref quasar_publish_commit(). The handle holds a stale value until it is populated.
+    Neither function ever blocks. Only a single thread may publish to a given Data Source.
+
+    Once a value has been published for a Data Source, get_data is no longer called for it.
+
+    \param[in]  handle  Extension handle
+    \param[in]  source  Data Source identifier
+    \return Data handle if successful, nullptr otherwise
+
+    \sa quasar_publish_commit(), quasar_data_source_t.rate
+*/
+SAPI_EXPORT quasar_data_handle quasar_publish_begin(quasar_ext_handle handle, const char* source);
+
+//! Publishes the value populated since \ref quasar_publish_begin()
+/*! The value replaces any previously published value that Quasar has not sent yet.
+
+    \param[in]  handle  Extension handle
+    \param[in]  source  Data Source identifier
+
+    \sa quasar_publish_begin()
+*/
+SAPI_EXPORT void quasar_publish_commit(quasar_ext_handle handle, const char* source);
+
+//! Gets the data handle to publish the next value of a Data Source into, identifying the Data Source by uid
+/*! Equivalent to \ref quasar_publish_begin(), without looking up the Data Source by name.
+    Prefer this function for sources that publish at high rates.
+
+    \param[in]  handle  Extension handle
+    \param[in]  uid     Data Source uid assigned by Quasar \sa quasar_data_source_t.uid
+    \return Data handle if successful, nullptr otherwise
+
+    \sa quasar_publish_begin(), quasar_publish_commit_uid()
+*/
+SAPI_EXPORT quasar_data_handle quasar_publish_begin_uid(quasar_ext_handle handle, size_t uid);
+
+//! Publishes the value populated since \ref quasar_publish_begin_uid()
+/*! Equivalent to \ref quasar_publish_commit(), without looking up the Data Source by name.
+
+    \param[in]  handle  Extension handle
+    \param[in]  uid     Data Source uid assigned by Quasar \sa quasar_data_source_t.uid
+
+    \sa quasar_publish_begin_uid()
+*/
+SAPI_EXPORT void quasar_publish_commit_uid(quasar_ext_handle handle, size_t uid);
+
 #if defined(__cplusplus)
 }
 #endif
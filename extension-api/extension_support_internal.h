@@ -8,6 +8,7 @@
 #pragma once
 
 #include <QVariant>
+#include <QtEndian>
 #include <qstring_hash_impl.h>
 
 #include <tsl/ordered_map.h>
@@ -22,6 +23,25 @@ enum QuasarSettingEntryType
     QUASAR_SETTING_ENTRY_SELECTION //!< Selection type
 };
 
+//! RFC 8746 typed array tags used to store typed array data in host byte order
+/*! Typed array data is stored in a data handle as a tagged CBOR byte string,
+    which lets it travel to the wire encoders in a single contiguous buffer.
+
+    \sa quasar_set_data_int_buffer(), quasar_set_data_float_buffer(), quasar_set_data_double_buffer()
+*/
+enum QuasarTypedArrayTag : quint64
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    QUASAR_TYPED_ARRAY_INT32   = 78, //!< sint32, little endian
+    QUASAR_TYPED_ARRAY_FLOAT32 = 85, //!< IEEE 754 binary32, little endian
+    QUASAR_TYPED_ARRAY_FLOAT64 = 86  //!< IEEE 754 binary64, little endian
+#else
+    QUASAR_TYPED_ARRAY_INT32   = 74, //!< sint32, big endian
+    QUASAR_TYPED_ARRAY_FLOAT32 = 81, //!< IEEE 754 binary32, big endian
+    QUASAR_TYPED_ARRAY_FLOAT64 = 82  //!< IEEE 754 binary64, big endian
+#endif
+};
+
 // Helper types
 
 //! Internal struct holding an integer type setting
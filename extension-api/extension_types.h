@@ -41,6 +41,15 @@ enum quasar_polling_type_t
     QUASAR_POLLING_CLIENT   = 0   //!< Data is polled on-demand by the client
 };
 
+//! Defines what happens to a pushed frame when the Data Source's push ring is full.
+/*! \sa quasar_push_configure(), quasar_push_commit()
+*/
+enum quasar_push_overflow_t
+{
+    QUASAR_PUSH_DROP_NEWEST = 0, //!< The new frame is dropped. Pushing never blocks.
+    QUASAR_PUSH_WAIT             //!< Pushing waits until Quasar has taken a frame out of the ring.
+};
+
 //! Struct for creating and storing extension settings.
 /*! This struct is opaque to the front facing API.
     \sa extension_support.h, extension_support_internal.h
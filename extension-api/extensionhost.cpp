@@ -0,0 +1,808 @@
+#include "extensionhost.h"
+
+#include "dataextension.h"
+#include "extension_support_internal.h"
+
+#include <algorithm>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSharedMemory>
+#include <QSystemSemaphore>
+#include <QTimer>
+
+namespace
+{
+    //! Number of hosts created, tells apart the shared objects of hosts of this process
+    std::atomic<unsigned int> _hostcount{0};
+
+    //! Copies a string into a fixed size char array of the extension API
+    template<size_t N>
+    void copyField(char (&dst)[N], const QString& src)
+    {
+        qstrncpy(dst, src.toUtf8().constData(), N);
+    }
+}
+
+ExtensionHost::ExtensionHost(QString libpath, QObject* parent) :
+    QObject(parent),
+    m_libpath(libpath),
+    m_id(++_hostcount),
+    m_starttimer(new QTimer(this))
+{
+    m_starttimer->setSingleShot(true);
+
+    connect(m_starttimer, &QTimer::timeout, this, [this] {
+        qWarning() << "Extension host of" << m_name << "did not come back in time";
+        failRestart();
+    });
+}
+
+ExtensionHost::~ExtensionHost()
+{
+    m_stopping = true;
+
+    teardown();
+
+    if (m_process)
+    {
+        m_process->kill();
+        m_process->waitForFinished(QUASAR_EXTHOST_STOP_TIMEOUT);
+    }
+}
+
+bool ExtensionHost::start()
+{
+    m_backoff = QUASAR_EXTHOST_MIN_BACKOFF;
+
+    // Loading waits for the host, restarts do not
+    if (!launch())
+    {
+        return false;
+    }
+
+    if (!m_process->waitForStarted(QUASAR_EXTHOST_START_TIMEOUT))
+    {
+        qWarning() << "Failed to start the extension host of" << m_libpath << ":" << m_process->errorString();
+        return false;
+    }
+
+    if (!m_listener->waitForNewConnection(QUASAR_EXTHOST_START_TIMEOUT))
+    {
+        qWarning() << "Extension host of" << m_libpath << "did not connect";
+        m_process->kill();
+        return false;
+    }
+
+    acceptHost();
+
+    QCborMap info;
+
+    if (!waitControl(QStringLiteral("info"), info, QUASAR_EXTHOST_START_TIMEOUT))
+    {
+        qWarning() << "Extension host of" << m_libpath << "did not describe its extension";
+        m_process->kill();
+        return false;
+    }
+
+    return describe(info);
+}
+
+bool ExtensionHost::launch()
+{
+    const unsigned int gen = ++m_generation;
+    const QString      key = QStringLiteral("quasar-exthost-%1-%2-%3").arg(QCoreApplication::applicationPid()).arg(m_id).arg(gen);
+
+    // Set up the rings before the host can attach to them
+    auto shm = std::make_unique<QSharedMemory>(key);
+
+    if (!shm->create(static_cast<int>(HostRing::footprint(QUASAR_EXTHOST_REQUEST_RING) + HostRing::footprint(QUASAR_EXTHOST_REPLY_RING))))
+    {
+        qWarning() << "Failed to create shared memory for the extension host of" << m_libpath << ":" << shm->errorString();
+        return false;
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lk(m_transportMtx);
+
+        m_shm    = std::move(shm);
+        m_reqsem = std::make_unique<QSystemSemaphore>(key + "-req", 0, QSystemSemaphore::Create);
+        m_repsem = std::make_unique<QSystemSemaphore>(key + "-rep", 0, QSystemSemaphore::Create);
+
+        m_requests.attach(m_shm->data(), QUASAR_EXTHOST_REQUEST_RING, true);
+        m_replies.attach(static_cast<char*>(m_shm->data()) + HostRing::footprint(QUASAR_EXTHOST_REQUEST_RING), QUASAR_EXTHOST_REPLY_RING, true);
+    }
+
+    if (m_listener)
+    {
+        m_listener->deleteLater();
+    }
+
+    m_listener = new QLocalServer(this);
+    QLocalServer::removeServer(key);
+
+    if (!m_listener->listen(key))
+    {
+        qWarning() << "Failed to listen for the extension host of" << m_libpath << ":" << m_listener->errorString();
+        return false;
+    }
+
+    // Also emitted by waitForNewConnection() when starting
+    connect(m_listener, &QLocalServer::newConnection, this, [this, listener = m_listener] {
+        if (listener == m_listener)
+        {
+            acceptHost();
+        }
+    });
+
+    if (m_process)
+    {
+        m_process->deleteLater();
+    }
+
+    m_process = new QProcess(this);
+    m_process->setProcessChannelMode(QProcess::ForwardedChannels);
+
+    QProcess* process = m_process;
+
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, [this, process](int exitCode, QProcess::ExitStatus exitStatus) {
+        if (process == m_process)
+        {
+            handleFinished(exitCode, exitStatus);
+        }
+    });
+
+    // A host that cannot be started never finishes
+    connect(m_process, &QProcess::errorOccurred, this, [this, process](QProcess::ProcessError error) {
+        if (process == m_process && error == QProcess::FailedToStart && m_restartstate != RESTART_IDLE)
+        {
+            qWarning() << "Failed to start the extension host of" << m_name << ":" << process->errorString();
+            failRestart();
+        }
+    });
+
+    m_process->start(QCoreApplication::applicationDirPath() + "/" QUASAR_EXTHOST_NAME, QStringList() << m_libpath << key);
+
+    m_uptime.start();
+
+    return true;
+}
+
+void ExtensionHost::acceptHost()
+{
+    QLocalSocket* socket = m_listener->nextPendingConnection();
+
+    if (!socket)
+    {
+        return;
+    }
+
+    // A single host connects
+    m_listener->close();
+
+    if (m_socket)
+    {
+        m_socket->deleteLater();
+    }
+
+    m_socket = socket;
+    m_socket->setParent(this);
+
+    connect(m_socket, &QLocalSocket::readyRead, this, [this, socket] {
+        QCborMap             msg;
+        HostRing::ReadResult result = HostRing::READ_EMPTY;
+
+        // Messages waited for are read by waitControl() itself
+        while (socket == m_socket && !m_sync && (result = HostControl::read(socket, msg)) == HostRing::READ_OK)
+        {
+            handleControl(msg);
+        }
+
+        if (result == HostRing::READ_CORRUPT)
+        {
+            rejectControl();
+        }
+    });
+
+    if (m_restartstate == RESTART_CONNECTING)
+    {
+        m_restartstate = RESTART_DESCRIBING;
+        m_starttimer->start(QUASAR_EXTHOST_START_TIMEOUT);
+    }
+}
+
+bool ExtensionHost::describe(const QCborMap& info)
+{
+    QCborMap fields = info.value(QStringLiteral("fields")).toMap();
+    QString  name   = fields.value(QStringLiteral("name")).toString();
+
+    if (m_name.isEmpty())
+    {
+        copyField(m_fields.name, name);
+        copyField(m_fields.fullname, fields.value(QStringLiteral("fullname")).toString());
+        copyField(m_fields.version, fields.value(QStringLiteral("version")).toString());
+        copyField(m_fields.author, fields.value(QStringLiteral("author")).toString());
+        copyField(m_fields.description, fields.value(QStringLiteral("description")).toString());
+        copyField(m_fields.url, fields.value(QStringLiteral("url")).toString());
+
+        for (const auto& s : info.value(QStringLiteral("sources")).toArray())
+        {
+            QCborMap             src = s.toMap();
+            quasar_data_source_t dsrc{};
+
+            copyField(dsrc.name, src.value(QStringLiteral("name")).toString());
+            dsrc.rate      = src.value(QStringLiteral("rate")).toInteger();
+            dsrc.validtime = static_cast<uint64_t>(src.value(QStringLiteral("validtime")).toInteger());
+
+            m_sources.push_back(dsrc);
+        }
+
+        m_settingdefs = info.value(QStringLiteral("settings")).toArray();
+
+        m_info.api_version    = static_cast<int>(info.value(QStringLiteral("api")).toInteger());
+        m_info.fields         = &m_fields;
+        m_info.numDataSources = m_sources.size();
+        m_info.dataSources    = m_sources.data();
+
+        m_name = name;
+    }
+    else if (name != m_name || info.value(QStringLiteral("sources")).toArray().size() != static_cast<qsizetype>(m_sources.size()))
+    {
+        qWarning() << "Extension in" << m_libpath << "changed while it was running, not restarting its host";
+        m_stopping = true;
+        m_process->kill();
+        return false;
+    }
+
+    m_running = true;
+
+    return true;
+}
+
+bool ExtensionHost::waitControl(QString op, QCborMap& msg, int timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    bool found = false;
+    m_sync     = true;
+
+    while (!found)
+    {
+        HostRing::ReadResult result = HostControl::read(m_socket, msg);
+
+        if (result == HostRing::READ_OK)
+        {
+            if (msg.value(QStringLiteral("op")).toString() == op)
+            {
+                found = true;
+            }
+            else
+            {
+                handleControl(msg);
+            }
+
+            continue;
+        }
+
+        if (result == HostRing::READ_CORRUPT)
+        {
+            rejectControl();
+            break;
+        }
+
+        int remaining = timeout - static_cast<int>(timer.elapsed());
+
+        if (remaining <= 0 || !m_socket->waitForReadyRead(remaining))
+        {
+            break;
+        }
+    }
+
+    m_sync = false;
+
+    return found;
+}
+
+void ExtensionHost::rejectControl()
+{
+    qWarning() << "Extension host of" << m_libpath << "sent an oversized control message, restarting it";
+
+    // Nothing more is buffered for the host. Treated like a dead host, comes back through handleFinished()
+    m_socket->abort();
+
+    if (m_process)
+    {
+        m_process->kill();
+    }
+}
+
+void ExtensionHost::handleControl(const QCborMap& msg)
+{
+    QString op = msg.value(QStringLiteral("op")).toString();
+
+    // Steps of a restart, see restart()
+    if (op == QStringLiteral("info") && m_restartstate == RESTART_DESCRIBING)
+    {
+        if (!describe(msg))
+        {
+            failRestart();
+            return;
+        }
+
+        sendInit();
+
+        m_restartstate = RESTART_INITIALIZING;
+        m_starttimer->start(QUASAR_EXTHOST_START_TIMEOUT);
+        return;
+    }
+
+    if (op == QStringLiteral("init") && m_restartstate == RESTART_INITIALIZING)
+    {
+        if (!msg.value(QStringLiteral("ok")).toBool())
+        {
+            qWarning() << "Extension" << m_name << "failed to initialize in its restarted host";
+            failRestart();
+            return;
+        }
+
+        m_restartstate = RESTART_IDLE;
+        m_starttimer->stop();
+        m_initialized = true;
+
+        qInfo() << "Extension host of" << m_name << "restarted";
+        return;
+    }
+
+    if (op != QStringLiteral("log"))
+    {
+        return;
+    }
+
+    QString text = msg.value(QStringLiteral("msg")).toString();
+
+    switch (static_cast<QtMsgType>(msg.value(QStringLiteral("level")).toInteger()))
+    {
+        case QtDebugMsg:
+            qDebug().noquote() << text;
+            break;
+        case QtInfoMsg:
+        default:
+            qInfo().noquote() << text;
+            break;
+        case QtWarningMsg:
+            qWarning().noquote() << text;
+            break;
+        case QtCriticalMsg:
+        case QtFatalMsg:
+            qCritical().noquote() << text;
+            break;
+    }
+}
+
+quasar_settings_t* ExtensionHost::createSettings()
+{
+    return HostControl::decodeSettings(m_settingdefs);
+}
+
+bool ExtensionHost::init()
+{
+    sendInit();
+
+    QCborMap reply;
+
+    if (!waitControl(QStringLiteral("init"), reply, QUASAR_EXTHOST_START_TIMEOUT) || !reply.value(QStringLiteral("ok")).toBool())
+    {
+        return false;
+    }
+
+    m_initialized = true;
+
+    return true;
+}
+
+void ExtensionHost::sendInit()
+{
+    QCborArray sources;
+
+    // Tell the host which sources Quasar takes published and pushed data for, and which ones wait for their data to be sent
+    for (auto& s : m_sources)
+    {
+        DataSource* src = m_owner ? m_owner->getSource(s.uid) : nullptr;
+
+        sources.append(QCborMap{{QStringLiteral("uid"), static_cast<qint64>(s.uid)},
+                                {QStringLiteral("publish"), src && src->published},
+                                {QStringLiteral("push"), src && src->pushring},
+                                {QStringLiteral("signaled"), src && src->locks}});
+    }
+
+    m_stopreader = false;
+    m_reader     = std::thread(&ExtensionHost::readRecords, this);
+
+    HostControl::write(m_socket, QCborMap{{QStringLiteral("op"), QStringLiteral("init")}, {QStringLiteral("sources"), sources}, {QStringLiteral("settings"), m_settingvals}});
+}
+
+void ExtensionHost::update(quasar_settings_t* settings)
+{
+    m_settingvals = HostControl::encodeSettingValues(*settings);
+
+    // Values set before init are handed over along with it
+    if (m_initialized)
+    {
+        HostControl::write(m_socket, QCborMap{{QStringLiteral("op"), QStringLiteral("update")}, {QStringLiteral("settings"), m_settingvals}});
+    }
+}
+
+bool ExtensionHost::getData(size_t uid, QCborValue* dat)
+{
+    auto     call = std::make_shared<PendingCall>();
+    uint32_t seq;
+
+    {
+        std::lock_guard<std::mutex> lk(m_callsMtx);
+        seq          = ++m_seq;
+        m_calls[seq] = call;
+    }
+
+    unsigned int gen  = 0;
+    bool         sent = sendRequest(QCborArray{static_cast<int>(HOST_RECORD_GET), static_cast<qint64>(seq), static_cast<qint64>(uid)}, gen);
+
+    std::unique_lock<std::mutex> lk(call->mutex);
+
+    if (sent && call->cv.wait_for(lk, std::chrono::milliseconds(QUASAR_EXTHOST_CALL_TIMEOUT), [&call] { return call->done; }))
+    {
+        *dat = call->data;
+        return call->ok;
+    }
+
+    lk.unlock();
+
+    {
+        std::lock_guard<std::mutex> clk(m_callsMtx);
+        m_calls.erase(seq);
+    }
+
+    if (sent)
+    {
+        qWarning() << "Extension host of" << m_name << "did not answer get_data in time, restarting it";
+
+        // The process belongs to this object's thread
+        QMetaObject::invokeMethod(
+            this,
+            [this, gen] {
+                if (m_process && m_generation == gen)
+                {
+                    m_process->kill();
+                }
+            },
+            Qt::QueuedConnection);
+    }
+
+    return false;
+}
+
+void ExtensionHost::dataProcessed(size_t uid)
+{
+    unsigned int gen;
+
+    sendRequest(QCborArray{static_cast<int>(HOST_RECORD_PROCESSED), static_cast<qint64>(uid)}, gen);
+}
+
+bool ExtensionHost::sendRequest(const QCborArray& record, unsigned int& gen)
+{
+    std::shared_lock<std::shared_mutex> tlk(m_transportMtx);
+
+    if (!m_running)
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(m_requestMtx);
+
+        gen = m_generation;
+
+        if (!m_requests.write(record.toCborValue().toCbor(), [this] { return m_running.load(); }))
+        {
+            return false;
+        }
+    }
+
+    m_reqsem->release();
+
+    return true;
+}
+
+void ExtensionHost::readRecords()
+{
+    QByteArray         record;
+    const unsigned int gen = m_generation;
+
+    while (true)
+    {
+        m_repsem->acquire();
+
+        if (m_stopreader)
+        {
+            return;
+        }
+
+        HostRing::ReadResult result;
+
+        while ((result = m_replies.read(record)) == HostRing::READ_OK)
+        {
+            handleRecord(QCborValue::fromCbor(record).toArray());
+        }
+
+        if (result == HostRing::READ_CORRUPT)
+        {
+            qWarning() << "Extension host of" << m_name << "corrupted its reply ring, restarting it";
+
+            // Treated like a dead host. The process belongs to this object's thread
+            QMetaObject::invokeMethod(
+                this,
+                [this, gen] {
+                    if (m_process && m_generation == gen)
+                    {
+                        m_process->kill();
+                    }
+                },
+                Qt::QueuedConnection);
+
+            return;
+        }
+    }
+}
+
+void ExtensionHost::handleRecord(const QCborArray& record)
+{
+    const size_t uid = static_cast<size_t>(record[1].toInteger());
+
+    switch (record[0].toInteger())
+    {
+        case HOST_RECORD_REPLY:
+        {
+            std::shared_ptr<PendingCall> call;
+
+            {
+                std::lock_guard<std::mutex> lk(m_callsMtx);
+
+                // Second field is the call's sequence number, the caller may have given up on it
+                auto it = m_calls.find(static_cast<uint32_t>(uid));
+
+                if (it != m_calls.end())
+                {
+                    call = it->second;
+                    m_calls.erase(it);
+                }
+            }
+
+            if (call)
+            {
+                {
+                    std::lock_guard<std::mutex> lk(call->mutex);
+                    call->done = true;
+                    call->ok   = record[2].toBool();
+                    call->data = record[3];
+                }
+
+                call->cv.notify_one();
+            }
+
+            break;
+        }
+
+        case HOST_RECORD_READY:
+        {
+            m_owner->emitDataReady(uid);
+            break;
+        }
+
+        case HOST_RECORD_PUSHCFG:
+        {
+            DataSource* src      = m_owner->getSource(uid);
+            size_t      capacity = static_cast<size_t>(record[2].toInteger());
+
+            if (!src)
+            {
+                break;
+            }
+
+            {
+                std::lock_guard<std::mutex> lk(m_pushcfgMtx);
+
+                // A restarted host configures the same ring again, which is kept along with its frames.
+                // The ring may only be looked at while no replacement is pending
+                if (!m_pushcfgpending.count(uid) && (!src->pushring || src->pushring->capacity() == capacity))
+                {
+                    break;
+                }
+
+                // Frames are dropped until the ring is replaced
+                m_pushcfgpending[uid]++;
+            }
+
+            // The ring is drained on the owner's thread, so it is only replaced there.
+            // Frames are never waited for here, as the ring is drained on the thread that stops this one.
+            // Hosts of waiting sources still wait once the shared ring fills.
+            QMetaObject::invokeMethod(
+                m_owner,
+                [this, uid, capacity, name = src->name] {
+                    m_owner->configurePushRing(name, capacity, QUASAR_PUSH_DROP_NEWEST);
+
+                    std::lock_guard<std::mutex> lk(m_pushcfgMtx);
+
+                    if (--m_pushcfgpending[uid] == 0)
+                    {
+                        m_pushcfgpending.erase(uid);
+                    }
+                },
+                Qt::QueuedConnection);
+
+            break;
+        }
+
+        case HOST_RECORD_PUSH:
+        {
+            {
+                std::lock_guard<std::mutex> lk(m_pushcfgMtx);
+
+                if (m_pushcfgpending.count(uid))
+                {
+                    break;
+                }
+            }
+
+            DataPushRing* ring = m_owner->getPushRing(uid);
+
+            if (ring)
+            {
+                *ring->writeSlot() = record[2];
+                m_owner->commitPush(uid);
+            }
+
+            break;
+        }
+    }
+}
+
+void ExtensionHost::teardown()
+{
+    m_running     = false;
+    m_initialized = false;
+
+    {
+        // Waits for callers still writing requests, which give up now that the host is down
+        std::unique_lock<std::shared_mutex> lk(m_transportMtx);
+
+        if (m_reader.joinable())
+        {
+            m_stopreader = true;
+            m_repsem->release();
+            m_reader.join();
+        }
+
+        m_reqsem.reset();
+        m_repsem.reset();
+        m_shm.reset();
+    }
+
+    PendingCallMapType calls;
+
+    {
+        std::lock_guard<std::mutex> lk(m_callsMtx);
+        calls.swap(m_calls);
+    }
+
+    for (auto& it : calls)
+    {
+        {
+            std::lock_guard<std::mutex> lk(it.second->mutex);
+            it.second->done = true;
+        }
+
+        it.second->cv.notify_one();
+    }
+}
+
+void ExtensionHost::handleFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    if (m_stopping)
+    {
+        return;
+    }
+
+    // A host that ran for a while starts over with a short delay
+    if (m_uptime.elapsed() > QUASAR_EXTHOST_MAX_BACKOFF)
+    {
+        m_backoff = QUASAR_EXTHOST_MIN_BACKOFF;
+    }
+
+    qWarning() << "Extension host of" << m_name << (exitStatus == QProcess::CrashExit ? "crashed" : "exited with code") << exitCode << ", restarting in" << m_backoff
+               << "ms";
+
+    m_restartstate = RESTART_IDLE;
+    m_starttimer->stop();
+
+    teardown();
+    scheduleRestart();
+}
+
+void ExtensionHost::scheduleRestart()
+{
+    if (m_stopping || m_restartpending)
+    {
+        return;
+    }
+
+    m_restartpending = true;
+
+    QTimer::singleShot(m_backoff, this, [this] {
+        m_restartpending = false;
+        restart();
+    });
+
+    m_backoff = std::min(m_backoff * 2, QUASAR_EXTHOST_MAX_BACKOFF);
+}
+
+void ExtensionHost::restart()
+{
+    if (m_stopping)
+    {
+        return;
+    }
+
+    // Runs on the Data Server thread, so nothing is waited for here. The host connects, describes
+    // its extension and answers init, each step being taken as its message arrives and given
+    // QUASAR_EXTHOST_START_TIMEOUT
+    m_restartstate = RESTART_CONNECTING;
+    m_starttimer->start(QUASAR_EXTHOST_START_TIMEOUT);
+
+    if (!launch())
+    {
+        failRestart();
+    }
+}
+
+void ExtensionHost::failRestart()
+{
+    m_restartstate = RESTART_IDLE;
+    m_starttimer->stop();
+
+    teardown();
+
+    if (m_process && m_process->state() != QProcess::NotRunning)
+    {
+        // Comes back through handleFinished()
+        m_process->kill();
+    }
+    else
+    {
+        scheduleRestart();
+    }
+}
+
+void ExtensionHost::shutdown()
+{
+    m_stopping     = true;
+    m_restartstate = RESTART_IDLE;
+    m_starttimer->stop();
+
+    if (m_socket && m_running)
+    {
+        QCborMap reply;
+
+        HostControl::write(m_socket, QCborMap{{QStringLiteral("op"), QStringLiteral("shutdown")}});
+        waitControl(QStringLiteral("shutdown"), reply, QUASAR_EXTHOST_STOP_TIMEOUT);
+    }
+
+    teardown();
+
+    if (m_process && !m_process->waitForFinished(QUASAR_EXTHOST_STOP_TIMEOUT))
+    {
+        m_process->kill();
+        m_process->waitForFinished(QUASAR_EXTHOST_STOP_TIMEOUT);
+    }
+}
@@ -0,0 +1,241 @@
+/*! \file
+    \brief Defines the ExtensionHost class, which runs an extension in a separate process. Not a part of API.
+
+    This file is **NOT** a part of the Extension API and is not shipped with the
+    API package. For reference only. This file is subjected to major changes.
+*/
+
+#pragma once
+
+#include <hostprotocol.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QProcess>
+
+QT_FORWARD_DECLARE_CLASS(QLocalServer)
+QT_FORWARD_DECLARE_CLASS(QLocalSocket)
+QT_FORWARD_DECLARE_CLASS(QSharedMemory)
+QT_FORWARD_DECLARE_CLASS(QSystemSemaphore)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+class DataExtension;
+
+//! Runs an extension library in the extension host process
+/*! Stands in for the library towards DataExtension. Calls to get_data travel through a pair of
+    rings in shared memory, while the extension's description, settings and lifetime are handled
+    over a local socket. If the host dies, pending calls fail and the host is restarted with the
+    same Data Source uids and settings.
+    \sa DataExtension::load()
+*/
+class PAPI_EXPORT ExtensionHost : public QObject
+{
+    Q_OBJECT;
+
+    //! A get_data call waiting for its reply
+    struct PendingCall
+    {
+        std::mutex              mutex;
+        std::condition_variable cv;
+        bool                    done = false;
+        bool                    ok   = false;
+        QCborValue              data;
+    };
+
+    using PendingCallMapType = std::unordered_map<uint32_t, std::shared_ptr<PendingCall>>;
+
+    //! Step a restart is waiting for \sa restart()
+    enum RestartState
+    {
+        RESTART_IDLE = 0,    //!< No restart under way
+        RESTART_CONNECTING,  //!< Waiting for the host to connect
+        RESTART_DESCRIBING,  //!< Waiting for the host to describe its extension
+        RESTART_INITIALIZING //!< Waiting for the result of init()
+    };
+
+public:
+    /*! Creates a host for an extension library. Does not start it
+        \param[in]  libpath     Path to library file
+        \param[in]  parent      Qt parent object
+    */
+    explicit ExtensionHost(QString libpath, QObject* parent = nullptr);
+
+    ~ExtensionHost();
+
+    /*! Starts the host process and waits for it to describe the extension
+        Only used when loading the extension, restarts do not wait.
+        \return true if successful, false otherwise
+    */
+    bool start();
+
+    /*! Gets the extension's description as received from the host
+        Its function pointers are not set, calls go through this object instead.
+        \return extension info struct
+    */
+    quasar_ext_info_t* info() { return &m_info; }
+
+    /*! Sets the DataExtension standing for the hosted extension, before init()
+        \param[in]  extension   DataExtension
+    */
+    void attach(DataExtension* extension) { m_owner = extension; }
+
+    /*! Checks whether the extension has custom settings
+        \return true if it has, false otherwise
+    */
+    bool hasSettings() const { return !m_settingdefs.isEmpty(); }
+
+    /*! Creates the extension's custom settings from their description
+        \return new settings
+        \sa quasar_ext_info_t.create_settings
+    */
+    quasar_settings_t* createSettings();
+
+    /*! Calls init() in the host with the uids assigned to its Data Sources and waits for its result
+        \return result of init()
+        \sa quasar_ext_info_t.init
+    */
+    bool init();
+
+    /*! Hands updated custom settings to the host
+        \param[in]  settings    Settings
+        \sa quasar_ext_info_t.update
+    */
+    void update(quasar_settings_t* settings);
+
+    /*! Calls get_data() in the host. May be called from any thread
+        \param[in]  uid     Data Source uid
+        \param[out] dat     Data
+        \return result of get_data(), false if the host did not answer
+        \sa quasar_ext_info_t.get_data
+    */
+    bool getData(size_t uid, QCborValue* dat);
+
+    /*! Tells the host that the data of a signaled Data Source was sent, releasing quasar_signal_wait_processed()
+        \param[in]  uid     Data Source uid
+    */
+    void dataProcessed(size_t uid);
+
+    /*! Calls shutdown() in the host and stops it
+        \sa quasar_ext_info_t.shutdown
+    */
+    void shutdown();
+
+private:
+    /*! Sets up the shared objects and starts a host process. Does not wait for it
+        \return true if successful, false otherwise
+    */
+    bool launch();
+
+    //! Takes the control socket of a host that connected
+    void acceptHost();
+
+    /*! Takes the extension's description from the host
+        \param[in]  info    Description sent by the host
+        \return true if successful, false if the extension is not the one described before
+    */
+    bool describe(const QCborMap& info);
+
+    //! Sends the init call, its result comes back as an "init" control message
+    void sendInit();
+
+    /*! Writes a request to the host
+        \param[in]  record  Request record
+        \param[out] gen     Host process the request was written to
+        \return true if written, false if the host is down
+    */
+    bool sendRequest(const QCborArray& record, unsigned int& gen);
+
+    /*! Waits for a control message, handling log messages in between
+        \param[in]  op      Operation of the message waited for
+        \param[out] msg     Message
+        \param[in]  timeout Time to wait in milliseconds
+        \return true if received, false otherwise
+    */
+    bool waitControl(QString op, QCborMap& msg, int timeout);
+
+    //! Drops the connection to a host that sent a control message over QUASAR_EXTHOST_CONTROL_MAX and kills it
+    void rejectControl();
+
+    /*! Handles a control message sent by the host on its own
+        \param[in]  msg     Message
+    */
+    void handleControl(const QCborMap& msg);
+
+    //! Reads records sent by the host until stopped. Runs on its own thread
+    void readRecords();
+
+    /*! Handles a record sent by the host
+        \param[in]  record  Record
+    */
+    void handleRecord(const QCborArray& record);
+
+    //! Stops the host connection, failing pending calls. Leaves the process alone
+    void teardown();
+
+    //! Restarts the host after the current backoff delay, unless already scheduled
+    void scheduleRestart();
+
+    //! Restarts a host that died, without waiting for it. The restart goes on in handleControl()
+    void restart();
+
+    //! Gives up on a restart and schedules the next one
+    void failRestart();
+
+    /*! Handles the host process exiting
+        \param[in]  exitCode    Exit code
+        \param[in]  exitStatus  Exit status
+    */
+    void handleFinished(int exitCode, QProcess::ExitStatus exitStatus);
+
+    QString      m_libpath; //!< Path to library file
+    QString      m_name;    //!< Extension identifier, once known
+    unsigned int m_id;      //!< Tells this host's shared objects apart from other hosts'
+
+    quasar_ext_info_t                 m_info{};      //!< Extension description
+    quasar_ext_info_fields_t          m_fields{};    //!< Extension info fields
+    std::vector<quasar_data_source_t> m_sources;     //!< Extension Data Sources
+    QCborArray                        m_settingdefs; //!< Custom settings definitions
+    QCborMap                          m_settingvals; //!< Custom settings values, handed to the host again if it restarts
+
+    DataExtension* m_owner = nullptr; //!< DataExtension standing for the extension
+
+    QProcess*                 m_process        = nullptr;      //!< Host process
+    QLocalServer*             m_listener       = nullptr;      //!< Server the host process connects to
+    QLocalSocket*             m_socket         = nullptr;      //!< Control socket
+    QTimer*                   m_starttimer     = nullptr;      //!< Times out the current step of a restart
+    RestartState              m_restartstate   = RESTART_IDLE; //!< Step a restart is waiting for
+    QElapsedTimer             m_uptime;                        //!< Time since the host process started
+    bool                      m_sync           = false;        //!< Whether a control message is being waited for
+    bool                      m_initialized    = false;        //!< Whether init() succeeded in the current host process
+    bool                      m_stopping       = false;        //!< Whether the host is being shut down
+    bool                      m_restartpending = false;        //!< Whether a restart is scheduled
+    int                       m_backoff        = 0;            //!< Delay before the next restart in milliseconds
+    std::atomic<unsigned int> m_generation{0};                 //!< Number of host processes started
+
+    std::unique_ptr<QSharedMemory>    m_shm;               //!< Memory holding both rings
+    std::unique_ptr<QSystemSemaphore> m_reqsem;            //!< Signaled when a request was written
+    std::unique_ptr<QSystemSemaphore> m_repsem;            //!< Signaled when the host wrote a record
+    HostRing                          m_requests;          //!< Requests to the host
+    HostRing                          m_replies;           //!< Records from the host
+    std::mutex                        m_requestMtx;        //!< Serializes writers of m_requests
+    std::shared_mutex                 m_transportMtx;      //!< Held exclusively while the shared objects are replaced
+    std::thread                       m_reader;            //!< Thread running readRecords()
+    std::atomic<bool>                 m_stopreader{false}; //!< Tells readRecords() to return
+    std::atomic<bool>                 m_running{false};    //!< Whether the host is up and taking calls
+
+    PendingCallMapType m_calls;    //!< get_data calls waiting for their reply, by sequence number
+    std::mutex         m_callsMtx; //!< Guards m_calls and m_seq
+    uint32_t           m_seq = 0;  //!< Last sequence number used
+
+    std::unordered_map<size_t, unsigned int> m_pushcfgpending; //!< Push ring replacements queued to the owner's thread, by Data Source uid
+    std::mutex                               m_pushcfgMtx;     //!< Guards m_pushcfgpending
+};
@@ -0,0 +1,351 @@
+#include "hostprotocol.h"
+
+#include "extension_support_internal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include <QIODevice>
+#include <QtEndian>
+
+std::atomic<ExtensionHostSink*> ExtensionHostSink::_current{nullptr};
+
+void HostRing::attach(void* mem, uint32_t size, bool create)
+{
+    m_header = static_cast<Header*>(mem);
+    m_data   = static_cast<char*>(mem) + sizeof(Header);
+    m_size   = size;
+
+    if (create)
+    {
+        new (m_header) Header();
+        m_header->head.store(0);
+        m_header->tail.store(0);
+    }
+}
+
+void HostRing::copyIn(uint32_t pos, const char* src, uint32_t len)
+{
+    const uint32_t off   = pos & (m_size - 1);
+    const uint32_t first = std::min(len, m_size - off);
+
+    memcpy(m_data + off, src, first);
+    memcpy(m_data, src + first, len - first);
+}
+
+void HostRing::copyOut(uint32_t pos, char* dst, uint32_t len) const
+{
+    const uint32_t off   = pos & (m_size - 1);
+    const uint32_t first = std::min(len, m_size - off);
+
+    memcpy(dst, m_data + off, first);
+    memcpy(dst + first, m_data, len - first);
+}
+
+bool HostRing::write(const QByteArray& record, const std::function<bool()>& alive)
+{
+    const uint32_t len  = static_cast<uint32_t>(record.size());
+    const uint32_t need = sizeof(uint32_t) + len;
+
+    if (need > m_size)
+    {
+        return false;
+    }
+
+    const uint32_t head = m_header->head.load(std::memory_order_relaxed);
+
+    while (m_size - (head - m_header->tail.load(std::memory_order_acquire)) < need)
+    {
+        if (!alive())
+        {
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    copyIn(head, reinterpret_cast<const char*>(&len), sizeof(uint32_t));
+    copyIn(head + sizeof(uint32_t), record.constData(), len);
+
+    m_header->head.store(head + need, std::memory_order_release);
+
+    return true;
+}
+
+HostRing::ReadResult HostRing::read(QByteArray& record)
+{
+    const uint32_t tail  = m_header->tail.load(std::memory_order_relaxed);
+    const uint32_t avail = m_header->head.load(std::memory_order_acquire) - tail;
+
+    if (avail == 0)
+    {
+        return READ_EMPTY;
+    }
+
+    if (avail > m_size || avail < sizeof(uint32_t))
+    {
+        return READ_CORRUPT;
+    }
+
+    uint32_t len;
+    copyOut(tail, reinterpret_cast<char*>(&len), sizeof(uint32_t));
+
+    if (len > avail - sizeof(uint32_t) || len > m_size)
+    {
+        return READ_CORRUPT;
+    }
+
+    record.resize(static_cast<int>(len));
+    copyOut(tail + sizeof(uint32_t), record.data(), len);
+
+    m_header->tail.store(tail + sizeof(uint32_t) + len, std::memory_order_release);
+
+    return READ_OK;
+}
+
+void HostControl::write(QIODevice* dev, const QCborMap& msg)
+{
+    QByteArray payload = msg.toCborValue().toCbor();
+    quint32    len     = qToBigEndian(static_cast<quint32>(payload.size()));
+
+    dev->write(reinterpret_cast<const char*>(&len), sizeof(len));
+    dev->write(payload);
+}
+
+HostRing::ReadResult HostControl::read(QIODevice* dev, QCborMap& msg)
+{
+    quint32 len;
+
+    if (dev->peek(reinterpret_cast<char*>(&len), sizeof(len)) < static_cast<qint64>(sizeof(len)))
+    {
+        return HostRing::READ_EMPTY;
+    }
+
+    len = qFromBigEndian(len);
+
+    if (len > QUASAR_EXTHOST_CONTROL_MAX)
+    {
+        return HostRing::READ_CORRUPT;
+    }
+
+    if (dev->bytesAvailable() < static_cast<qint64>(sizeof(len) + len))
+    {
+        return HostRing::READ_EMPTY;
+    }
+
+    dev->skip(sizeof(len));
+
+    msg = QCborValue::fromCbor(dev->read(len)).toMap();
+
+    return HostRing::READ_OK;
+}
+
+QCborArray HostControl::encodeSettings(const quasar_settings_t& settings)
+{
+    QCborArray defs;
+
+    for (auto& it : settings.map)
+    {
+        auto&    entry = it.second;
+        QCborMap def{{QStringLiteral("name"), it.first}, {QStringLiteral("type"), static_cast<int>(entry.type)}, {QStringLiteral("desc"), entry.description}};
+
+        switch (entry.type)
+        {
+            case QUASAR_SETTING_ENTRY_INT:
+            {
+                auto c                       = entry.var.value<esi_inttype_t>();
+                def[QStringLiteral("range")] = QCborArray{c.min, c.max, c.step, c.def};
+                break;
+            }
+            case QUASAR_SETTING_ENTRY_DOUBLE:
+            {
+                auto c                       = entry.var.value<esi_doubletype_t>();
+                def[QStringLiteral("range")] = QCborArray{c.min, c.max, c.step, c.def};
+                break;
+            }
+            case QUASAR_SETTING_ENTRY_BOOL:
+            {
+                def[QStringLiteral("def")] = entry.var.value<esi_booltype_t>().def;
+                break;
+            }
+            case QUASAR_SETTING_ENTRY_STRING:
+            {
+                def[QStringLiteral("def")] = entry.var.value<esi_stringtype_t>().def;
+                break;
+            }
+            case QUASAR_SETTING_ENTRY_SELECTION:
+            {
+                QCborArray list;
+
+                for (auto& opt : entry.var.value<quasar_selection_options_t>().list)
+                {
+                    list.append(QCborArray{opt.name, opt.value});
+                }
+
+                def[QStringLiteral("list")] = list;
+                break;
+            }
+        }
+
+        defs.append(def);
+    }
+
+    return defs;
+}
+
+quasar_settings_t* HostControl::decodeSettings(const QCborArray& defs)
+{
+    auto settings = new quasar_settings_t;
+
+    for (const auto& d : defs)
+    {
+        QCborMap             def = d.toMap();
+        quasar_setting_def_t entry;
+
+        entry.type        = static_cast<QuasarSettingEntryType>(def[QStringLiteral("type")].toInteger());
+        entry.description = def[QStringLiteral("desc")].toString();
+
+        switch (entry.type)
+        {
+            case QUASAR_SETTING_ENTRY_INT:
+            {
+                QCborArray    r = def[QStringLiteral("range")].toArray();
+                esi_inttype_t c;
+                c.min  = r[0].toInteger();
+                c.max  = r[1].toInteger();
+                c.step = r[2].toInteger();
+                c.def = c.val = r[3].toInteger();
+                entry.var.setValue(c);
+                break;
+            }
+            case QUASAR_SETTING_ENTRY_DOUBLE:
+            {
+                QCborArray       r = def[QStringLiteral("range")].toArray();
+                esi_doubletype_t c;
+                c.min  = r[0].toDouble();
+                c.max  = r[1].toDouble();
+                c.step = r[2].toDouble();
+                c.def = c.val = r[3].toDouble();
+                entry.var.setValue(c);
+                break;
+            }
+            case QUASAR_SETTING_ENTRY_BOOL:
+            {
+                esi_booltype_t c;
+                c.def = c.val = def[QStringLiteral("def")].toBool();
+                entry.var.setValue(c);
+                break;
+            }
+            case QUASAR_SETTING_ENTRY_STRING:
+            {
+                esi_stringtype_t c;
+                c.def = def[QStringLiteral("def")].toString();
+                entry.var.setValue(c);
+                break;
+            }
+            case QUASAR_SETTING_ENTRY_SELECTION:
+            {
+                quasar_selection_options_t c;
+
+                for (const auto& opt : def[QStringLiteral("list")].toArray())
+                {
+                    c.list.append({opt.toArray()[0].toString(), opt.toArray()[1].toString()});
+                }
+
+                entry.var.setValue(c);
+                break;
+            }
+        }
+
+        settings->map.insert(std::make_pair(def[QStringLiteral("name")].toString(), entry));
+    }
+
+    return settings;
+}
+
+QCborMap HostControl::encodeSettingValues(const quasar_settings_t& settings)
+{
+    QCborMap values;
+
+    for (auto& it : settings.map)
+    {
+        auto& entry = it.second;
+
+        switch (entry.type)
+        {
+            case QUASAR_SETTING_ENTRY_INT:
+                values[it.first] = entry.var.value<esi_inttype_t>().val;
+                break;
+            case QUASAR_SETTING_ENTRY_DOUBLE:
+                values[it.first] = entry.var.value<esi_doubletype_t>().val;
+                break;
+            case QUASAR_SETTING_ENTRY_BOOL:
+                values[it.first] = entry.var.value<esi_booltype_t>().val;
+                break;
+            case QUASAR_SETTING_ENTRY_STRING:
+                values[it.first] = entry.var.value<esi_stringtype_t>().val;
+                break;
+            case QUASAR_SETTING_ENTRY_SELECTION:
+                values[it.first] = entry.var.value<quasar_selection_options_t>().val;
+                break;
+        }
+    }
+
+    return values;
+}
+
+void HostControl::applySettingValues(quasar_settings_t& settings, const QCborMap& values)
+{
+    for (auto it = settings.map.begin(); it != settings.map.end(); ++it)
+    {
+        auto& entry = it.value();
+        auto  val   = values.value(it.key());
+
+        if (val.isUndefined())
+        {
+            continue;
+        }
+
+        switch (entry.type)
+        {
+            case QUASAR_SETTING_ENTRY_INT:
+            {
+                auto c = entry.var.value<esi_inttype_t>();
+                c.val  = val.toInteger();
+                entry.var.setValue(c);
+                break;
+            }
+            case QUASAR_SETTING_ENTRY_DOUBLE:
+            {
+                auto c = entry.var.value<esi_doubletype_t>();
+                c.val  = val.toDouble();
+                entry.var.setValue(c);
+                break;
+            }
+            case QUASAR_SETTING_ENTRY_BOOL:
+            {
+                auto c = entry.var.value<esi_booltype_t>();
+                c.val  = val.toBool();
+                entry.var.setValue(c);
+                break;
+            }
+            case QUASAR_SETTING_ENTRY_STRING:
+            {
+                auto c = entry.var.value<esi_stringtype_t>();
+                c.val  = val.toString();
+                entry.var.setValue(c);
+                break;
+            }
+            case QUASAR_SETTING_ENTRY_SELECTION:
+            {
+                auto c = entry.var.value<quasar_selection_options_t>();
+                c.val  = val.toString();
+                entry.var.setValue(c);
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,218 @@
+/*! \file
+    \brief Internal types shared by Quasar and the extension host process. Not a part of API.
+
+    This file is **NOT** a part of the Extension API and is not shipped with the
+    API package. For reference only. This file is subjected to major changes.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include <QByteArray>
+#include <QCborArray>
+#include <QCborMap>
+
+#include <extension_types.h>
+
+#ifndef PAPI_EXPORT
+#    ifdef PLUGINAPI_LIB
+#        define PAPI_EXPORT Q_DECL_EXPORT
+#    else
+#        define PAPI_EXPORT Q_DECL_IMPORT
+#    endif // PLUGINAPI_LIB
+#endif     // PAPI_EXPORT
+
+QT_FORWARD_DECLARE_CLASS(QIODevice)
+
+//! Name of the extension host executable, next to the Quasar executable
+#define QUASAR_EXTHOST_NAME "quasar-exthost"
+
+//! Size in bytes of the ring carrying requests from Quasar to the host
+#define QUASAR_EXTHOST_REQUEST_RING (1u << 16)
+
+//! Size in bytes of the ring carrying data from the host to Quasar
+#define QUASAR_EXTHOST_REPLY_RING (1u << 22)
+
+//! Largest control message in bytes, longer ones mean the other side cannot be trusted anymore
+#define QUASAR_EXTHOST_CONTROL_MAX QUASAR_EXTHOST_REPLY_RING
+
+//! Time in milliseconds the host has to start and describe its extension
+#define QUASAR_EXTHOST_START_TIMEOUT 10000
+
+//! Time in milliseconds the host has to answer a get_data call before it is restarted
+#define QUASAR_EXTHOST_CALL_TIMEOUT 5000
+
+//! Time in milliseconds the host has to shut its extension down before it is killed
+#define QUASAR_EXTHOST_STOP_TIMEOUT 3000
+
+//! Delay in milliseconds before restarting a host that died
+#define QUASAR_EXTHOST_MIN_BACKOFF 500
+
+//! Longest delay in milliseconds before restarting a host that keeps dying
+#define QUASAR_EXTHOST_MAX_BACKOFF 30000
+
+//! Types of the records passed through the shared memory rings
+/*! Each record is a CBOR array starting with its type.
+*/
+enum HostRecordType : int
+{
+    HOST_RECORD_GET = 0,   //!< Quasar to host: [type, seq, uid], calls get_data
+    HOST_RECORD_PROCESSED, //!< Quasar to host: [type, uid], the data of a signaled Data Source was sent
+    HOST_RECORD_REPLY,     //!< Host to Quasar: [type, seq, ok, data], result of a get_data call
+    HOST_RECORD_READY,     //!< Host to Quasar: [type, uid], the extension signaled a Data Source ready
+    HOST_RECORD_PUSH,      //!< Host to Quasar: [type, uid, data], the extension pushed a frame
+    HOST_RECORD_PUSHCFG    //!< Host to Quasar: [type, uid, capacity, policy], the extension configured a push ring
+};
+
+//! Ring of variable sized records laid over shared memory
+/*! Records are written by one side of the host connection and read by the other.
+    Writers on the same side must be serialized by the caller, there may be a single reader.
+*/
+class PAPI_EXPORT HostRing
+{
+public:
+    //! Outcome of read()
+    enum ReadResult
+    {
+        READ_EMPTY = 0, //!< No record to read
+        READ_OK,        //!< A record was read
+        READ_CORRUPT    //!< The ring positions or the record length are out of bounds, the writer cannot be trusted anymore
+    };
+
+    /*! Gets the number of bytes a ring takes in shared memory
+        \param[in]  size    Ring size in bytes, a power of 2
+        \return bytes needed
+    */
+    static size_t footprint(uint32_t size) { return sizeof(Header) + size; }
+
+    /*! Lays the ring over shared memory
+        \param[in]  mem     Start of the ring in shared memory
+        \param[in]  size    Ring size in bytes, a power of 2
+        \param[in]  create  Whether to reset the ring, done by the side creating the memory
+    */
+    void attach(void* mem, uint32_t size, bool create);
+
+    /*! Writes a record, waiting for the reader to make room if needed
+        \param[in]  record  Record to write
+        \param[in]  alive   Checked while waiting, gives up once it returns false
+        \return true if written, false if the record does not fit the ring or the wait was given up
+    */
+    bool write(const QByteArray& record, const std::function<bool()>& alive);
+
+    /*! Reads the oldest record
+        The ring is written by the other process, so its contents are checked before use.
+        \param[out] record  Record read
+        \return outcome of the read
+    */
+    ReadResult read(QByteArray& record);
+
+private:
+    //! Positions shared by both processes, counting bytes ever written and read
+    struct Header
+    {
+        std::atomic<uint32_t> head;
+        std::atomic<uint32_t> tail;
+    };
+
+    void copyIn(uint32_t pos, const char* src, uint32_t len);
+    void copyOut(uint32_t pos, char* dst, uint32_t len) const;
+
+    Header*  m_header = nullptr; //!< Ring positions
+    char*    m_data   = nullptr; //!< Ring bytes
+    uint32_t m_size   = 0;       //!< Ring size in bytes
+};
+
+//! Receives the calls an extension makes on its handle while it runs in the extension host
+/*! Installed by the host process only. The extension_support.h functions taking a handle
+    forward to it instead of a DataExtension once installed.
+*/
+class PAPI_EXPORT ExtensionHostSink
+{
+public:
+    virtual ~ExtensionHostSink() = default;
+
+    /*! Gets the sink installed in this process
+        \return installed sink, nullptr outside of the host process
+    */
+    static ExtensionHostSink* current() { return _current.load(std::memory_order_acquire); }
+
+    /*! Installs the sink of this process
+        \param[in]  sink    Sink to install
+    */
+    static void install(ExtensionHostSink* sink) { _current.store(sink, std::memory_order_release); }
+
+    /*! Gets the uid of a Data Source
+        \param[in]  source  Data Source identifier
+        \return uid, 0 if unknown
+    */
+    virtual size_t sourceUid(const char* source) = 0;
+
+    //! \sa quasar_signal_data_ready_uid()
+    virtual void signalDataReady(size_t uid) = 0;
+
+    //! \sa quasar_signal_wait_processed_uid()
+    virtual void waitDataProcessed(size_t uid) = 0;
+
+    //! \sa quasar_publish_begin()
+    virtual QCborValue* publishBegin(size_t uid) = 0;
+
+    //! \sa quasar_publish_commit()
+    virtual void publishCommit(size_t uid) = 0;
+
+    //! \sa quasar_push_configure()
+    virtual bool pushConfigure(size_t uid, size_t capacity, quasar_push_overflow_t policy) = 0;
+
+    //! \sa quasar_push_begin()
+    virtual QCborValue* pushBegin(size_t uid) = 0;
+
+    //! \sa quasar_push_commit()
+    virtual bool pushCommit(size_t uid) = 0;
+
+private:
+    static std::atomic<ExtensionHostSink*> _current; //!< Sink installed in this process
+};
+
+//! Control messages, length prefixed CBOR maps with an "op" entry
+namespace HostControl
+{
+    /*! Writes a control message
+        \param[in]  dev     Control socket
+        \param[in]  msg     Message
+    */
+    PAPI_EXPORT void write(QIODevice* dev, const QCborMap& msg);
+
+    /*! Reads a control message if one was received in full
+        The length prefix comes from the other process, so it is checked before anything is buffered for it.
+        \param[in]  dev     Control socket
+        \param[out] msg     Message
+        \return outcome of the read, HostRing::READ_CORRUPT if the length is over QUASAR_EXTHOST_CONTROL_MAX
+    */
+    PAPI_EXPORT HostRing::ReadResult read(QIODevice* dev, QCborMap& msg);
+
+    /*! Describes custom settings and their current values
+        \param[in]  settings    Settings
+        \return settings definitions
+    */
+    PAPI_EXPORT QCborArray encodeSettings(const quasar_settings_t& settings);
+
+    /*! Recreates custom settings described by encodeSettings()
+        \param[in]  defs    Settings definitions
+        \return new settings
+    */
+    PAPI_EXPORT quasar_settings_t* decodeSettings(const QCborArray& defs);
+
+    /*! Gets the current values of custom settings
+        \param[in]  settings    Settings
+        \return values by setting name
+    */
+    PAPI_EXPORT QCborMap encodeSettingValues(const quasar_settings_t& settings);
+
+    /*! Sets the current values of custom settings
+        \param[in]  settings    Settings
+        \param[in]  values      Values by setting name, as given by encodeSettingValues()
+    */
+    PAPI_EXPORT void applySettingValues(quasar_settings_t& settings, const QCborMap& values);
+}
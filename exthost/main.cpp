@@ -0,0 +1,633 @@
+#include <datapublish.h>
+#include <extension_support_internal.h>
+#include <hostprotocol.h>
+#include <qstring_hash_impl.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QLibrary>
+#include <QLocalSocket>
+#include <QRunnable>
+#include <QSharedMemory>
+#include <QSystemSemaphore>
+#include <QThread>
+#include <QThreadPool>
+
+namespace
+{
+    //! Shorthand type for quasar_extension_load()
+    using extension_load = std::add_pointer_t<quasar_ext_info_t*(void)>;
+
+    //! Shorthand type for quasar_extension_destroy()
+    using extension_destroy = std::add_pointer_t<void(quasar_ext_info_t*)>;
+
+    //! Runs a get_data call on the worker pool
+    class GetDataTask : public QRunnable
+    {
+    public:
+        explicit GetDataTask(std::function<void()> fn) : m_fn(std::move(fn)) {}
+
+        void run() override { m_fn(); }
+
+    private:
+        std::function<void()> m_fn;
+    };
+
+    //! Host side state of a Data Source
+    struct HostedSource
+    {
+        std::unique_ptr<DataPublishBuffer> published;                          //!< Latest value published by the extension, served instead of get_data once set
+        bool                               push     = false;                   //!< Whether Quasar takes pushed frames for this source
+        bool                               signaled = false;                   //!< Whether quasar_signal_wait_processed() waits for Quasar
+        quasar_push_overflow_t             policy   = QUASAR_PUSH_DROP_NEWEST; //!< What to do when the reply ring is full
+        QCborValue                         pushslot;                           //!< Frame being pushed
+        std::mutex                         mutex;                              //!< Guards processed and reads of published
+        std::condition_variable            cv;                                 //!< Signaled when processed is set
+        bool                               processed = false;                  //!< Whether Quasar sent the data since the last wait
+    };
+
+    //! Loads an extension library and serves it to Quasar
+    class HostedExtension : public QObject, public ExtensionHostSink
+    {
+    public:
+        HostedExtension(QString libpath, QString key) : m_libpath(libpath), m_key(key) {}
+
+        ~HostedExtension();
+
+        /*! Loads the extension, connects to Quasar and describes the extension to it
+            \return true if successful, false otherwise
+        */
+        bool open();
+
+        /*! Forwards a log message to Quasar. May be called from any thread
+            \param[in]  type    Message type
+            \param[in]  msg     Message
+        */
+        void log(QtMsgType type, const QString& msg);
+
+        size_t      sourceUid(const char* source) override;
+        void        signalDataReady(size_t uid) override;
+        void        waitDataProcessed(size_t uid) override;
+        QCborValue* publishBegin(size_t uid) override;
+        void        publishCommit(size_t uid) override;
+        bool        pushConfigure(size_t uid, size_t capacity, quasar_push_overflow_t policy) override;
+        QCborValue* pushBegin(size_t uid) override;
+        bool        pushCommit(size_t uid) override;
+
+    private:
+        //! Handles a control message from Quasar
+        void handleControl(const QCborMap& msg);
+
+        //! Takes the uids and settings handed over by Quasar and calls init()
+        bool init(const QCborMap& msg);
+
+        //! Applies custom setting values and calls update()
+        void update(const QCborMap& values);
+
+        //! Stops serving requests and releases threads waiting on Quasar
+        void stop();
+
+        //! Calls shutdown() and leaves the event loop
+        void finish();
+
+        //! Reads requests from Quasar until stopped. Runs on its own thread
+        void readRequests();
+
+        //! Answers a get_data request. Runs on the worker pool
+        void serveGet(uint32_t seq, size_t uid);
+
+        /*! Writes a record to Quasar
+            \param[in]  record  Record
+            \param[in]  wait    Whether to wait for room if the reply ring is full
+            \return true if written, false if dropped
+        */
+        bool writeRecord(const QCborArray& record, bool wait);
+
+        HostedSource* getSource(size_t uid)
+        {
+            auto it = m_sources.find(uid);
+            return it != m_sources.end() ? it->second.get() : nullptr;
+        }
+
+        QString m_libpath; //!< Path to library file
+        QString m_key;     //!< Name of the shared objects set up by Quasar
+
+        QLibrary                           m_lib;                   //!< Extension library
+        quasar_ext_info_t*                 m_extension   = nullptr; //!< Extension info data
+        extension_destroy                  m_destroyfunc = nullptr; //!< Extension destroy function
+        std::unique_ptr<quasar_settings_t> m_settings;              //!< Extension settings
+        bool                               m_initialized = false;   //!< Whether init() succeeded
+
+        std::unordered_map<QString, size_t>                       m_uids;    //!< Data Source uids by identifier
+        std::unordered_map<size_t, std::unique_ptr<HostedSource>> m_sources; //!< Data Sources by uid, set once on init
+
+        QLocalSocket*                     m_socket = nullptr; //!< Control socket
+        std::unique_ptr<QSharedMemory>    m_shm;              //!< Memory holding both rings
+        std::unique_ptr<QSystemSemaphore> m_reqsem;           //!< Signaled when Quasar wrote a request
+        std::unique_ptr<QSystemSemaphore> m_repsem;           //!< Signaled when a record was written for Quasar
+        HostRing                          m_requests;         //!< Requests from Quasar
+        HostRing                          m_replies;          //!< Records to Quasar
+        std::mutex                        m_replyMtx;         //!< Serializes writers of m_replies
+        std::thread                       m_reader;           //!< Thread running readRequests()
+        QThreadPool                       m_workers;          //!< Pool running get_data calls
+        std::atomic<bool>                 m_stopping{false};  //!< Whether the host is stopping
+    };
+
+    HostedExtension* _host = nullptr;           //!< Host of this process, once open
+    QtMessageHandler _defaulthandler = nullptr; //!< Message handler replaced by forwardMessage()
+
+    //! Sends log messages to Quasar once the host is open
+    void forwardMessage(QtMsgType type, const QMessageLogContext& context, const QString& msg)
+    {
+        if (_host)
+        {
+            _host->log(type, msg);
+        }
+        else if (_defaulthandler)
+        {
+            _defaulthandler(type, context, msg);
+        }
+    }
+
+    //! Converts a fixed size char array of the extension API to a QString
+    template<size_t N>
+    QString fromField(const char (&src)[N])
+    {
+        return QString::fromUtf8(src, static_cast<int>(qstrnlen(src, N)));
+    }
+}
+
+HostedExtension::~HostedExtension()
+{
+    stop();
+
+    // extension is responsible for cleanup of quasar_ext_info_t*
+    if (m_extension && m_destroyfunc)
+    {
+        m_destroyfunc(m_extension);
+    }
+
+    ExtensionHostSink::install(nullptr);
+}
+
+bool HostedExtension::open()
+{
+    m_lib.setFileName(m_libpath);
+
+    if (!m_lib.load())
+    {
+        qWarning() << m_lib.errorString();
+        return false;
+    }
+
+    extension_load loadfunc = (extension_load) m_lib.resolve("quasar_ext_load");
+    m_destroyfunc           = (extension_destroy) m_lib.resolve("quasar_ext_destroy");
+
+    if (!loadfunc || !m_destroyfunc)
+    {
+        qWarning() << "Failed to resolve extension API in" << m_libpath;
+        return false;
+    }
+
+    m_shm = std::make_unique<QSharedMemory>(m_key);
+
+    if (!m_shm->attach())
+    {
+        qWarning() << "Failed to attach shared memory" << m_key << ":" << m_shm->errorString();
+        return false;
+    }
+
+    m_reqsem = std::make_unique<QSystemSemaphore>(m_key + "-req", 0, QSystemSemaphore::Open);
+    m_repsem = std::make_unique<QSystemSemaphore>(m_key + "-rep", 0, QSystemSemaphore::Open);
+
+    m_requests.attach(m_shm->data(), QUASAR_EXTHOST_REQUEST_RING, false);
+    m_replies.attach(static_cast<char*>(m_shm->data()) + HostRing::footprint(QUASAR_EXTHOST_REQUEST_RING), QUASAR_EXTHOST_REPLY_RING, false);
+
+    m_socket = new QLocalSocket(this);
+    m_socket->connectToServer(m_key);
+
+    if (!m_socket->waitForConnected(QUASAR_EXTHOST_START_TIMEOUT))
+    {
+        qWarning() << "Failed to connect to Quasar:" << m_socket->errorString();
+        return false;
+    }
+
+    // Calls made by the extension on its handle come here from now on
+    ExtensionHostSink::install(this);
+
+    m_extension = loadfunc();
+
+    if (!m_extension || !m_extension->init || !m_extension->shutdown || !m_extension->get_data || !m_extension->fields || !m_extension->dataSources)
+    {
+        qWarning() << "quasar_ext_load failed in" << m_libpath << ": required extension data missing";
+        return false;
+    }
+
+    if (m_extension->create_settings)
+    {
+        m_settings.reset(m_extension->create_settings());
+
+        if (!m_settings)
+        {
+            qWarning() << "create_settings() failed in" << m_libpath;
+            return false;
+        }
+    }
+
+    QCborArray sources;
+
+    for (size_t i = 0; i < m_extension->numDataSources; i++)
+    {
+        auto& src = m_extension->dataSources[i];
+
+        sources.append(QCborMap{{QStringLiteral("name"), fromField(src.name)},
+                                {QStringLiteral("rate"), static_cast<qint64>(src.rate)},
+                                {QStringLiteral("validtime"), static_cast<qint64>(src.validtime)}});
+    }
+
+    auto fields = m_extension->fields;
+
+    QCborMap info{{QStringLiteral("op"), QStringLiteral("info")},
+                  {QStringLiteral("fields"),
+                   QCborMap{{QStringLiteral("name"), fromField(fields->name)},
+                            {QStringLiteral("fullname"), fromField(fields->fullname)},
+                            {QStringLiteral("version"), fromField(fields->version)},
+                            {QStringLiteral("author"), fromField(fields->author)},
+                            {QStringLiteral("description"), fromField(fields->description)},
+                            {QStringLiteral("url"), fromField(fields->url)}}},
+                  {QStringLiteral("sources"), sources},
+                  {QStringLiteral("settings"), m_settings ? HostControl::encodeSettings(*m_settings) : QCborArray()},
+                  {QStringLiteral("api"), m_extension->api_version}};
+
+    HostControl::write(m_socket, info);
+
+    connect(m_socket, &QLocalSocket::readyRead, this, [this] {
+        QCborMap             msg;
+        HostRing::ReadResult result;
+
+        while ((result = HostControl::read(m_socket, msg)) == HostRing::READ_OK)
+        {
+            handleControl(msg);
+        }
+
+        // Comes back through disconnected
+        if (result == HostRing::READ_CORRUPT)
+        {
+            m_socket->abort();
+        }
+    });
+
+    // Quasar went away without shutting the extension down
+    connect(m_socket, &QLocalSocket::disconnected, this, [this] {
+        if (!m_stopping)
+        {
+            finish();
+        }
+    });
+
+    return true;
+}
+
+void HostedExtension::log(QtMsgType type, const QString& msg)
+{
+    // The socket belongs to the main thread
+    QMetaObject::invokeMethod(
+        this,
+        [this, type, msg] {
+            if (m_socket && m_socket->state() == QLocalSocket::ConnectedState)
+            {
+                HostControl::write(m_socket, QCborMap{{QStringLiteral("op"), QStringLiteral("log")}, {QStringLiteral("level"), static_cast<int>(type)}, {QStringLiteral("msg"), msg}});
+            }
+        },
+        Qt::QueuedConnection);
+}
+
+void HostedExtension::handleControl(const QCborMap& msg)
+{
+    QString op = msg.value(QStringLiteral("op")).toString();
+
+    if (op == QStringLiteral("init"))
+    {
+        bool ok = init(msg);
+
+        HostControl::write(m_socket, QCborMap{{QStringLiteral("op"), QStringLiteral("init")}, {QStringLiteral("ok"), ok}});
+    }
+    else if (op == QStringLiteral("update"))
+    {
+        update(msg.value(QStringLiteral("settings")).toMap());
+    }
+    else if (op == QStringLiteral("shutdown"))
+    {
+        finish();
+
+        HostControl::write(m_socket, QCborMap{{QStringLiteral("op"), QStringLiteral("shutdown")}});
+        m_socket->waitForBytesWritten(QUASAR_EXTHOST_STOP_TIMEOUT);
+    }
+}
+
+bool HostedExtension::init(const QCborMap& msg)
+{
+    if (m_initialized)
+    {
+        return true;
+    }
+
+    QCborArray sources = msg.value(QStringLiteral("sources")).toArray();
+
+    if (sources.size() != static_cast<qsizetype>(m_extension->numDataSources))
+    {
+        qWarning() << "Quasar described" << sources.size() << "Data Sources, extension has" << m_extension->numDataSources;
+        return false;
+    }
+
+    // Uids are assigned by Quasar, which keeps them across host restarts
+    for (size_t i = 0; i < m_extension->numDataSources; i++)
+    {
+        QCborMap desc = sources[static_cast<qsizetype>(i)].toMap();
+        size_t   uid  = static_cast<size_t>(desc.value(QStringLiteral("uid")).toInteger());
+        auto     src  = std::make_unique<HostedSource>();
+
+        if (desc.value(QStringLiteral("publish")).toBool())
+        {
+            src->published = std::make_unique<DataPublishBuffer>();
+        }
+
+        src->push     = desc.value(QStringLiteral("push")).toBool();
+        src->signaled = desc.value(QStringLiteral("signaled")).toBool();
+
+        m_extension->dataSources[i].uid                     = uid;
+        m_uids[fromField(m_extension->dataSources[i].name)] = uid;
+        m_sources[uid]                                      = std::move(src);
+    }
+
+    update(msg.value(QStringLiteral("settings")).toMap());
+
+    if (!m_extension->init(this))
+    {
+        qWarning() << "init() failed in" << m_libpath;
+        return false;
+    }
+
+    m_initialized = true;
+
+    // Requests sent meanwhile wait in the ring
+    m_workers.setMaxThreadCount(qBound(1, static_cast<int>(m_sources.size()), QThread::idealThreadCount()));
+    m_reader = std::thread(&HostedExtension::readRequests, this);
+
+    return true;
+}
+
+void HostedExtension::update(const QCborMap& values)
+{
+    if (m_settings && m_extension->update)
+    {
+        HostControl::applySettingValues(*m_settings, values);
+        m_extension->update(m_settings.get());
+    }
+}
+
+void HostedExtension::stop()
+{
+    m_stopping = true;
+
+    for (auto& it : m_sources)
+    {
+        {
+            std::lock_guard<std::mutex> lk(it.second->mutex);
+        }
+
+        it.second->cv.notify_all();
+    }
+
+    if (m_reader.joinable())
+    {
+        m_reqsem->release();
+        m_reader.join();
+    }
+
+    m_workers.waitForDone();
+}
+
+void HostedExtension::finish()
+{
+    stop();
+
+    if (m_initialized)
+    {
+        m_extension->shutdown(this);
+        m_initialized = false;
+    }
+
+    QCoreApplication::quit();
+}
+
+void HostedExtension::readRequests()
+{
+    QByteArray record;
+
+    while (true)
+    {
+        m_reqsem->acquire();
+
+        if (m_stopping)
+        {
+            return;
+        }
+
+        while (m_requests.read(record) == HostRing::READ_OK)
+        {
+            QCborArray req = QCborValue::fromCbor(record).toArray();
+
+            switch (req[0].toInteger())
+            {
+                case HOST_RECORD_GET:
+                {
+                    uint32_t seq = static_cast<uint32_t>(req[1].toInteger());
+                    size_t   uid = static_cast<size_t>(req[2].toInteger());
+
+                    m_workers.start(new GetDataTask([this, seq, uid] { serveGet(seq, uid); }));
+                    break;
+                }
+
+                case HOST_RECORD_PROCESSED:
+                {
+                    HostedSource* src = getSource(static_cast<size_t>(req[1].toInteger()));
+
+                    if (src)
+                    {
+                        {
+                            std::lock_guard<std::mutex> lk(src->mutex);
+                            src->processed = true;
+                        }
+
+                        src->cv.notify_one();
+                    }
+
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void HostedExtension::serveGet(uint32_t seq, size_t uid)
+{
+    HostedSource* src    = getSource(uid);
+    QCborValue    dat;
+    bool          ok     = false;
+    bool          served = false;
+
+    // Published values never call into the extension, as in Quasar
+    if (src && src->published)
+    {
+        std::lock_guard<std::mutex> lk(src->mutex);
+        served = ok = src->published->read(dat);
+    }
+
+    if (!served)
+    {
+        ok = m_extension->get_data(uid, &dat);
+    }
+
+    writeRecord(QCborArray{static_cast<int>(HOST_RECORD_REPLY), static_cast<qint64>(seq), ok, dat}, true);
+}
+
+bool HostedExtension::writeRecord(const QCborArray& record, bool wait)
+{
+    std::lock_guard<std::mutex> lk(m_replyMtx);
+
+    if (!m_replies.write(record.toCborValue().toCbor(), [this, wait] { return wait && !m_stopping; }))
+    {
+        return false;
+    }
+
+    m_repsem->release();
+
+    return true;
+}
+
+size_t HostedExtension::sourceUid(const char* source)
+{
+    auto it = m_uids.find(QString::fromUtf8(source));
+
+    if (it == m_uids.end())
+    {
+        qWarning() << "Unknown data source" << source << "in" << m_libpath;
+        return 0;
+    }
+
+    return it->second;
+}
+
+void HostedExtension::signalDataReady(size_t uid)
+{
+    if (getSource(uid))
+    {
+        writeRecord(QCborArray{static_cast<int>(HOST_RECORD_READY), static_cast<qint64>(uid)}, true);
+    }
+}
+
+void HostedExtension::waitDataProcessed(size_t uid)
+{
+    HostedSource* src = getSource(uid);
+
+    if (src && src->signaled)
+    {
+        std::unique_lock<std::mutex> lk(src->mutex);
+        src->cv.wait(lk, [this, src] { return src->processed || m_stopping; });
+        src->processed = false;
+    }
+}
+
+QCborValue* HostedExtension::publishBegin(size_t uid)
+{
+    HostedSource* src = getSource(uid);
+
+    return src && src->published ? src->published->writeBuffer() : nullptr;
+}
+
+void HostedExtension::publishCommit(size_t uid)
+{
+    HostedSource* src = getSource(uid);
+
+    if (src && src->published)
+    {
+        src->published->commit();
+    }
+}
+
+bool HostedExtension::pushConfigure(size_t uid, size_t capacity, quasar_push_overflow_t policy)
+{
+    HostedSource* src = getSource(uid);
+
+    if (!src || !src->push)
+    {
+        return false;
+    }
+
+    src->policy = policy;
+
+    return writeRecord(QCborArray{static_cast<int>(HOST_RECORD_PUSHCFG), static_cast<qint64>(uid), static_cast<qint64>(capacity), static_cast<int>(policy)}, true);
+}
+
+QCborValue* HostedExtension::pushBegin(size_t uid)
+{
+    HostedSource* src = getSource(uid);
+
+    return src && src->push ? &src->pushslot : nullptr;
+}
+
+bool HostedExtension::pushCommit(size_t uid)
+{
+    HostedSource* src = getSource(uid);
+
+    if (!src || !src->push)
+    {
+        return false;
+    }
+
+    // Only waiting sources hold the extension up while the reply ring is full
+    bool pushed = writeRecord(QCborArray{static_cast<int>(HOST_RECORD_PUSH), static_cast<qint64>(uid), src->pushslot}, src->policy == QUASAR_PUSH_WAIT);
+
+    src->pushslot = QCborValue();
+
+    return pushed;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QStringList args = a.arguments();
+
+    if (args.size() < 3)
+    {
+        qCritical() << "Usage:" << QUASAR_EXTHOST_NAME << "<extension library> <host key>";
+        return 1;
+    }
+
+    HostedExtension host(args[1], args[2]);
+
+    if (!host.open())
+    {
+        return 1;
+    }
+
+    _host           = &host;
+    _defaulthandler = qInstallMessageHandler(forwardMessage);
+
+    int ret = a.exec();
+
+    qInstallMessageHandler(_defaulthandler);
+    _host = nullptr;
+
+    return ret;
+}
@@ -0,0 +1,321 @@
+#include "dataclients.h"
+
+#include "dataserver.h"
+
+#include <QDebug>
+#include <QtEndian>
+#include <QtNetwork/QLocalSocket>
+#include <QtWebSockets/QWebSocket>
+
+namespace
+{
+    // opcode + length
+    constexpr int LOCAL_FRAME_HEADER_SIZE = 5;
+
+    // Reject anything larger than this from local clients
+    constexpr quint32 LOCAL_FRAME_MAX_PAYLOAD = 16 * 1024 * 1024;
+}
+
+WebSocketClient::WebSocketClient(QWebSocket* socket, QObject* parent) : DataClient(parent), m_socket(socket)
+{
+    m_socket->setParent(this);
+
+    connect(m_socket, &QWebSocket::textMessageReceived, this, &DataClient::textMessageReceived);
+    connect(m_socket, &QWebSocket::binaryMessageReceived, this, &DataClient::binaryMessageReceived);
+    connect(m_socket, &QWebSocket::disconnected, this, &DataClient::disconnected);
+    connect(m_socket, &QWebSocket::bytesWritten, this, &WebSocketClient::onBytesWritten);
+}
+
+void WebSocketClient::sendTextMessage(const QString& message)
+{
+    m_pending += m_socket->sendTextMessage(message);
+}
+
+void WebSocketClient::sendBinaryMessage(const QByteArray& message)
+{
+    m_pending += m_socket->sendBinaryMessage(message);
+}
+
+void WebSocketClient::close(const QString& reason)
+{
+    m_socket->close(QWebSocketProtocol::CloseCodeNormal, reason);
+}
+
+qint64 WebSocketClient::bytesToWrite() const
+{
+    return m_pending;
+}
+
+void WebSocketClient::onBytesWritten(qint64 bytes)
+{
+    // Written bytes include frame headers, so this can only reach zero early
+    m_pending = qMax<qint64>(0, m_pending - bytes);
+
+    drainOutbound();
+}
+
+LocalSocketClient::LocalSocketClient(QLocalSocket* socket, QObject* parent) : DataClient(parent), m_socket(socket)
+{
+    m_socket->setParent(this);
+
+    connect(m_socket, &QLocalSocket::readyRead, this, &LocalSocketClient::readFrames);
+    connect(m_socket, &QLocalSocket::disconnected, this, &DataClient::disconnected);
+    connect(m_socket, &QLocalSocket::bytesWritten, this, [this] { drainOutbound(); });
+}
+
+void LocalSocketClient::sendTextMessage(const QString& message)
+{
+    writeFrame(FRAME_TEXT, message.toUtf8());
+}
+
+void LocalSocketClient::sendBinaryMessage(const QByteArray& message)
+{
+    writeFrame(FRAME_BINARY, message);
+}
+
+void LocalSocketClient::close(const QString& reason)
+{
+    Q_UNUSED(reason);
+    m_socket->disconnectFromServer();
+}
+
+qint64 LocalSocketClient::bytesToWrite() const
+{
+    return m_socket->bytesToWrite();
+}
+
+void LocalSocketClient::readFrames()
+{
+    m_buffer.append(m_socket->readAll());
+
+    while (m_buffer.size() >= LOCAL_FRAME_HEADER_SIZE)
+    {
+        quint8  opcode = static_cast<quint8>(m_buffer.at(0));
+        quint32 length = qFromLittleEndian<quint32>(m_buffer.constData() + 1);
+
+        if ((opcode != FRAME_TEXT && opcode != FRAME_BINARY) || length > LOCAL_FRAME_MAX_PAYLOAD)
+        {
+            qWarning() << "Invalid frame received on local socket, disconnecting";
+            m_buffer.clear();
+            m_socket->abort();
+            return;
+        }
+
+        if (static_cast<quint32>(m_buffer.size() - LOCAL_FRAME_HEADER_SIZE) < length)
+        {
+            // Wait for the rest of the frame
+            return;
+        }
+
+        QByteArray payload = m_buffer.mid(LOCAL_FRAME_HEADER_SIZE, length);
+        m_buffer.remove(0, LOCAL_FRAME_HEADER_SIZE + length);
+
+        if (opcode == FRAME_TEXT)
+        {
+            emit utf8MessageReceived(payload);
+        }
+        else
+        {
+            emit binaryMessageReceived(payload);
+        }
+    }
+}
+
+void LocalSocketClient::writeFrame(FrameOpcode opcode, const QByteArray& payload)
+{
+    char header[LOCAL_FRAME_HEADER_SIZE];
+    header[0] = static_cast<char>(opcode);
+    qToLittleEndian<quint32>(payload.size(), header + 1);
+
+    m_socket->write(header, LOCAL_FRAME_HEADER_SIZE);
+    m_socket->write(payload);
+}
+
+WebChannelClient::WebChannelClient(QObject* parent) : DataClient(parent) {}
+
+void WebChannelClient::sendTextMessage(const QString& message)
+{
+    if (!m_closed)
+    {
+        m_pending += message.size();
+        emit pageTextMessage(message);
+    }
+}
+
+void WebChannelClient::sendBinaryMessage(const QByteArray& message)
+{
+    if (!m_closed)
+    {
+        QString base64 = QString::fromLatin1(message.toBase64());
+
+        m_pending += base64.size();
+        emit pageBinaryMessage(base64);
+    }
+}
+
+void WebChannelClient::close(const QString& reason)
+{
+    if (m_closed)
+    {
+        return;
+    }
+
+    emit pageClosed(reason);
+
+    m_closed = true;
+
+    emit disconnected();
+}
+
+qint64 WebChannelClient::bytesToWrite() const
+{
+    return m_pending;
+}
+
+void WebChannelClient::acknowledge(qint64 bytes)
+{
+    m_pending -= bytes;
+    drainOutbound();
+}
+
+void WebChannelClient::receive(const QString& message)
+{
+    if (!m_closed)
+    {
+        emit textMessageReceived(message);
+    }
+}
+
+WebChannelTransport::WebChannelTransport(DataServer* server, QObject* parent) : QObject(parent), m_server(server) {}
+
+WebChannelTransport::~WebChannelTransport()
+{
+    closeClient("Page destroyed");
+}
+
+void WebChannelTransport::open()
+{
+    closeClient("Reconnecting");
+
+    if (!m_server)
+    {
+        qWarning() << "Web channel transport opened without a Data Server";
+        return;
+    }
+
+    WebChannelClient* client = new WebChannelClient();
+    quint64           serial = ++m_serial;
+
+    // Queued, as the client is moved to the Data Server thread
+    //
+    // Every message is acknowledged once handled, so that the client's outbound limits see
+    // the messages still waiting in this thread's event queue
+    QPointer<WebChannelClient> guard(client);
+
+    m_connections << connect(client, &WebChannelClient::pageTextMessage, this, [this, serial, guard](const QString& message) {
+        if (serial == m_serial)
+        {
+            emit textMessage(message);
+        }
+
+        acknowledge(guard, message.size());
+    });
+    m_connections << connect(client, &WebChannelClient::pageBinaryMessage, this, [this, serial, guard](const QString& base64) {
+        if (serial == m_serial)
+        {
+            emit binaryMessage(base64);
+        }
+
+        acknowledge(guard, base64.size());
+    });
+    m_connections << connect(client, &WebChannelClient::pageClosed, this, [this, serial](const QString& reason) {
+        if (serial == m_serial)
+        {
+            emit closed(reason);
+        }
+    });
+
+    client->moveToThread(m_server->thread());
+    m_client = client;
+
+    // Owned by the Data Server like socket clients, and deleted once disconnected
+    DataServer* server = m_server;
+    QMetaObject::invokeMethod(
+        m_server,
+        [server, client] {
+            client->setParent(server);
+            server->acceptClient(client);
+        },
+        Qt::QueuedConnection);
+}
+
+void WebChannelTransport::send(const QString& message)
+{
+    // m_client itself is only checked on the Data Server thread, where the client is deleted
+    if (m_connections.isEmpty() || !m_server)
+    {
+        qWarning() << "Message received on closed web channel transport";
+        return;
+    }
+
+    // The client is only ever touched on the Data Server thread, where it is also deleted
+    QMetaObject::invokeMethod(
+        m_server,
+        [client = m_client, message] {
+            if (client)
+            {
+                client->receive(message);
+            }
+        },
+        Qt::QueuedConnection);
+}
+
+void WebChannelTransport::acknowledge(const QPointer<WebChannelClient>& client, qint64 bytes)
+{
+    if (!m_server)
+    {
+        return;
+    }
+
+    QMetaObject::invokeMethod(
+        m_server,
+        [client, bytes] {
+            if (client)
+            {
+                client->acknowledge(bytes);
+            }
+        },
+        Qt::QueuedConnection);
+}
+
+void WebChannelTransport::close()
+{
+    closeClient("Closed by page");
+}
+
+void WebChannelTransport::closeClient(const QString& reason)
+{
+    for (const auto& c : m_connections)
+    {
+        disconnect(c);
+    }
+
+    m_connections.clear();
+    m_serial++;
+
+    // The server deletes its clients along with itself
+    if (m_server)
+    {
+        QMetaObject::invokeMethod(
+            m_server,
+            [client = m_client, reason] {
+                if (client)
+                {
+                    client->close(reason);
+                }
+            },
+            Qt::QueuedConnection);
+    }
+
+    m_client.clear();
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <dataclient.h>
+
+#include <QPointer>
+
+QT_FORWARD_DECLARE_CLASS(QWebSocket)
+QT_FORWARD_DECLARE_CLASS(QLocalSocket)
+
+class DataServer;
+class WebChannelTransport;
+
+// Client connected through the WebSocket server
+class WebSocketClient : public DataClient
+{
+    Q_OBJECT
+
+public:
+    // Takes ownership of the socket
+    explicit WebSocketClient(QWebSocket* socket, QObject* parent = nullptr);
+
+    void sendTextMessage(const QString& message) override;
+    void sendBinaryMessage(const QByteArray& message) override;
+    void close(const QString& reason) override;
+
+    // QWebSocket does not expose its write buffer, so sent bytes are tracked here
+    qint64 bytesToWrite() const override;
+
+private slots:
+    void onBytesWritten(qint64 bytes);
+
+private:
+    QWebSocket* m_socket;
+    qint64      m_pending = 0;
+};
+
+// Client connected through the local socket server
+//
+// Messages are framed as a 1 byte opcode (1 for text, 2 for binary, as in WebSocket),
+// followed by the payload length as a 32-bit little endian integer and the payload
+class LocalSocketClient : public DataClient
+{
+    Q_OBJECT
+
+public:
+    enum FrameOpcode : quint8
+    {
+        FRAME_TEXT   = 0x1,
+        FRAME_BINARY = 0x2
+    };
+
+    // Takes ownership of the socket
+    explicit LocalSocketClient(QLocalSocket* socket, QObject* parent = nullptr);
+
+    void sendTextMessage(const QString& message) override;
+    void sendBinaryMessage(const QByteArray& message) override;
+    void close(const QString& reason) override;
+
+    qint64 bytesToWrite() const override;
+
+private slots:
+    void readFrames();
+
+private:
+    void writeFrame(FrameOpcode opcode, const QByteArray& payload);
+
+    QLocalSocket* m_socket;
+    QByteArray    m_buffer;
+};
+
+// Client hosted in one of our own web pages, connected through the page's QWebChannel
+//
+// Messages are passed over WebEngine IPC instead of a socket. Binary messages are
+// sent base64 encoded, as QWebChannel only carries JSON values.
+//
+// The client lives on the Data Server thread like every other client, and only talks
+// to its WebChannelTransport on the GUI thread through queued signals.
+class WebChannelClient : public DataClient
+{
+    Q_OBJECT
+
+public:
+    explicit WebChannelClient(QObject* parent = nullptr);
+
+    void sendTextMessage(const QString& message) override;
+    void sendBinaryMessage(const QByteArray& message) override;
+    void close(const QString& reason) override;
+
+    // Counts messages emitted to the transport that it has not passed on to the page yet
+    qint64 bytesToWrite() const override;
+
+    // Passes a message received from the page to the Data Server
+    void receive(const QString& message);
+
+    // Called by the transport once it passed a message of the given size on to the page
+    void acknowledge(qint64 bytes);
+
+signals:
+    void pageTextMessage(const QString& message);
+    void pageBinaryMessage(const QString& base64);
+    void pageClosed(const QString& reason);
+
+private:
+    bool   m_closed  = false;
+    qint64 m_pending = 0;
+};
+
+// Object registered on a page's QWebChannel as "quasar"
+//
+// Each call to open() from the page starts a new WebChannelClient, which then goes
+// through the same authentication as any other client. The current client is closed
+// whenever the page navigates away or is destroyed.
+class WebChannelTransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WebChannelTransport(DataServer* server, QObject* parent = nullptr);
+    ~WebChannelTransport();
+
+    Q_INVOKABLE void open();
+    Q_INVOKABLE void send(const QString& message);
+    Q_INVOKABLE void close();
+
+signals:
+    void textMessage(const QString& message);
+    void binaryMessage(const QString& base64);
+    void closed(const QString& reason);
+
+private:
+    // Closes the current client without telling the page
+    void closeClient(const QString& reason);
+
+    // Tells a client that a message it sent reached the page
+    void acknowledge(const QPointer<WebChannelClient>& client, qint64 bytes);
+
+    QPointer<DataServer>           m_server; // cleared if the server goes away before the page, e.g. at shutdown
+    QPointer<WebChannelClient>     m_client;
+    quint64                        m_serial = 0; // Identifies the current client, so that late messages from older ones are ignored
+    QList<QMetaObject::Connection> m_connections;
+};
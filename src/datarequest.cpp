@@ -0,0 +1,417 @@
+#include "datarequest.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <cstring>
+
+namespace
+{
+    // Scans requests following the fixed schema directly from UTF-8 data
+    //
+    // Every parse function returns false as soon as the input leaves the fixed
+    // schema, in which case the caller falls back to QJsonDocument.
+    class RequestScanner
+    {
+    public:
+        RequestScanner(const char* begin, const char* end) : m_p(begin), m_end(end) {}
+
+        bool atEnd() const { return m_p == m_end; }
+
+        void skipWhitespace()
+        {
+            while (m_p != m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+            {
+                ++m_p;
+            }
+        }
+
+        bool consume(char c)
+        {
+            skipWhitespace();
+
+            if (m_p != m_end && *m_p == c)
+            {
+                ++m_p;
+                return true;
+            }
+
+            return false;
+        }
+
+        bool parseRequest(DataRequest& req)
+        {
+            if (!consume('{'))
+            {
+                return false;
+            }
+
+            if (consume('}'))
+            {
+                // Empty requests are invalid but well formed
+                return true;
+            }
+
+            bool hasMethod = false;
+            bool hasParams = false;
+
+            do
+            {
+                const char* key;
+                int         keylen;
+
+                if (!parseKey(key, keylen))
+                {
+                    return false;
+                }
+
+                if (keyIs(key, keylen, "method") && !hasMethod)
+                {
+                    if (!parseString(req.method))
+                    {
+                        return false;
+                    }
+
+                    hasMethod = true;
+                }
+                else if (keyIs(key, keylen, "params") && !hasParams)
+                {
+                    if (!parseParams(req))
+                    {
+                        return false;
+                    }
+
+                    hasParams = true;
+                }
+                else
+                {
+                    return false;
+                }
+            } while (consume(','));
+
+            req.valid = true;
+
+            return consume('}');
+        }
+
+    private:
+        template <int N>
+        static bool keyIs(const char* key, int len, const char (&name)[N])
+        {
+            return len == N - 1 && std::memcmp(key, name, N - 1) == 0;
+        }
+
+        bool parseRawString(const char*& str, int& len)
+        {
+            if (!consume('"'))
+            {
+                return false;
+            }
+
+            const char* start = m_p;
+
+            while (m_p != m_end && *m_p != '"')
+            {
+                // Escapes and control characters are left to QJsonDocument
+                if (*m_p == '\\' || static_cast<unsigned char>(*m_p) < 0x20)
+                {
+                    return false;
+                }
+
+                ++m_p;
+            }
+
+            if (m_p == m_end)
+            {
+                return false;
+            }
+
+            str = start;
+            len = int(m_p - start);
+            ++m_p;
+
+            return true;
+        }
+
+        bool parseKey(const char*& key, int& len) { return parseRawString(key, len) && consume(':'); }
+
+        bool parseString(QString& out)
+        {
+            const char* str;
+            int         len;
+
+            if (!parseRawString(str, len))
+            {
+                return false;
+            }
+
+            out = QString::fromUtf8(str, len);
+            return true;
+        }
+
+        bool parseBool(bool& out)
+        {
+            skipWhitespace();
+
+            const auto remaining = m_end - m_p;
+
+            if (remaining >= 4 && std::memcmp(m_p, "true", 4) == 0)
+            {
+                m_p += 4;
+                out = true;
+                return true;
+            }
+
+            if (remaining >= 5 && std::memcmp(m_p, "false", 5) == 0)
+            {
+                m_p += 5;
+                out = false;
+                return true;
+            }
+
+            return false;
+        }
+
+        bool parseInteger(qint64& out)
+        {
+            skipWhitespace();
+
+            const char* start = m_p;
+            qint64      val   = 0;
+
+            // Only plain non-negative integers, anything else is left to QJsonDocument
+            while (m_p != m_end && *m_p >= '0' && *m_p <= '9' && m_p - start < 15)
+            {
+                val = val * 10 + (*m_p - '0');
+                ++m_p;
+            }
+
+            if (m_p == start || (m_p != m_end && (*m_p == '.' || *m_p == 'e' || *m_p == 'E' || (*m_p >= '0' && *m_p <= '9'))))
+            {
+                return false;
+            }
+
+            out = val;
+            return true;
+        }
+
+        bool parseParam(DataRequest& req, DataRequest::ParamFlags flag, QString& out)
+        {
+            if (req.hasParam(flag) || !parseString(out))
+            {
+                return false;
+            }
+
+            req.paramflags |= flag;
+            return true;
+        }
+
+        bool parseParams(DataRequest& req)
+        {
+            if (!consume('{'))
+            {
+                return false;
+            }
+
+            if (consume('}'))
+            {
+                return true;
+            }
+
+            do
+            {
+                const char* key;
+                int         keylen;
+
+                if (!parseKey(key, keylen))
+                {
+                    return false;
+                }
+
+                bool ok = false;
+
+                if (keyIs(key, keylen, "target"))
+                {
+                    ok = parseParam(req, DataRequest::PARAM_TARGET, req.target);
+                }
+                else if (keyIs(key, keylen, "params"))
+                {
+                    ok       = parseParam(req, DataRequest::PARAM_PARAMS, req.params);
+                    req.data = req.params;
+                }
+                else if (keyIs(key, keylen, "code"))
+                {
+                    ok = parseParam(req, DataRequest::PARAM_CODE, req.code);
+                }
+                else if (keyIs(key, keylen, "encoding"))
+                {
+                    ok = parseParam(req, DataRequest::PARAM_ENCODING, req.encoding);
+                }
+                else if (keyIs(key, keylen, "delta") && !req.hasParam(DataRequest::PARAM_DELTA))
+                {
+                    ok = parseBool(req.delta);
+                    req.paramflags |= DataRequest::PARAM_DELTA;
+                }
+                else if (keyIs(key, keylen, "rate") && !req.hasParam(DataRequest::PARAM_RATE))
+                {
+                    ok = parseInteger(req.rate);
+                    req.paramflags |= DataRequest::PARAM_RATE;
+                }
+
+                if (!ok)
+                {
+                    return false;
+                }
+
+                req.paramcount++;
+            } while (consume(','));
+
+            return consume('}');
+        }
+
+        const char* m_p;
+        const char* m_end;
+    };
+}
+
+DataRequest DataRequest::fromJson(const QJsonObject& obj)
+{
+    DataRequest req;
+
+    req.valid  = !obj.isEmpty();
+    req.method = obj["method"].toString();
+
+    auto parms = obj["params"].toObject();
+
+    req.paramcount = parms.count();
+
+    for (auto it = parms.begin(); it != parms.end(); ++it)
+    {
+        const QString& key = it.key();
+
+        if (key == QLatin1String("target"))
+        {
+            req.target = it.value().toString();
+            req.paramflags |= PARAM_TARGET;
+        }
+        else if (key == QLatin1String("params"))
+        {
+            req.params = it.value().toString();
+            req.data   = it.value();
+            req.paramflags |= PARAM_PARAMS;
+        }
+        else if (key == QLatin1String("code"))
+        {
+            req.code = it.value().toString();
+            req.paramflags |= PARAM_CODE;
+        }
+        else if (key == QLatin1String("encoding"))
+        {
+            req.encoding = it.value().toString(QStringLiteral("json"));
+            req.paramflags |= PARAM_ENCODING;
+        }
+        else if (key == QLatin1String("delta"))
+        {
+            req.delta = it.value().toBool();
+            req.paramflags |= PARAM_DELTA;
+        }
+        else if (key == QLatin1String("rate"))
+        {
+            req.rate = static_cast<qint64>(it.value().toDouble());
+            req.paramflags |= PARAM_RATE;
+        }
+    }
+
+    return req;
+}
+
+bool parseDataRequests(const QByteArray& utf8, DataRequestList& reqs, bool& batch)
+{
+    RequestScanner scanner(utf8.constData(), utf8.constData() + utf8.size());
+
+    reqs.clear();
+    batch = scanner.consume('[');
+
+    bool fast = true;
+
+    if (batch)
+    {
+        if (!scanner.consume(']'))
+        {
+            do
+            {
+                reqs.emplace_back();
+                fast = scanner.parseRequest(reqs.back());
+            } while (fast && scanner.consume(','));
+
+            fast = fast && scanner.consume(']');
+        }
+    }
+    else
+    {
+        reqs.emplace_back();
+        fast = scanner.parseRequest(reqs.back());
+    }
+
+    scanner.skipWhitespace();
+
+    if (fast && scanner.atEnd())
+    {
+        return true;
+    }
+
+    // Outside of the fixed schema, go through the DOM
+    reqs.clear();
+
+    QJsonDocument doc = QJsonDocument::fromJson(utf8);
+
+    if (doc.isNull())
+    {
+        return false;
+    }
+
+    batch = doc.isArray();
+
+    if (batch)
+    {
+        const QJsonArray arr = doc.array();
+
+        reqs.reserve(arr.size());
+
+        for (const auto& v : arr)
+        {
+            reqs.push_back(DataRequest::fromJson(v.toObject()));
+        }
+    }
+    else
+    {
+        reqs.push_back(DataRequest::fromJson(doc.object()));
+    }
+
+    return true;
+}
+
+bool isJsonRequestData(const QByteArray& data)
+{
+    for (char c : data)
+    {
+        switch (c)
+        {
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                continue;
+
+            case '{':
+            case '[':
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonValue>
+#include <QString>
+
+#include <vector>
+
+QT_FORWARD_DECLARE_CLASS(QJsonObject)
+
+// A client request to the Data Server
+//
+// Requests follow a fixed schema: {"method": m, "params": {"target": t, "params": p, ...}}.
+// Every parameter the Data Server understands has its own field so that handlers
+// never need to look anything up in a JSON DOM.
+struct DataRequest
+{
+    enum ParamFlags : uint8_t
+    {
+        PARAM_TARGET   = 0x01,
+        PARAM_PARAMS   = 0x02,
+        PARAM_CODE     = 0x04,
+        PARAM_ENCODING = 0x08,
+        PARAM_DELTA    = 0x10,
+        PARAM_RATE     = 0x20
+    };
+
+    bool       valid = false; // false if the request is not a JSON object or is empty
+    QString    method;
+    QString    target;
+    QString    params; // target params if sent as a string
+    QJsonValue data;   // target params as sent, for targets that take more than a string (e.g. mutate)
+    QString    code;
+    QString    encoding;
+    bool       delta      = false;
+    qint64     rate       = 0;
+    uint8_t    paramflags = 0; // ParamFlags present in params
+    int        paramcount = 0; // number of fields in params, including unknown ones
+
+    bool hasParam(ParamFlags flag) const { return (paramflags & flag) != 0; }
+
+    // Builds a request from a parsed JSON object
+    static DataRequest fromJson(const QJsonObject& obj);
+};
+
+using DataRequestList = std::vector<DataRequest>;
+
+// Parses a UTF-8 encoded JSON request or request batch straight from the frame data
+//
+// Handles the fixed request schema without building a JSON DOM. Requests that fall
+// outside of it (escaped strings, unknown fields, non-string target params) fall back
+// to QJsonDocument, so every valid request parses either way.
+//
+// Returns false if the data is not valid JSON, otherwise fills reqs and sets batch
+// if the data was an array of requests.
+bool parseDataRequests(const QByteArray& utf8, DataRequestList& reqs, bool& batch);
+
+// Checks whether a binary frame holds UTF-8 JSON rather than CBOR
+//
+// A CBOR request is always a map or an array, which can never start with
+// the bytes a JSON object or array starts with.
+bool isJsonRequestData(const QByteArray& data);
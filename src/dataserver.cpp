@@ -1,24 +1,38 @@
 #include "dataserver.h"
 
+#include "dataclients.h"
 #include "dataextension.h"
+#include "datascheduler.h"
+#include "derivedsources.h"
 #include "extension_support_internal.h"
 #include "widgetdefs.h"
 
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
+#include <QDateTime>
 #include <QDesktopServices>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QPointer>
 #include <QProcess>
 #include <QRandomGenerator>
 #include <QSettings>
 #include <QStandardPaths>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtNetwork/QLocalServer>
 #include <QtNetwork/QSslCertificate>
 #include <QtNetwork/QSslKey>
-#include <QtWebSockets/QWebSocket>
 #include <QtWebSockets/QWebSocketServer>
 #include <QtWidgets/QApplication>
 
+#include <algorithm>
 #include <unordered_set>
 
 #define DS_SEND_WARN(c, m)   \
@@ -28,39 +42,125 @@
 
 using namespace std::placeholders;
 
+namespace
+{
+    // Reads the manifest shipped next to an extension library, if any
+    QJsonObject readExtensionManifest(const QFileInfo& lib)
+    {
+        QFile manifest(lib.path() + "/" + lib.completeBaseName() + ".json");
+
+        if (!manifest.open(QIODevice::ReadOnly))
+        {
+            return QJsonObject();
+        }
+
+        return QJsonDocument::fromJson(manifest.readAll()).object();
+    }
+
+    // Identifies the exact build of an extension library that a cached identifier belongs to
+    QVariantMap extensionCacheEntry(const QFileInfo& lib, const QString& extcode)
+    {
+        return QVariantMap{{"name", extcode}, {"modified", lib.lastModified().toMSecsSinceEpoch()}, {"size", lib.size()}};
+    }
+
+    // Loads an extension on a worker pool
+    class ExtensionLoadTask : public QRunnable
+    {
+    public:
+        explicit ExtensionLoadTask(std::function<void()> fn) : m_fn(std::move(fn)) {}
+
+        void run() override { m_fn(); }
+
+    private:
+        std::function<void()> m_fn;
+    };
+
+    // Collects the results of a query spanning several extensions so that they are sent in a single message
+    struct MultiQuery
+    {
+        QPointer<DataClient> client;        // cleared if the client disconnects before every extension returned
+        DataEncoding         encoding;
+        QCborMap             data;          // data by extension, then by source
+        QCborArray           errs;
+        size_t               remaining = 0; // number of extensions still being polled
+    };
+
+    void sendMultiQueryReply(MultiQuery& query)
+    {
+        if (!query.client)
+        {
+            return;
+        }
+
+        QCborMap msg;
+
+        if (!query.data.isEmpty())
+        {
+            msg[QStringLiteral("data")] = query.data;
+        }
+
+        if (!query.errs.isEmpty())
+        {
+            msg[QStringLiteral("errors")] = query.errs.size() == 1 ? query.errs.at(0) : QCborValue(query.errs);
+        }
+
+        if (!msg.isEmpty())
+        {
+            DataFrame(msg).sendTo(query.client, query.encoding);
+        }
+    }
+}
+
 DataServer::DataServer(QObject* parent) :
     QObject(parent),
     m_pWebSocketServer(nullptr),
+    m_pLocalServer(nullptr),
+    m_pScheduler(new DataScheduler(this)),
     m_Methods{{"subscribe", std::bind(&DataServer::handleMethodSubscribe, this, _1, _2)},
+              {"unsubscribe", std::bind(&DataServer::handleMethodUnsubscribe, this, _1, _2)},
               {"query", std::bind(&DataServer::handleMethodQuery, this, _1, _2)},
               {"auth", std::bind(&DataServer::handleMethodAuth, this, _1, _2)},
               {"mutate", std::bind(&DataServer::handleMethodMutate, this, _1, _2)}},
-    m_InternalQueryTargets{{"settings", std::bind(&DataServer::handleQuerySettings, this, _1, _2, _3)},
-                           {"launcher", std::bind(&DataServer::handleQueryLauncher, this, _1, _2, _3)}},
-    m_MutateTargets{{"settings", std::bind(&DataServer::handleMutateSettings, this, _1, _2)}}
+    m_InternalQueryTargets{{"settings", std::bind(&DataServer::handleQuerySettings, this, _1, _2)},
+                           {"launcher", std::bind(&DataServer::handleQueryLauncher, this, _1, _2)},
+                           {"stats", std::bind(&DataServer::handleQueryStats, this, _1, _2)}},
+    m_MutateTargets{{"settings", std::bind(&DataServer::handleMutateSettings, this, _1, _2)}},
+    m_pLoadPool(new QThreadPool(this)),
+    m_pDerived(std::make_unique<DerivedSources>(std::bind(&DataServer::resolveExtension, this, _1, _2)))
 {
     qRegisterMetaType<AppLauncherData>("AppLauncherData");
     qRegisterMetaTypeStreamOperators<AppLauncherData>("AppLauncherData");
 
-    m_pWebSocketServer = new QWebSocketServer(QStringLiteral("Data Server"), QWebSocketServer::SecureMode, this);
-
-    QSslConfiguration sslConfiguration;
-    QFile             certFile(QStringLiteral(":/Resources/localhost.crt"));
-    QFile             keyFile(QStringLiteral(":/Resources/localhost.key"));
-    certFile.open(QIODevice::ReadOnly);
-    keyFile.open(QIODevice::ReadOnly);
-    QSslCertificate certificate(&certFile, QSsl::Pem);
-    QSslKey         sslKey(&keyFile, QSsl::Rsa, QSsl::Pem);
-    certFile.close();
-    keyFile.close();
-    sslConfiguration.setPeerVerifyMode(QSslSocket::VerifyNone);
-    sslConfiguration.setLocalCertificate(certificate);
-    sslConfiguration.setPrivateKey(sslKey);
-    sslConfiguration.setProtocol(QSsl::TlsV1SslV3);
-    m_pWebSocketServer->setSslConfiguration(sslConfiguration);
+    // A single timer expires auth codes and cuts connections that never authenticated
+    m_pAuthSweeper = new QTimer(this);
+    m_pAuthSweeper->setSingleShot(true);
+
+    connect(m_pAuthSweeper, &QTimer::timeout, this, &DataServer::sweepAuth);
 
     QSettings settings;
-    quint16   port = settings.value(QUASAR_CONFIG_PORT, QUASAR_DATA_SERVER_DEFAULT_PORT).toUInt();
+    quint16   port   = settings.value(QUASAR_CONFIG_PORT, QUASAR_DATA_SERVER_DEFAULT_PORT).toUInt();
+    bool      secure = settings.value(QUASAR_CONFIG_SECURE, true).toBool();
+
+    m_pWebSocketServer =
+        new QWebSocketServer(QStringLiteral("Data Server"), secure ? QWebSocketServer::SecureMode : QWebSocketServer::NonSecureMode, this);
+
+    if (secure)
+    {
+        QSslConfiguration sslConfiguration;
+        QFile             certFile(QStringLiteral(":/Resources/localhost.crt"));
+        QFile             keyFile(QStringLiteral(":/Resources/localhost.key"));
+        certFile.open(QIODevice::ReadOnly);
+        keyFile.open(QIODevice::ReadOnly);
+        QSslCertificate certificate(&certFile, QSsl::Pem);
+        QSslKey         sslKey(&keyFile, QSsl::Rsa, QSsl::Pem);
+        certFile.close();
+        keyFile.close();
+        sslConfiguration.setPeerVerifyMode(QSslSocket::VerifyNone);
+        sslConfiguration.setLocalCertificate(certificate);
+        sslConfiguration.setPrivateKey(sslKey);
+        sslConfiguration.setProtocol(QSsl::TlsV1SslV3);
+        m_pWebSocketServer->setSslConfiguration(sslConfiguration);
+    }
 
     if (!m_pWebSocketServer->listen(QHostAddress::LocalHost, port))
     {
@@ -68,10 +168,30 @@ DataServer::DataServer(QObject* parent) :
     }
     else
     {
-        qInfo() << "Data server running locally on port" << port;
+        qInfo() << "Data server running locally on port" << port << (secure ? "(wss)" : "(ws)");
         connect(m_pWebSocketServer, &QWebSocketServer::newConnection, this, &DataServer::onNewConnection);
 
-        loadExtensions();
+        scanExtensions();
+        loadDerivedSources();
+    }
+
+    if (settings.value(QUASAR_CONFIG_LOCALSOCKET, false).toBool())
+    {
+        m_pLocalServer = new QLocalServer(this);
+        m_pLocalServer->setSocketOptions(QLocalServer::UserAccessOption);
+
+        // Clean up after a previous instance that did not exit cleanly
+        QLocalServer::removeServer(QUASAR_DATA_SERVER_LOCAL_NAME);
+
+        if (!m_pLocalServer->listen(QUASAR_DATA_SERVER_LOCAL_NAME))
+        {
+            qWarning() << "Data server failed to listen on local socket" << QUASAR_DATA_SERVER_LOCAL_NAME << ":" << m_pLocalServer->errorString();
+        }
+        else
+        {
+            qInfo() << "Data server listening on local socket" << m_pLocalServer->fullServerName();
+            connect(m_pLocalServer, &QLocalServer::newConnection, this, &DataServer::onNewLocalConnection);
+        }
     }
 
     m_LauncherMap = settings.value(QUASAR_CONFIG_LAUNCHERMAP).toMap();
@@ -80,21 +200,29 @@ DataServer::DataServer(QObject* parent) :
 
 DataServer::~DataServer()
 {
+    // Loads still running need the scheduler, their completions are dropped along with the server
+    m_pLoadPool->waitForDone();
+
     m_Methods.clear();
 
     m_Extensions.clear();
 
-    m_AuthedClientsSet.clear();
+    m_Sessions.clear();
 
     m_AuthCodeMap.clear();
 
     m_pWebSocketServer->close();
+
+    if (m_pLocalServer)
+    {
+        m_pLocalServer->close();
+    }
 }
 
 bool DataServer::findExtension(QString extcode)
 {
     std::shared_lock<std::shared_mutex> lk(m_ExtensionsMtx);
-    return (m_Extensions.count(extcode) > 0);
+    return (m_Extensions.count(extcode) > 0 || m_ExtensionLibs.count(extcode) > 0 || m_LoadingExtensions.count(extcode) > 0);
 }
 
 QString DataServer::generateAuthCode(QString ident, ClientAccessLevel lvl)
@@ -103,15 +231,29 @@ QString DataServer::generateAuthCode(QString ident, ClientAccessLevel lvl)
     quint64 l  = QRandomGenerator::global()->generate64();
     QString hv = QString::number(h, 16).toUpper() + QString::number(l, 16).toUpper();
 
-    client_data_t cdt = {ident, lvl, system_clock::now() + 10s};
+    const auto    expiry = steady_clock::now() + milliseconds(QUASAR_AUTH_TIMEOUT);
+    client_data_t cdt    = {ident, lvl, expiry};
 
-    std::unique_lock<std::mutex> lk(m_AuthCodeMtx);
-    m_AuthCodeMap.insert({hv, cdt});
+    bool arm;
+
+    {
+        std::unique_lock<std::mutex> lk(m_AuthCodeMtx);
+        m_AuthCodeMap.insert({hv, cdt});
+
+        arm = m_AuthCodeExpiry.empty();
+        m_AuthCodeExpiry.emplace_back(expiry, hv);
+    }
+
+    if (arm)
+    {
+        // Codes are handed out on the GUI thread, while the sweeper belongs to this one
+        QMetaObject::invokeMethod(this, [this] { armAuthSweeper(); }, Qt::QueuedConnection);
+    }
 
     return hv;
 }
 
-void DataServer::loadExtensions()
+void DataServer::scanExtensions()
 {
     QDir          dir("extensions/");
     QFileInfoList list = dir.entryInfoList(QStringList() << "*.dll"
@@ -125,102 +267,432 @@ void DataServer::loadExtensions()
         return;
     }
 
-    // just lock the whole thing while initializing extensions at startup
-    // to prevent out of order reads
+    QSettings   settings;
+    QVariantMap cache = settings.value(QUASAR_CONFIG_EXTCACHE).toMap();
+    QVariantMap found;
+
+    ExtensionLibList unknown;
+
+    {
+        std::unique_lock<std::shared_mutex> lk(m_ExtensionsMtx);
+
+        // Extensions isolated by the user, on top of those whose manifest asks for it
+        for (const QString& extcode : settings.value(QUASAR_CONFIG_EXTISOLATED).toStringList())
+        {
+            m_IsolatedExtensions.insert(extcode);
+        }
+
+        for (QFileInfo& file : list)
+        {
+            QString     libpath  = file.path() + "/" + file.fileName();
+            QJsonObject manifest = readExtensionManifest(file);
+            QString     extcode  = manifest.value("name").toString();
+
+            if (!extcode.isEmpty() && manifest.value("isolated").toBool())
+            {
+                m_IsolatedExtensions.insert(extcode);
+            }
+
+            if (extcode.isEmpty())
+            {
+                // Identifiers learned on a previous run only hold for the same build of the library
+                auto entry = cache.value(file.fileName()).toMap();
+
+                if (entry.value("modified").toLongLong() == file.lastModified().toMSecsSinceEpoch() && entry.value("size").toLongLong() == file.size())
+                {
+                    extcode = entry.value("name").toString();
+                }
+            }
+
+            if (extcode.isEmpty())
+            {
+                // Nothing is known about this library yet, so loading it is the only way to identify it
+                unknown.emplace_back(libpath, QString());
+                continue;
+            }
+
+            if (m_InternalQueryTargets.count(extcode))
+            {
+                qWarning() << "The extension code" << extcode << " is reserved. Skipping " << libpath;
+            }
+            else if (m_ExtensionLibs.count(extcode))
+            {
+                qWarning() << "Extension with code " << extcode << " already found. Skipping" << libpath;
+            }
+            else
+            {
+                qInfo() << "Extension " << extcode << " found in" << libpath << ", loading on first use";
+                m_ExtensionLibs[extcode] = libpath;
+                found[file.fileName()]   = extensionCacheEntry(file, extcode);
+            }
+        }
+    }
+
+    // Unidentified libraries are loaded without the lock held, like lazily loaded ones
+    for (DataExtension* extn : loadExtensions(unknown))
+    {
+        if (extn)
+        {
+            QFileInfo file(extn->getLibPath());
+            found[file.fileName()] = extensionCacheEntry(file, extn->getName());
+        }
+    }
+
+    // Also drops libraries that are gone
+    settings.setValue(QUASAR_CONFIG_EXTCACHE, found);
+}
+
+void DataServer::loadDerivedSources()
+{
+    // Derived sources only load their inputs once they are used, so they are served right away.
+    // Inputs from extensions that are missing are reported when polled
+    if (m_pDerived->load(QUASAR_DERIVED_SOURCES_FILE))
+    {
+        std::unique_lock<std::shared_mutex> lk(m_ExtensionsMtx);
+        addExtension(DataExtension::loadBuiltin(m_pDerived->info(), m_pDerived.get(), m_pScheduler), QString());
+    }
+}
+
+std::vector<DataExtension*> DataServer::loadExtensions(const ExtensionLibList& libs)
+{
+    std::vector<DataExtension*> loaded(libs.size(), nullptr);
+
+    if (libs.empty())
+    {
+        return loaded;
+    }
+
+    // Extensions may spend a while in init(), e.g. enumerating devices, so initialize them all at once
+    QThreadPool pool;
+    pool.setMaxThreadCount(qBound(1, static_cast<int>(libs.size()), QThread::idealThreadCount()));
+
+    std::vector<bool> isolation(libs.size());
+
+    {
+        // Only known extensions can be isolated, the others are identified by loading them
+        std::shared_lock<std::shared_mutex> lk(m_ExtensionsMtx);
+
+        for (size_t i = 0; i < libs.size(); i++)
+        {
+            isolation[i] = m_IsolatedExtensions.count(libs[i].second) > 0;
+        }
+    }
+
+    for (size_t i = 0; i < libs.size(); i++)
+    {
+        pool.start(new ExtensionLoadTask([this, isolated = isolation[i], &libpath = libs[i].first, &extn = loaded[i]] {
+            extn = loadLibrary(libpath, isolated);
+        }));
+    }
+
+    pool.waitForDone();
+
     std::unique_lock<std::shared_mutex> lk(m_ExtensionsMtx);
 
-    for (QFileInfo& file : list)
+    // Register in the order given rather than the order loads finished in, so that duplicates are resolved the same way on every start
+    for (size_t i = 0; i < libs.size(); i++)
     {
-        QString libpath = file.path() + "/" + file.fileName();
+        loaded[i] = addExtension(loaded[i], libs[i].second);
+    }
 
-        qInfo() << "Loading data extension" << libpath;
+    return loaded;
+}
+
+DataExtension* DataServer::loadLibrary(const QString& libpath, bool isolated)
+{
+    qInfo() << "Loading data extension" << libpath;
 
-        DataExtension* extn = DataExtension::load(libpath, this);
+    QElapsedTimer timer;
+    timer.start();
 
-        if (!extn)
+    DataExtension* extn = DataExtension::load(libpath, m_pScheduler, nullptr, isolated);
+
+    if (!extn)
+    {
+        qWarning() << "Failed to load extension" << libpath << "after" << timer.elapsed() << "ms";
+        return nullptr;
+    }
+
+    qInfo() << "Extension " << extn->getName() << " initialized in" << timer.elapsed() << "ms";
+
+    // Only the thread an object lives in may hand it over
+    extn->moveToThread(thread());
+
+    return extn;
+}
+
+void DataServer::finishLoading(const QString& libpath, const QString& extcode, DataExtension* extn)
+{
+    std::vector<std::function<void()>> ready;
+
+    {
+        std::unique_lock<std::shared_mutex> lk(m_ExtensionsMtx);
+
+        extn = addExtension(extn, extcode);
+
+        m_LoadingExtensions.erase(extcode);
+
+        auto it = m_LoadWaiters.find(extcode);
+
+        if (it != m_LoadWaiters.end())
         {
-            qWarning() << "Failed to load extension" << libpath;
+            for (auto& waiter : it->second)
+            {
+                if (--waiter->first == 0)
+                {
+                    ready.push_back(std::move(waiter->second));
+                }
+            }
+
+            m_LoadWaiters.erase(it);
         }
-        else if (m_InternalQueryTargets.count(extn->getName()))
+    }
+
+    if (!extn)
+    {
+        // The cached identifier may be stale, so have the library identified again on the next start
+        QSettings   settings;
+        QVariantMap cache = settings.value(QUASAR_CONFIG_EXTCACHE).toMap();
+
+        cache.remove(QFileInfo(libpath).fileName());
+
+        settings.setValue(QUASAR_CONFIG_EXTCACHE, cache);
+    }
+
+    // In the order they were parked, requests for an extension that failed to load find it unknown
+    for (auto& done : ready)
+    {
+        done();
+    }
+}
+
+DataExtension* DataServer::addExtension(DataExtension* extn, const QString& extcode)
+{
+    if (!extn)
+    {
+        return nullptr;
+    }
+
+    if (!extcode.isEmpty() && extn->getName() != extcode)
+    {
+        qWarning() << "Extension in" << extn->getLibPath() << "identifies as" << extn->getName() << "instead of" << extcode << ". Unloading"
+                   << extn->getLibPath();
+    }
+    else if (m_InternalQueryTargets.count(extn->getName()))
+    {
+        qWarning() << "The extension code" << extn->getName() << " is reserved. Unloading " << extn->getLibPath();
+    }
+    else if (m_Extensions.count(extn->getName()) ||
+             (extcode.isEmpty() && (m_ExtensionLibs.count(extn->getName()) || m_LoadingExtensions.count(extn->getName()))))
+    {
+        qWarning() << "Extension with code " << extn->getName() << " already loaded. Unloading" << extn->getLibPath();
+    }
+    else
+    {
+        qInfo() << "Extension " << extn->getName() << " loaded.";
+        extn->setParent(this);
+        m_Extensions[extn->getName()].reset(extn);
+        return extn;
+    }
+
+    delete extn;
+
+    return nullptr;
+}
+
+DataServer::ExtensionLibList DataServer::takePendingExtensions(const QStringList& extcodes)
+{
+    ExtensionLibList libs;
+
+    for (const QString& extcode : extcodes)
+    {
+        auto lit = m_ExtensionLibs.find(extcode);
+
+        if (lit != m_ExtensionLibs.end())
         {
-            qWarning() << "The extension code" << extn->getName() << " is reserved. Unloading " << libpath;
+            // Whether or not it loads, it is not tried again
+            libs.emplace_back(lit->second, extcode);
+            m_LoadingExtensions.insert(extcode);
+            m_ExtensionLibs.erase(lit);
         }
-        else if (m_Extensions.count(extn->getName()))
+    }
+
+    return libs;
+}
+
+DataExtension* DataServer::getExtension(const QString& extcode)
+{
+    std::shared_lock<std::shared_mutex> lk(m_ExtensionsMtx);
+
+    auto it = m_Extensions.find(extcode);
+
+    return it != m_Extensions.end() ? it->second.get() : nullptr;
+}
+
+bool DataServer::whenExtensionsLoaded(const QStringList& extcodes, std::function<void()> done)
+{
+    ExtensionLibList libs;
+    std::vector<bool> isolation;
+
+    {
+        std::unique_lock<std::shared_mutex> lk(m_ExtensionsMtx);
+
+        libs = takePendingExtensions(extcodes);
+
+        auto waiter = std::make_shared<std::pair<size_t, std::function<void()>>>(0, std::move(done));
+
+        // Extensions loaded or loading already are waited for too, so that requests are answered in order
+        for (const QString& extcode : QSet<QString>::fromList(extcodes))
         {
-            qWarning() << "Extension with code " << extn->getName() << " already loaded. Unloading" << libpath;
+            if (m_LoadingExtensions.count(extcode))
+            {
+                waiter->first++;
+                m_LoadWaiters[extcode].push_back(waiter);
+            }
         }
-        else
+
+        if (waiter->first == 0)
         {
-            qInfo() << "Extension " << extn->getName() << " loaded.";
-            m_Extensions[extn->getName()].reset(extn);
-            extn = nullptr;
+            return false;
         }
 
-        if (extn != nullptr)
+        for (const auto& lib : libs)
         {
-            delete extn;
+            isolation.push_back(m_IsolatedExtensions.count(lib.second) > 0);
         }
     }
+
+    // Completions are queued back to the server thread, where everything else about extensions happens
+    for (size_t i = 0; i < libs.size(); i++)
+    {
+        m_pLoadPool->start(new ExtensionLoadTask([this, lib = libs[i], isolated = isolation[i]] {
+            DataExtension* extn = loadLibrary(lib.first, isolated);
+
+            QMetaObject::invokeMethod(
+                this, [this, lib, extn] { finishLoading(lib.first, lib.second, extn); }, Qt::QueuedConnection);
+        }));
+    }
+
+    return true;
 }
 
-void DataServer::handleRequest(const QJsonObject& req, QWebSocket* sender)
+void DataServer::resolveExtension(const QString& extcode, std::function<void(DataExtension*)> done)
 {
-    if (req.isEmpty())
+    if (!whenExtensionsLoaded({extcode}, [this, extcode, done] { done(getExtension(extcode)); }))
     {
-        DS_SEND_WARN(sender, "Invalid JSON request");
+        done(getExtension(extcode));
+    }
+}
+
+std::function<void()> DataServer::retryRequest(Session& session, std::function<void(Session&)> handler)
+{
+    return [weak = WeakSession(session.shared_from_this()), handler = std::move(handler)] {
+        SessionPtr s = weak.lock();
+
+        if (s && !s->closed)
+        {
+            handler(*s);
+        }
+    };
+}
+
+void DataServer::handleRequest(const DataRequest& req, Session& session)
+{
+    if (!req.valid)
+    {
+        DS_SEND_WARN(session, "Invalid JSON request");
         return;
     }
 
-    QString mtd = req["method"].toString();
+    auto it = m_Methods.find(req.method);
 
-    if (!m_Methods.count(mtd))
+    if (it == m_Methods.end())
     {
-        DS_SEND_WARN(sender, "Unknown method type " + mtd);
+        DS_SEND_WARN(session, "Unknown method type " + req.method);
         return;
     }
 
-    m_Methods[mtd](req, sender);
+    it->second(req, session);
 }
 
-void DataServer::handleMethodSubscribe(const QJsonObject& req, QWebSocket* sender)
+void DataServer::handleRequestBatch(const DataRequestList& reqs, Session& session)
 {
+    if (reqs.empty())
     {
-        std::shared_lock<std::shared_mutex> lk(m_AuthedClientsMtx);
+        DS_SEND_WARN(session, "Empty request batch");
+        return;
+    }
 
-        auto it = m_AuthedClientsSet.find(sender);
-        if (it == m_AuthedClientsSet.end())
-        {
-            DS_SEND_WARN(sender, "Unauthenticated client");
-            return;
-        }
+    // Hold replies so that the whole batch is answered in as few messages as possible
+    session.client->beginBatch();
+
+    for (const auto& req : reqs)
+    {
+        handleRequest(req, session);
     }
 
-    auto qvar = sender->property(WGT_PROP_IDENTITY);
-    if (!qvar.isValid())
+    session.client->endBatch();
+}
+
+void DataServer::handleJsonMessage(const QByteArray& message, Session& session)
+{
+    DataRequestList reqs;
+    bool            batch;
+
+    if (!parseDataRequests(message, reqs, batch))
     {
-        qCritical() << "Invalid identity in authenticated WebSocket connection.";
+        qWarning() << "Error parsing client message";
+        qWarning() << message;
         return;
     }
 
-    client_data_t clidat     = qvar.value<client_data_t>();
-    QString       widgetName = clidat.ident;
+    if (batch)
+    {
+        handleRequestBatch(reqs, session);
+    }
+    else
+    {
+        handleRequest(reqs.front(), session);
+    }
+}
 
-    auto parms = req["params"].toObject();
+void DataServer::handleMethodSubscribe(const DataRequest& req, Session& session)
+{
+    if (!session.authenticated)
+    {
+        DS_SEND_WARN(session, "Unauthenticated client");
+        return;
+    }
+
+    const QString& widgetName = session.ident;
 
-    if (parms.count() != 2)
+    // "delta" and "rate" are optional
+    if (req.paramcount != 2 + req.hasParam(DataRequest::PARAM_DELTA) + req.hasParam(DataRequest::PARAM_RATE))
     {
-        DS_SEND_WARN(sender, "Invalid parameters for method 'subscribe'");
+        DS_SEND_WARN(session, "Invalid parameters for method 'subscribe'");
         return;
     }
 
-    QString extcode = parms["target"].toString();
-    QString extparm = parms["params"].toString();
+    const QString& extcode = req.target;
+    const QString& extparm = req.params;
+    bool           delta   = req.delta;
 
-    std::shared_lock<std::shared_mutex> lk(m_ExtensionsMtx);
+    if (req.rate < 0)
+    {
+        DS_SEND_WARN(session, "Invalid rate for method 'subscribe'");
+        return;
+    }
 
-    if (!m_Extensions.count(extcode))
+    if (whenExtensionsLoaded({extcode}, retryRequest(session, [this, req](Session& s) { handleMethodSubscribe(req, s); })))
     {
-        DS_SEND_WARN(sender, "Unknown extension identifier " + extcode);
+        return;
+    }
+
+    DataExtension* ext = getExtension(extcode);
+
+    if (!ext)
+    {
+        DS_SEND_WARN(session, "Unknown extension identifier " + extcode);
         return;
     }
 
@@ -228,162 +700,312 @@ void DataServer::handleMethodSubscribe(const QJsonObject& req, QWebSocket* sende
 
     for (QString& src : dlist)
     {
-        if (m_Extensions[extcode]->addSubscriber(src, sender, widgetName))
+        if (ext->addSubscriber(src, session.client, widgetName, session.encoding, delta, req.rate))
         {
             qInfo() << "Widget " << widgetName << " subscribed to extension " << extcode << " data " << src;
+
+            session.extensions.insert(extcode);
         }
         else
         {
-            DS_SEND_WARN(sender, "Failed to subscribed to extension " + extcode + " data " + src);
+            DS_SEND_WARN(session, "Failed to subscribed to extension " + extcode + " data " + src);
         }
     }
 }
 
-void DataServer::handleMethodQuery(const QJsonObject& req, QWebSocket* sender)
+void DataServer::handleMethodUnsubscribe(const DataRequest& req, Session& session)
 {
+    if (!session.authenticated)
+    {
+        DS_SEND_WARN(session, "Unauthenticated client");
+        return;
+    }
+
+    // "params" is optional, without it the client is unsubscribed from every source of the extension
+    if (!req.hasParam(DataRequest::PARAM_TARGET) || req.paramcount != 1 + req.hasParam(DataRequest::PARAM_PARAMS))
+    {
+        DS_SEND_WARN(session, "Invalid parameters for method 'unsubscribe'");
+        return;
+    }
+
+    const QString& extcode = req.target;
+
+    std::shared_lock<std::shared_mutex> lk(m_ExtensionsMtx);
+
+    auto it = m_Extensions.find(extcode);
+
+    if (it == m_Extensions.end())
+    {
+        // Nobody can be subscribed to an extension that was never loaded, but subscriptions waiting for it to load go first
+        if (m_LoadingExtensions.count(extcode))
+        {
+            lk.unlock();
+            whenExtensionsLoaded({extcode}, retryRequest(session, [this, req](Session& s) { handleMethodUnsubscribe(req, s); }));
+        }
+        else if (!m_ExtensionLibs.count(extcode))
+        {
+            DS_SEND_WARN(session, "Unknown extension identifier " + extcode);
+        }
+
+        return;
+    }
+
+    DataExtension* ext = it->second.get();
+
+    if (!req.hasParam(DataRequest::PARAM_PARAMS))
+    {
+        ext->removeSubscriber(session.client);
+    }
+    else
     {
-        std::shared_lock<std::shared_mutex> lk(m_AuthedClientsMtx);
+        QStringList dlist = req.params.split(',', QString::SkipEmptyParts);
+
+        for (QString& src : dlist)
+        {
+            // Unsubscribing from a source the client is not subscribed to is harmless
+            ext->removeSubscriber(src, session.client);
+        }
 
-        auto it = m_AuthedClientsSet.find(sender);
-        if (it == m_AuthedClientsSet.end())
+        if (ext->hasSubscriber(session.client))
         {
-            DS_SEND_WARN(sender, "Unauthenticated client");
             return;
         }
     }
 
-    auto qvar = sender->property(WGT_PROP_IDENTITY);
-    if (!qvar.isValid())
+    session.extensions.erase(extcode);
+}
+
+void DataServer::handleMethodQuery(const DataRequest& req, Session& session)
+{
+    if (!session.authenticated)
     {
-        qCritical() << "Invalid identity in authenticated WebSocket connection.";
+        DS_SEND_WARN(session, "Unauthenticated client");
         return;
     }
 
-    client_data_t clidat = qvar.value<client_data_t>();
-
-    auto parms = req["params"].toObject();
+    // Without a target, params name the sources to query by extension
+    if (!req.hasParam(DataRequest::PARAM_TARGET) && req.paramcount == 1 && req.data.isObject())
+    {
+        handleMultiQuery(req.data.toObject(), session);
+        return;
+    }
 
-    if (parms.count() != 2)
+    if (req.paramcount != 2)
     {
-        DS_SEND_WARN(sender, "Invalid parameters for method 'query'");
+        DS_SEND_WARN(session, "Invalid parameters for method 'query'");
         return;
     }
 
-    QString extcode = parms["target"].toString();
-    QString extparm = parms["params"].toString();
+    const QString& extcode = req.target;
+    const QString& extparm = req.params;
 
     if (m_InternalQueryTargets.count(extcode))
     {
-        m_InternalQueryTargets[extcode](extparm, clidat, sender);
+        m_InternalQueryTargets[extcode](extparm, session);
         return;
     }
 
-    std::shared_lock<std::shared_mutex> lk(m_ExtensionsMtx);
+    if (whenExtensionsLoaded({extcode}, retryRequest(session, [this, req](Session& s) { handleMethodQuery(req, s); })))
+    {
+        return;
+    }
 
-    if (!m_Extensions.count(extcode))
+    DataExtension* ext = getExtension(extcode);
+
+    if (!ext)
     {
-        DS_SEND_WARN(sender, "Unknown extension identifier " + extcode);
+        DS_SEND_WARN(session, "Unknown extension identifier " + extcode);
         return;
     }
 
-    m_Extensions[extcode]->pollAndSendData(extparm, sender, clidat.ident);
+    ext->pollAndSendData(extparm, session.client, session.ident, session.encoding);
 }
 
-void DataServer::handleMethodAuth(const QJsonObject& req, QWebSocket* sender)
+void DataServer::handleMultiQuery(const QJsonObject& targets, Session& session)
 {
+    if (targets.isEmpty())
     {
-        std::shared_lock<std::shared_mutex> lk(m_AuthedClientsMtx);
-        if (m_AuthedClientsSet.count(sender))
-        {
-            DS_SEND_WARN(sender, "Client already authenticated.");
-            return;
-        }
+        DS_SEND_WARN(session, "Invalid parameters for method 'query'");
+        return;
     }
 
-    auto parms = req["params"].toObject();
-
-    if (parms.count() != 1)
+    if (whenExtensionsLoaded(targets.keys(), retryRequest(session, [this, targets](Session& s) { handleMultiQuery(targets, s); })))
     {
-        DS_SEND_WARN(sender, "Invalid parameters for method 'auth'");
         return;
     }
 
-    QString authcode = parms["code"].toString();
+    auto query      = std::make_shared<MultiQuery>();
+    query->client   = session.client;
+    query->encoding = session.encoding;
 
-    client_data_t clident;
+    std::vector<std::pair<DataExtension*, QString>> polls;
 
-    if (!authenticateClient(sender, authcode, clident))
+    for (auto it = targets.begin(); it != targets.end(); ++it)
     {
-        DS_SEND_WARN(sender, "Invalid authentication code");
+        DataExtension* ext = it.value().isString() ? getExtension(it.key()) : nullptr;
+
+        if (!ext)
+        {
+            QString m = "Unknown extension identifier " + it.key();
+            query->errs.append(m);
+            qWarning() << m;
+            continue;
+        }
+
+        polls.emplace_back(ext, it.value().toString());
+    }
+
+    // Results that complete right away join the request batch, if any. The others are sent on their own
+    if (polls.empty())
+    {
+        sendMultiQueryReply(*query);
         return;
     }
 
-    sender->setProperty(WGT_PROP_IDENTITY, QVariant::fromValue(clident));
+    // Set up the count first as cached results complete immediately
+    query->remaining = polls.size();
 
-    std::unique_lock<std::shared_mutex> lkm(m_AuthedClientsMtx);
-    m_AuthedClientsSet.insert(sender);
+    // Every extension polls on its own worker pool, so they all run at the same time
+    for (const auto& [ext, sources] : polls)
+    {
+        ext->pollData(sources, session.client, session.ident, session.encoding, [query, name = ext->getName()](const QCborMap& data, const QCborArray& errs) {
+            if (!data.isEmpty())
+            {
+                query->data[name] = data;
+            }
 
-    qInfo() << "Widget ident " << clident.ident << " authenticated.";
+            for (const auto& e : errs)
+            {
+                query->errs.append(e);
+            }
+
+            if (--query->remaining == 0)
+            {
+                sendMultiQueryReply(*query);
+            }
+        });
+    }
 }
 
-void DataServer::handleMethodMutate(const QJsonObject& req, QWebSocket* sender)
+void DataServer::handleMethodAuth(const DataRequest& req, Session& session)
 {
+    if (session.authenticated)
     {
-        std::shared_lock<std::shared_mutex> lk(m_AuthedClientsMtx);
+        DS_SEND_WARN(session, "Client already authenticated.");
+        return;
+    }
 
-        auto it = m_AuthedClientsSet.find(sender);
-        if (it == m_AuthedClientsSet.end())
-        {
-            DS_SEND_WARN(sender, "Unauthenticated client");
-            return;
-        }
+    // encoding is optional and defaults to json
+    bool hasEncoding = req.hasParam(DataRequest::PARAM_ENCODING);
+
+    if (req.paramcount != (hasEncoding ? 2 : 1))
+    {
+        DS_SEND_WARN(session, "Invalid parameters for method 'auth'");
+        return;
     }
 
-    auto qvar = sender->property(WGT_PROP_IDENTITY);
-    if (!qvar.isValid())
+    bool         validEncoding = true;
+    DataEncoding encoding      = DataFrame::encodingFromString(hasEncoding ? req.encoding : QStringLiteral("json"), &validEncoding);
+
+    if (!validEncoding)
     {
-        qCritical() << "Invalid identity in authenticated WebSocket connection.";
+        DS_SEND_WARN(session, "Unknown encoding " + req.encoding);
         return;
     }
 
-    client_data_t clidat = qvar.value<client_data_t>();
+    const QString& authcode = req.code;
+
+    client_data_t clident;
 
-    if (clidat.access < CAL_SETTINGS)
+    if (!authenticateClient(session, authcode, clident))
     {
-        DS_SEND_WARN(sender, "Insufficient access for mutate method");
+        DS_SEND_WARN(session, "Invalid authentication code");
         return;
     }
 
-    auto parms = req["params"].toObject();
+    session.authenticated = true;
+    session.ident         = clident.ident;
+    session.access        = clident.access;
+    session.encoding      = encoding;
+
+    session.client->setObjectName(clident.ident);
 
-    if (parms.count() != 2)
     {
-        DS_SEND_WARN(sender, "Invalid parameters for method 'mutate'");
+        // Widgets that are hidden while (re)connecting start out paused
+        std::shared_lock<std::shared_mutex> lk(m_SessionsMtx);
+        session.client->setPaused(m_PausedIdents.count(clident.ident) > 0);
+    }
+
+    qInfo() << "Widget ident " << clident.ident << " authenticated.";
+}
+
+void DataServer::handleMethodMutate(const DataRequest& req, Session& session)
+{
+    if (!session.authenticated)
+    {
+        DS_SEND_WARN(session, "Unauthenticated client");
+        return;
+    }
+
+    if (session.access < CAL_SETTINGS)
+    {
+        DS_SEND_WARN(session, "Insufficient access for mutate method");
         return;
     }
 
-    QString targ = parms["target"].toString();
+    if (req.paramcount != 2)
+    {
+        DS_SEND_WARN(session, "Invalid parameters for method 'mutate'");
+        return;
+    }
+
+    const QString& targ = req.target;
 
     if (!m_MutateTargets.count(targ))
     {
-        DS_SEND_WARN(sender, "Unknown mutate target " + targ);
+        DS_SEND_WARN(session, "Unknown mutate target " + targ);
         return;
     }
 
-    m_MutateTargets[targ](parms["params"], sender);
+    m_MutateTargets[targ](req.data, session);
 }
 
-void DataServer::handleQuerySettings(QString params, client_data_t client, QWebSocket* sender)
+void DataServer::handleQuerySettings(QString params, Session& session)
 {
-    if (client.access < CAL_SETTINGS)
+    if (session.access < CAL_SETTINGS)
     {
-        DS_SEND_WARN(sender, "Insufficient access for query target 'settings'");
+        DS_SEND_WARN(session, "Insufficient access for query target 'settings'");
         return;
     }
 
     // handle params
     auto plist = QSet<QString>::fromList(params.split(',', QString::SkipEmptyParts));
 
+    if (plist.contains("all") || plist.contains("extensions"))
+    {
+        QStringList pending;
+
+        {
+            std::shared_lock<std::shared_mutex> lk(m_ExtensionsMtx);
+
+            for (auto& it : m_ExtensionLibs)
+            {
+                pending << it.first;
+            }
+
+            for (auto& extcode : m_LoadingExtensions)
+            {
+                pending << extcode;
+            }
+        }
+
+        // Every extension has to be loaded to know its settings
+        if (whenExtensionsLoaded(pending, retryRequest(session, [this, params](Session& s) { handleQuerySettings(params, s); })))
+        {
+            return;
+        }
+    }
+
     // compile all settings into json
     QSettings settings;
 
@@ -394,10 +1016,14 @@ void DataServer::handleQuerySettings(QString params, client_data_t client, QWebS
     {
         QJsonObject global;
 
-        global["dataport"] = settings.value(QUASAR_CONFIG_PORT, QUASAR_DATA_SERVER_DEFAULT_PORT).toInt();
-        global["loglevel"] = settings.value(QUASAR_CONFIG_LOGLEVEL, QUASAR_CONFIG_DEFAULT_LOGLEVEL).toInt();
-        global["savelog"]  = settings.value(QUASAR_CONFIG_LOGFILE, false).toBool();
-        global["cookies"]  = QString();
+        global["dataport"]   = settings.value(QUASAR_CONFIG_PORT, QUASAR_DATA_SERVER_DEFAULT_PORT).toInt();
+        global["datasecure"] = settings.value(QUASAR_CONFIG_SECURE, true).toBool();
+        global["datalocal"]  = settings.value(QUASAR_CONFIG_LOCALSOCKET, false).toBool();
+        global["outpolicy"]  = settings.value(QUASAR_CONFIG_OUTPOLICY, DataClient::OUTBOUND_COALESCE).toInt();
+        global["outlimit"]   = settings.value(QUASAR_CONFIG_OUTLIMIT, QUASAR_OUTBOUND_DEFAULT_HIGHWATER / 1024).toInt();
+        global["loglevel"]   = settings.value(QUASAR_CONFIG_LOGLEVEL, QUASAR_CONFIG_DEFAULT_LOGLEVEL).toInt();
+        global["savelog"]    = settings.value(QUASAR_CONFIG_LOGFILE, false).toBool();
+        global["cookies"]    = QString();
 
         auto bcookies = settings.value(QUASAR_CONFIG_COOKIES, QByteArray()).toByteArray();
         if (!bcookies.isEmpty())
@@ -497,11 +1123,10 @@ void DataServer::handleQuerySettings(QString params, client_data_t client, QWebS
     auto sdata = QJsonObject{{"data", QJsonObject{{"settings", sjson}}}};
 
     // send
-    QJsonDocument doc(sdata);
-    sender->sendTextMessage(QString::fromUtf8(doc.toJson()));
+    DataFrame(sdata).sendTo(session.client, session.encoding);
 }
 
-void DataServer::handleQueryLauncher(QString params, client_data_t client, QWebSocket* sender)
+void DataServer::handleQueryLauncher(QString params, Session& session)
 {
     // If get, send data
     if (params == "get")
@@ -536,8 +1161,7 @@ void DataServer::handleQueryLauncher(QString params, client_data_t client, QWebS
         auto sdata = QJsonObject{{"data", QJsonObject{{"launcher", launcher}}}};
 
         // send
-        QJsonDocument doc(sdata);
-        sender->sendTextMessage(QString::fromUtf8(doc.toJson()));
+        DataFrame(sdata).sendTo(session.client, session.encoding);
         return;
     }
 
@@ -564,7 +1188,9 @@ void DataServer::handleQueryLauncher(QString params, client_data_t client, QWebS
         {
             // treat as url
             qInfo() << "Launching URL " << cmd;
-            QDesktopServices::openUrl(QUrl(cmd));
+
+            // QDesktopServices belongs to the GUI thread
+            QMetaObject::invokeMethod(qApp, [cmd] { QDesktopServices::openUrl(QUrl(cmd)); }, Qt::QueuedConnection);
         }
         else
         {
@@ -588,7 +1214,59 @@ void DataServer::handleQueryLauncher(QString params, client_data_t client, QWebS
     }
 }
 
-void DataServer::handleMutateSettings(QJsonValue val, QWebSocket* sender)
+void DataServer::handleQueryStats(QString params, Session& session)
+{
+    Q_UNUSED(params);
+
+    if (session.access < CAL_DEBUG)
+    {
+        DS_SEND_WARN(session, "Insufficient access for query target 'stats'");
+        return;
+    }
+
+    QJsonArray clients;
+
+    {
+        std::shared_lock<std::shared_mutex> lk(m_SessionsMtx);
+
+        for (const auto& [c, sess] : m_Sessions)
+        {
+            if (!sess->authenticated)
+            {
+                continue;
+            }
+
+            QJsonObject entry;
+            entry["ident"]     = sess->ident;
+            entry["pending"]   = c->bytesToWrite();
+            entry["queued"]    = c->queuedFrames();
+            entry["peak"]      = c->peakQueuedFrames();
+            entry["dropped"]   = qint64(c->droppedFrames());
+            entry["coalesced"] = qint64(c->coalescedFrames());
+            entry["paused"]    = c->isPaused();
+
+            clients.append(entry);
+        }
+    }
+
+    const DataSchedulerStats& sched = m_pScheduler->stats();
+
+    QJsonObject scheduler;
+    scheduler["tasks"]       = qint64(m_pScheduler->taskCount());
+    scheduler["wakeups"]     = qint64(sched.wakeups);
+    scheduler["ticks"]       = qint64(sched.ticks);
+    scheduler["missed"]      = qint64(sched.missed);
+    scheduler["overruns"]    = qint64(sched.overruns);
+    scheduler["maxlateness"] = sched.maxlateness;
+    scheduler["maxbusy"]     = sched.maxbusy;
+
+    auto sdata = QJsonObject{{"data", QJsonObject{{"stats", QJsonObject{{"clients", clients}, {"scheduler", scheduler}}}}}};
+
+    // send
+    DataFrame(sdata).sendTo(session.client, session.encoding);
+}
+
+void DataServer::handleMutateSettings(QJsonValue val, Session& session)
 {
     QJsonObject data = val.toObject();
 
@@ -598,6 +1276,13 @@ void DataServer::handleMutateSettings(QJsonValue val, QWebSocket* sender)
         return;
     }
 
+    // Settings are only applied once every extension they are for is loaded, so that none are applied twice
+    if (data.contains("extensions") &&
+        whenExtensionsLoaded(data["extensions"].toObject().keys(), retryRequest(session, [this, val](Session& s) { handleMutateSettings(val, s); })))
+    {
+        return;
+    }
+
     QSettings settings;
 
     for (auto& key : data.keys())
@@ -639,18 +1324,17 @@ void DataServer::handleMutateSettings(QJsonValue val, QWebSocket* sender)
         {
             auto exts = data["extensions"].toObject();
 
-            std::shared_lock<std::shared_mutex> lk(m_ExtensionsMtx);
-
             for (auto& extkey : exts.keys())
             {
-                if (!m_Extensions.count(extkey))
+                DataExtension* ext = getExtension(extkey);
+
+                if (!ext)
                 {
                     // Extension doesn't exist
                     qWarning() << "Unknown extension code " << extkey;
                     continue;
                 }
 
-                auto& ext = m_Extensions[extkey];
                 ext->setAllSettings(exts[extkey].toObject());
             }
         }
@@ -728,7 +1412,7 @@ void DataServer::handleMutateSettings(QJsonValue val, QWebSocket* sender)
     qInfo() << "All settings saved!";
 }
 
-bool DataServer::authenticateClient(QWebSocket* client, QString code, client_data_t& clidat)
+bool DataServer::authenticateClient(Session& session, QString code, client_data_t& clidat)
 {
     // Check user keys
     {
@@ -743,7 +1427,7 @@ bool DataServer::authenticateClient(QWebSocket* client, QString code, client_dat
             if (m_UserKeysInUse.count(code))
             {
                 // Key is in use
-                DS_SEND_WARN(client, "User key " + keyname + " already in use.");
+                DS_SEND_WARN(session, "User key " + keyname + " already in use.");
                 return false;
             }
 
@@ -753,8 +1437,8 @@ bool DataServer::authenticateClient(QWebSocket* client, QString code, client_dat
 
             // Otherwise, log them in
             m_UserKeysInUse.insert(code);
-            clidat = cdt;
-            client->setProperty(WGT_PROP_USERKEY, code);
+            clidat          = cdt;
+            session.userkey = code;
             return true;
         }
         // Otherwise, pass thru to regular authcode check
@@ -764,7 +1448,7 @@ bool DataServer::authenticateClient(QWebSocket* client, QString code, client_dat
     std::unique_lock<std::mutex> lk(m_AuthCodeMtx);
 
     auto it = m_AuthCodeMap.find(code);
-    if (it == m_AuthCodeMap.end())
+    if (it == m_AuthCodeMap.end() || it->second.expiry <= steady_clock::now())
     {
         return false;
     }
@@ -776,119 +1460,255 @@ bool DataServer::authenticateClient(QWebSocket* client, QString code, client_dat
     return true;
 }
 
-void DataServer::checkAuth(QWebSocket* client)
+void DataServer::sweepAuth()
 {
-    bool disconnect = false;
+    const auto now = steady_clock::now();
 
     {
-        // Check auth
-        std::shared_lock<std::shared_mutex> lk(m_AuthedClientsMtx);
-        if (!m_AuthedClientsSet.count(client))
+        // Drop expired auth codes, codes that were used already are no longer in the map
+        std::unique_lock<std::mutex> lk(m_AuthCodeMtx);
+
+        while (!m_AuthCodeExpiry.empty() && m_AuthCodeExpiry.front().first <= now)
         {
-            // unauthenticated client, cut the connection
-            disconnect = true;
+            m_AuthCodeMap.erase(m_AuthCodeExpiry.front().second);
+            m_AuthCodeExpiry.pop_front();
         }
     }
 
+    std::vector<SessionPtr> expired;
+
+    while (!m_PendingAuth.empty() && m_PendingAuth.front().first <= now)
+    {
+        SessionPtr session = m_PendingAuth.front().second.lock();
+
+        if (session && !session->authenticated && !session->closed)
+        {
+            expired.push_back(session);
+        }
+
+        m_PendingAuth.pop_front();
+    }
+
+    for (const auto& session : expired)
+    {
+        // unauthenticated client, cut the connection
+        DS_SEND_WARN(*session, "Unauthenticated client, disconnecting");
+        session->client->close("Unauthenticated client");
+    }
+
+    armAuthSweeper();
+}
+
+void DataServer::armAuthSweeper()
+{
+    auto due = steady_clock::time_point::max();
+
     {
-        // Clean expired auth codes
         std::unique_lock<std::mutex> lk(m_AuthCodeMtx);
-        for (auto it = m_AuthCodeMap.begin(); it != m_AuthCodeMap.end();)
+
+        if (!m_AuthCodeExpiry.empty())
+        {
+            due = m_AuthCodeExpiry.front().first;
+        }
+    }
+
+    if (!m_PendingAuth.empty())
+    {
+        due = std::min(due, m_PendingAuth.front().first);
+    }
+
+    if (due == steady_clock::time_point::max())
+    {
+        m_pAuthSweeper->stop();
+        return;
+    }
+
+    auto wait = ceil<milliseconds>(due - steady_clock::now());
+
+    m_pAuthSweeper->start(static_cast<int>(std::max<int64_t>(0, wait.count())));
+}
+
+void DataServer::closeSession(Session& session)
+{
+    session.authenticated = false;
+    session.closed        = true;
+
+    {
+        // Only visit the extensions the client is subscribed to
+        std::shared_lock<std::shared_mutex> lk(m_ExtensionsMtx);
+        for (const QString& extcode : session.extensions)
         {
-            if (it->second.expiry < system_clock::now())
+            auto it = m_Extensions.find(extcode);
+            if (it != m_Extensions.end())
             {
-                it = m_AuthCodeMap.erase(it);
+                it->second->removeSubscriber(session.client);
             }
-            else
+        }
+
+        session.extensions.clear();
+    }
+
+    if (!session.userkey.isEmpty())
+    {
+        // If this client was connected using a user key, free it
+        std::unique_lock<std::shared_mutex> lk(m_UserKeysMtx);
+
+        m_UserKeysInUse.erase(session.userkey);
+    }
+
+    DataClient* client = session.client;
+
+    {
+        // The client's connections keep the session alive until the client itself is deleted
+        std::unique_lock<std::shared_mutex> lk(m_SessionsMtx);
+        m_Sessions.erase(client);
+    }
+
+    client->deleteLater();
+}
+
+void DataServer::setWidgetPaused(QString ident, bool paused)
+{
+    // Widgets live on the GUI thread, while subscriptions and timers belong to this one
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(this, [this, ident, paused] { setWidgetPaused(ident, paused); }, Qt::QueuedConnection);
+        return;
+    }
+
+    std::vector<SessionPtr> sessions;
+
+    {
+        std::unique_lock<std::shared_mutex> lk(m_SessionsMtx);
+
+        if (paused)
+        {
+            m_PausedIdents.insert(ident);
+        }
+        else
+        {
+            m_PausedIdents.erase(ident);
+        }
+
+        for (const auto& [client, session] : m_Sessions)
+        {
+            if (session->authenticated && session->ident == ident && client->isPaused() != paused)
             {
-                ++it;
+                sessions.push_back(session);
             }
         }
     }
 
-    if (disconnect)
+    for (const auto& session : sessions)
     {
-        DS_SEND_WARN(client, "Unauthenticated client, disconnecting");
-        client->close(QWebSocketProtocol::CloseCodeNormal, "Unauthenticated client");
+        setSessionPaused(*session, paused);
     }
+
+    qInfo() << "Widget " << ident << (paused ? " paused" : " resumed");
 }
 
-void DataServer::sendErrorToClient(QWebSocket* client, QString err)
+void DataServer::setSessionPaused(Session& session, bool paused)
+{
+    session.client->setPaused(paused);
+
+    std::shared_lock<std::shared_mutex> lk(m_ExtensionsMtx);
+    for (const QString& extcode : session.extensions)
+    {
+        auto it = m_Extensions.find(extcode);
+        if (it != m_Extensions.end())
+        {
+            it->second->setSubscriberPaused(session.client, paused);
+        }
+    }
+}
+
+void DataServer::sendErrorToClient(Session& session, QString err)
 {
     // Craft error json msg
     QJsonObject msg;
     msg["errors"] = err;
 
-    QJsonDocument doc(msg);
-
-    client->sendTextMessage(QString::fromUtf8(doc.toJson()));
+    // Unauthenticated clients have not negotiated an encoding yet, so this is json for them
+    DataFrame(msg).sendTo(session.client, session.encoding);
 }
 
 void DataServer::onNewConnection()
 {
-    QWebSocket* pSocket = m_pWebSocketServer->nextPendingConnection();
-
-    pSocket->setParent(this);
-    connect(pSocket, &QWebSocket::textMessageReceived, this, &DataServer::processMessage);
-    connect(pSocket, &QWebSocket::disconnected, this, &DataServer::socketDisconnected);
-
-    QTimer* authtimer = new QTimer(pSocket);
-    authtimer->setSingleShot(true);
-
-    connect(authtimer, &QTimer::timeout, this, [this, pSocket, authtimer] {
-        checkAuth(pSocket);
-        authtimer->deleteLater();
-    });
+    acceptClient(new WebSocketClient(m_pWebSocketServer->nextPendingConnection(), this));
+}
 
-    authtimer->start(10000);
+void DataServer::onNewLocalConnection()
+{
+    acceptClient(new LocalSocketClient(m_pLocalServer->nextPendingConnection(), this));
 }
 
-void DataServer::processMessage(QString message)
+void DataServer::acceptClient(DataClient* client)
 {
-    QWebSocket* pSender = qobject_cast<QWebSocket*>(sender());
+    auto session = std::make_shared<Session>(client);
 
-    if (pSender)
     {
-        QJsonDocument doc = QJsonDocument::fromJson(message.toUtf8());
+        std::unique_lock<std::shared_mutex> lk(m_SessionsMtx);
+        m_Sessions[client] = session;
+    }
 
-        if (doc.isNull())
-        {
-            qWarning() << "Error parsing WebSocket message";
-            qWarning() << message;
-            return;
-        }
+    // Connections hold the session, so handlers are handed it directly. They go away with the client.
+    connect(client, &DataClient::textMessageReceived, this, [this, session](QString message) { handleJsonMessage(message.toUtf8(), *session); });
+    connect(client, &DataClient::utf8MessageReceived, this, [this, session](QByteArray message) { handleJsonMessage(message, *session); });
+    connect(client, &DataClient::binaryMessageReceived, this, [this, session](QByteArray message) { handleBinaryMessage(message, *session); });
+    connect(client, &DataClient::disconnected, this, [this, session] { closeSession(*session); });
+
+    QSettings settings;
+
+    auto policy   = settings.value(QUASAR_CONFIG_OUTPOLICY, DataClient::OUTBOUND_COALESCE).toInt();
+    auto limitkib = settings.value(QUASAR_CONFIG_OUTLIMIT, QUASAR_OUTBOUND_DEFAULT_HIGHWATER / 1024).toLongLong();
 
-        handleRequest(doc.object(), pSender);
+    client->setOutboundLimits(qMax<qint64>(1, limitkib) * 1024,
+                              QUASAR_OUTBOUND_DEFAULT_MAXFRAMES,
+                              static_cast<DataClient::OutboundPolicy>(qBound<int>(DataClient::OUTBOUND_DROP_OLDEST, policy, DataClient::OUTBOUND_DISCONNECT)));
+
+    // Unauthenticated connections are cut once their deadline passes
+    bool arm = m_PendingAuth.empty();
+
+    m_PendingAuth.emplace_back(steady_clock::now() + milliseconds(QUASAR_AUTH_TIMEOUT), session);
+
+    if (arm)
+    {
+        armAuthSweeper();
     }
 }
 
-void DataServer::socketDisconnected()
+void DataServer::handleBinaryMessage(const QByteArray& message, Session& session)
 {
-    QWebSocket* pClient = qobject_cast<QWebSocket*>(sender());
-    if (pClient)
+    // Clients may send JSON requests as binary frames to skip text decoding
+    if (isJsonRequestData(message))
     {
-        {
-            std::shared_lock<std::shared_mutex> lk(m_ExtensionsMtx);
-            for (auto& p : m_Extensions)
-            {
-                p.second->removeSubscriber(pClient);
-            }
-        }
+        handleJsonMessage(message, session);
+        return;
+    }
 
-        {
-            std::unique_lock<std::shared_mutex> lkm(m_AuthedClientsMtx);
-            m_AuthedClientsSet.erase(pClient);
-        }
+    // Otherwise binary requests are CBOR encoded
+    QCborParserError err;
+    QCborValue       req = QCborValue::fromCbor(message, &err);
 
-        auto keyprop = pClient->property(WGT_PROP_USERKEY);
-        if (keyprop.isValid())
-        {
-            // If this client was connected using a user key, free it
-            std::unique_lock<std::shared_mutex> lk(m_UserKeysMtx);
+    if (err.error != QCborError::NoError || !(req.isMap() || req.isArray()))
+    {
+        qWarning() << "Error parsing binary client message:" << err.errorString();
+        return;
+    }
+
+    if (req.isArray())
+    {
+        DataRequestList reqs;
 
-            m_UserKeysInUse.erase(keyprop.toString());
+        for (const auto& r : req.toArray())
+        {
+            reqs.push_back(DataRequest::fromJson(r.toMap().toJsonObject()));
         }
 
-        pClient->deleteLater();
+        handleRequestBatch(reqs, session);
+    }
+    else
+    {
+        handleRequest(DataRequest::fromJson(req.toMap().toJsonObject()), session);
     }
 }
@@ -1,21 +1,32 @@
 #pragma once
 
+#include "datarequest.h"
+
+#include <dataframe.h>
 #include <qstring_hash_impl.h>
 
 #include <QObject>
 #include <QVariant>
 
 #include <chrono>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 QT_FORWARD_DECLARE_CLASS(QWebSocketServer)
-QT_FORWARD_DECLARE_CLASS(QWebSocket)
+QT_FORWARD_DECLARE_CLASS(QLocalServer)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+QT_FORWARD_DECLARE_CLASS(QThreadPool)
 
+class DataClient;
 class DataExtension;
+class DataScheduler;
+class DerivedSources;
 
 using namespace std::chrono;
 
@@ -61,11 +72,32 @@ struct client_data_t
 {
     QString                  ident;
     ClientAccessLevel        access;
-    system_clock::time_point expiry;
+    steady_clock::time_point expiry;
+    DataEncoding             encoding = DATA_ENCODING_JSON;
+};
+
+// State of a single client connection
+//
+// Created when the client connects and handed straight to every request handler,
+// so that handling a request never needs to look the client up. Outbound queue
+// and counters live in the client itself. Requests parked while an extension loads
+// only keep a weak reference to it.
+struct Session : std::enable_shared_from_this<Session>
+{
+    explicit Session(DataClient* c) : client(c) {}
+
+    DataClient*                 client;
+    bool                        authenticated = false;
+    bool                        closed        = false; // set once the connection is gone
+    QString                     ident;
+    ClientAccessLevel           access   = CAL_WIDGET;
+    DataEncoding                encoding = DATA_ENCODING_JSON; // json until negotiated by auth
+    QString                     userkey;                       // user key the client logged in with, if any
+    std::unordered_set<QString> extensions;                    // extensions the client is subscribed to
 };
 
-Q_DECLARE_METATYPE(system_clock::time_point);
-Q_DECLARE_METATYPE(client_data_t);
+using SessionPtr  = std::shared_ptr<Session>;
+using WeakSession = std::weak_ptr<Session>;
 
 class DataServer : public QObject
 {
@@ -74,15 +106,21 @@ class DataServer : public QObject
     Q_OBJECT
 
     using DataExtensionMapType   = std::unordered_map<QString, std::unique_ptr<DataExtension>>;
-    using MethodFuncType         = std::function<void(const QJsonObject&, QWebSocket*)>;
+    using ExtensionLibMapType    = std::unordered_map<QString, QString>;
+    using ExtensionLibList       = std::vector<std::pair<QString, QString>>; // library path, expected extension code if known
+    using MethodFuncType         = std::function<void(const DataRequest&, Session&)>;
     using MethodCallMapType      = std::unordered_map<QString, MethodFuncType>;
-    using AuthedClientsSetType   = std::unordered_set<QWebSocket*>;
+    using SessionsMapType        = std::unordered_map<DataClient*, SessionPtr>;
     using AuthCodesMapType       = std::unordered_map<QString, client_data_t>;
+    using AuthExpiryQueueType    = std::deque<std::pair<steady_clock::time_point, QString>>;
+    using PendingAuthQueueType   = std::deque<std::pair<steady_clock::time_point, WeakSession>>;
     using SavableCodesMapType    = QVariantMap;
-    using InternalTargetFuncType = std::function<void(QString, client_data_t, QWebSocket*)>;
+    using InternalTargetFuncType = std::function<void(QString, Session&)>;
     using InternalTargetMapType  = std::unordered_map<QString, InternalTargetFuncType>;
-    using MutateTargetFuncType   = std::function<void(QJsonValue, QWebSocket*)>;
+    using MutateTargetFuncType   = std::function<void(QJsonValue, Session&)>;
     using MutateTargetMapType    = std::unordered_map<QString, MutateTargetFuncType>;
+    using LoadWaiterPtr          = std::shared_ptr<std::pair<size_t, std::function<void()>>>; // extensions still loading, callback
+    using LoadWaitersMapType     = std::unordered_map<QString, std::vector<LoadWaiterPtr>>;
 
 public:
     ~DataServer();
@@ -91,33 +129,66 @@ public:
 
     QString generateAuthCode(QString ident, ClientAccessLevel lvl = CAL_WIDGET);
 
+    // Starts serving a newly connected client, which must be parented to the server
+    void acceptClient(DataClient* client);
+
+    // Pauses or resumes data delivery to every client of a widget, including ones that connect later
+    void setWidgetPaused(QString ident, bool paused);
+
 private:
-    void loadExtensions();
-    void handleRequest(const QJsonObject& req, QWebSocket* sender);
+    // Extensions are only loaded once a client uses them, see whenExtensionsLoaded()
+    //
+    // Libraries are loaded on m_pLoadPool without holding m_ExtensionsMtx, so that neither lookups nor
+    // the server thread are ever held up by an extension's init(). Loads are only started and finished
+    // on the server thread. takePendingExtensions() and addExtension() expect the lock to be held
+    // exclusively, the others take it themselves.
+    DataExtension*              getExtension(const QString& extcode);
+    bool                        whenExtensionsLoaded(const QStringList& extcodes, std::function<void()> done);
+    void                        resolveExtension(const QString& extcode, std::function<void(DataExtension*)> done);
+    void                        scanExtensions();
+    void                        loadDerivedSources();
+    ExtensionLibList            takePendingExtensions(const QStringList& extcodes);
+    DataExtension*              loadLibrary(const QString& libpath, bool isolated);
+    std::vector<DataExtension*> loadExtensions(const ExtensionLibList& libs);
+    void                        finishLoading(const QString& libpath, const QString& extcode, DataExtension* extn);
+    DataExtension*              addExtension(DataExtension* extn, const QString& extcode);
+
+    void handleRequest(const DataRequest& req, Session& session);
+    void handleRequestBatch(const DataRequestList& reqs, Session& session);
+    void handleJsonMessage(const QByteArray& message, Session& session);
+    void handleBinaryMessage(const QByteArray& message, Session& session);
 
     // Method handling
-    void handleMethodSubscribe(const QJsonObject& req, QWebSocket* sender);
-    void handleMethodQuery(const QJsonObject& req, QWebSocket* sender);
-    void handleMethodAuth(const QJsonObject& req, QWebSocket* sender);
-    void handleMethodMutate(const QJsonObject& req, QWebSocket* sender);
+    void handleMethodSubscribe(const DataRequest& req, Session& session);
+    void handleMethodUnsubscribe(const DataRequest& req, Session& session);
+    void handleMethodQuery(const DataRequest& req, Session& session);
+    void handleMultiQuery(const QJsonObject& targets, Session& session);
+    void handleMethodAuth(const DataRequest& req, Session& session);
+    void handleMethodMutate(const DataRequest& req, Session& session);
 
     // Internal data targets
-    void handleQuerySettings(QString params, client_data_t client, QWebSocket* sender);
-    void handleQueryLauncher(QString params, client_data_t client, QWebSocket* sender);
+    void handleQuerySettings(QString params, Session& session);
+    void handleQueryLauncher(QString params, Session& session);
+    void handleQueryStats(QString params, Session& session);
 
     // Mutate targets
-    void handleMutateSettings(QJsonValue val, QWebSocket* sender);
+    void handleMutateSettings(QJsonValue val, Session& session);
 
     // Helpers
-    bool authenticateClient(QWebSocket* client, QString code, client_data_t& clidat);
+    bool authenticateClient(Session& session, QString code, client_data_t& clidat);
 
-    void checkAuth(QWebSocket* client);
-    void sendErrorToClient(QWebSocket* client, QString err);
+    void sweepAuth();
+    void armAuthSweeper();
+    void closeSession(Session& session);
+    void setSessionPaused(Session& session, bool paused);
+    void sendErrorToClient(Session& session, QString err);
+
+    // Runs handler again for the session once the extensions it waits for are loaded, unless it closed meanwhile
+    static std::function<void()> retryRequest(Session& session, std::function<void(Session&)> handler);
 
 private slots:
     void onNewConnection();
-    void processMessage(QString message);
-    void socketDisconnected();
+    void onNewLocalConnection();
 
 private:
     explicit DataServer(QObject* parent = nullptr);
@@ -127,6 +198,10 @@ private:
     DataServer& operator=(DataServer&&) = delete;
 
     QWebSocketServer* m_pWebSocketServer;
+    QLocalServer*     m_pLocalServer;
+
+    // Drives all timer-based Data Sources
+    DataScheduler* m_pScheduler;
 
     // Method function map
     MethodCallMapType m_Methods;
@@ -142,19 +217,38 @@ private:
     mutable std::shared_mutex m_LauncherMtx;
 
     // Authentication code management
-    AuthCodesMapType   m_AuthCodeMap;
-    mutable std::mutex m_AuthCodeMtx;
+    //
+    // Every auth code and every new connection gets the same lifetime, so appending
+    // deadlines keeps both queues ordered by expiry and a single timer only ever needs
+    // to look at their fronts.
+    AuthCodesMapType     m_AuthCodeMap;
+    AuthExpiryQueueType  m_AuthCodeExpiry;
+    mutable std::mutex   m_AuthCodeMtx;
+    PendingAuthQueueType m_PendingAuth; // connections waiting for auth, server thread only
+    QTimer*              m_pAuthSweeper;
 
     // User keys
     std::unordered_set<QString> m_UserKeysInUse;
     SavableCodesMapType         m_UserKeysMap;
     mutable std::shared_mutex   m_UserKeysMtx;
 
-    // Authenticated clients management
-    AuthedClientsSetType      m_AuthedClientsSet;
-    mutable std::shared_mutex m_AuthedClientsMtx;
+    // Sessions of connected clients, only needed when walking all clients
+    SessionsMapType             m_Sessions;
+    std::unordered_set<QString> m_PausedIdents;
+    mutable std::shared_mutex   m_SessionsMtx;
 
     // Extensions management
-    DataExtensionMapType      m_Extensions;
-    mutable std::shared_mutex m_ExtensionsMtx;
+    //
+    // Extensions are never unloaded while the server runs, so pointers to them stay valid
+    // without holding the lock.
+    DataExtensionMapType        m_Extensions;
+    ExtensionLibMapType         m_ExtensionLibs;      // libraries of extensions not loaded yet, by extension code
+    std::unordered_set<QString> m_LoadingExtensions;  // extensions taken out of m_ExtensionLibs and being loaded, by extension code
+    std::unordered_set<QString> m_IsolatedExtensions; // extensions run in their own host process, by extension code
+    LoadWaitersMapType          m_LoadWaiters;        // callbacks parked until extensions finish loading, server thread only
+    mutable std::shared_mutex   m_ExtensionsMtx;
+    QThreadPool*                m_pLoadPool;
+
+    // Data Sources computed from other extensions' sources, served as a built-in extension
+    std::unique_ptr<DerivedSources> m_pDerived;
 };
@@ -3,6 +3,8 @@
 #include "dataserver.h"
 #include "widgetregistry.h"
 
+#include <QThread>
+
 /*
  * Another quasi singleton to prevent this class from being created more than once
  * without using the crappy singleton pattern
@@ -13,11 +15,29 @@ namespace
     DataServices* s_service = nullptr;
 }
 
-DataServices::DataServices(QObject* parent) : QObject(parent), server(new DataServer(this)), reg(new WidgetRegistry(server, this))
+DataServices::DataServices(QObject* parent) :
+    QObject(parent), server(new DataServer()), reg(new WidgetRegistry(server, this)), serverThread(new QThread(this))
 {
     if (nullptr != s_service)
     {
         throw std::runtime_error("Another instance already created");
     }
     s_service = this;
+
+    // The data server is created (and extensions loaded) synchronously so that widgets can be
+    // validated against it right away, then handed off to its own thread so that socket I/O and
+    // extension timers are not held up by the GUI
+    serverThread->setObjectName(QStringLiteral("Data Server"));
+    server->moveToThread(serverThread);
+    connect(serverThread, &QThread::finished, server, &QObject::deleteLater);
+    serverThread->start();
+}
+
+DataServices::~DataServices()
+{
+    // Server is deleted on its own thread once the event loop exits
+    serverThread->quit();
+    serverThread->wait();
+
+    s_service = nullptr;
 }
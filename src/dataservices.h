@@ -2,6 +2,7 @@
 
 #include <QObject>
 
+QT_FORWARD_DECLARE_CLASS(QThread)
 QT_FORWARD_DECLARE_CLASS(WidgetRegistry)
 QT_FORWARD_DECLARE_CLASS(DataServer)
 
@@ -11,6 +12,7 @@ class DataServices : public QObject
 
 public:
     explicit DataServices(QObject* parent = nullptr);
+    ~DataServices();
     DataServices(const DataServices&) = delete;
     DataServices(DataServices&&)      = delete;
     DataServices& operator=(const DataServices&) = delete;
@@ -25,4 +27,7 @@ private:
 
     // Widget registry
     WidgetRegistry* reg;
+
+    // Network thread running the data server and its extensions
+    QThread* serverThread;
 };
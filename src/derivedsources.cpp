@@ -0,0 +1,627 @@
+#include "derivedsources.h"
+
+#include "dataextension.h"
+#include "extension_support_internal.h"
+#include "widgetdefs.h"
+
+#include <QCborArray>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <shared_mutex>
+
+namespace
+{
+    // Identifier the built-in extension is subscribed to by
+    const char* const DERIVED_EXTENSION_NAME = "derived";
+
+    // get_data is only given a uid, so instances are found by the uids they were assigned in init
+    std::unordered_map<size_t, DerivedSources*> _instances;
+    std::shared_mutex                           _instancesMtx;
+
+    bool derivedInit(quasar_ext_handle handle)
+    {
+        DataExtension* extn = static_cast<DataExtension*>(handle);
+
+        return static_cast<DerivedSources*>(extn->getBuiltinContext())->init(extn);
+    }
+
+    bool derivedShutdown(quasar_ext_handle)
+    {
+        return true;
+    }
+
+    bool derivedGetData(size_t uid, quasar_data_handle hData)
+    {
+        DerivedSources* derived;
+
+        {
+            std::shared_lock<std::shared_mutex> lk(_instancesMtx);
+
+            auto it = _instances.find(uid);
+
+            if (it == _instances.end())
+            {
+                return false;
+            }
+
+            derived = it->second;
+        }
+
+        return derived->getData(uid, static_cast<QCborValue*>(hData));
+    }
+
+    // Appends the elements of a typed array, which are in host byte order
+    template <typename T>
+    void appendElements(const QByteArray& bytes, std::vector<double>& v)
+    {
+        const size_t count = bytes.size() / sizeof(T);
+
+        v.reserve(count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            T e;
+            memcpy(&e, bytes.constData() + i * sizeof(T), sizeof(T));
+            v.push_back(e);
+        }
+    }
+
+    // Results of polling the inputs of a derived source, filled on the server thread
+    struct PendingInputs
+    {
+        std::mutex                            mutex;
+        std::condition_variable               cv;
+        size_t                                remaining = 0; // number of extensions still being polled
+        std::unordered_map<QString, QCborMap> data;          // data by extension, then by source
+    };
+}
+
+DerivedSources::DerivedSources(ResolveFuncType resolve) : m_resolve(std::move(resolve)) {}
+
+DerivedSources::~DerivedSources()
+{
+    std::unique_lock<std::shared_mutex> lk(_instancesMtx);
+
+    for (const auto& it : m_sourcesbyuid)
+    {
+        _instances.erase(it.first);
+    }
+}
+
+bool DerivedSources::load(const QString& path)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QJsonParseError err;
+    QJsonDocument   doc = QJsonDocument::fromJson(file.readAll(), &err);
+
+    if (doc.isNull())
+    {
+        qWarning() << "Failed to parse derived Data Sources in" << path << ":" << err.errorString();
+        return false;
+    }
+
+    QJsonObject defs = doc.object().value("sources").toObject();
+
+    for (auto it = defs.begin(); it != defs.end(); ++it)
+    {
+        QJsonObject def = it.value().toObject();
+        auto        src = std::make_unique<Source>();
+
+        if (!parseSource(it.key(), def, *src))
+        {
+            continue;
+        }
+
+        quasar_data_source_t ds{};
+        qstrncpy(ds.name, it.key().toUtf8().constData(), sizeof(ds.name));
+        ds.rate = std::max(1, def.value("rate").toInt(QUASAR_DERIVED_DEFAULT_RATE));
+
+        m_datasources.push_back(ds);
+        m_sources.push_back(std::move(src));
+    }
+
+    if (m_sources.empty())
+    {
+        return false;
+    }
+
+    qstrncpy(m_fields.name, DERIVED_EXTENSION_NAME, sizeof(m_fields.name));
+    qstrncpy(m_fields.fullname, "Derived Data Sources", sizeof(m_fields.fullname));
+    qstrncpy(m_fields.version, "1.0", sizeof(m_fields.version));
+    qstrncpy(m_fields.author, "Quasar", sizeof(m_fields.author));
+    qstrncpy(m_fields.description, "Data Sources computed by Quasar from the Data Sources of other extensions", sizeof(m_fields.description));
+
+    m_info.api_version    = QUASAR_API_VERSION;
+    m_info.fields         = &m_fields;
+    m_info.numDataSources = m_datasources.size();
+    m_info.dataSources    = m_datasources.data();
+    m_info.init           = derivedInit;
+    m_info.shutdown       = derivedShutdown;
+    m_info.get_data       = derivedGetData;
+
+    qInfo() << "Found" << m_sources.size() << "derived Data Sources in" << path;
+
+    return true;
+}
+
+bool DerivedSources::parseSource(const QString& name, const QJsonObject& def, Source& src)
+{
+    if (name.isEmpty() || name.toUtf8().size() >= static_cast<int>(sizeof(quasar_data_source_t::name)))
+    {
+        qWarning() << "Invalid derived Data Source name" << name;
+        return false;
+    }
+
+    src.name = name;
+
+    QJsonValue  input = def.value("input");
+    QStringList specs;
+
+    if (input.isArray())
+    {
+        for (const QJsonValue& v : input.toArray())
+        {
+            specs << v.toString();
+        }
+    }
+    else
+    {
+        specs << input.toString();
+    }
+
+    for (const QString& spec : specs)
+    {
+        QStringList parts = spec.split('/', QString::SkipEmptyParts);
+
+        // Derived sources polling each other could run out of workers waiting on one another
+        if (parts.size() < 2 || parts[0] == DERIVED_EXTENSION_NAME)
+        {
+            qWarning() << "Invalid input" << spec << "of derived Data Source" << name;
+            return false;
+        }
+
+        Input in{spec, parts[0], parts[1], parts.mid(2), {}};
+
+        for (const QString& key : in.path)
+        {
+            bool   ok;
+            qint64 index = key.toLongLong(&ok);
+
+            if (ok && index < 0)
+            {
+                qWarning() << "Invalid index" << key << "in input" << spec << "of derived Data Source" << name;
+                return false;
+            }
+
+            in.indexes.push_back(ok ? index : -1);
+        }
+
+        src.inputs.push_back(std::move(in));
+    }
+
+    // Inputs from the same extension are polled together
+    for (const Input& in : src.inputs)
+    {
+        auto it = std::find_if(src.polls.begin(), src.polls.end(), [&in](const auto& p) { return p.first == in.extcode; });
+
+        if (it == src.polls.end())
+        {
+            src.polls.emplace_back(in.extcode, in.source);
+        }
+        else if (!it->second.split(',').contains(in.source))
+        {
+            it->second += "," + in.source;
+        }
+    }
+
+    static const std::unordered_map<QString, Operator::Kind> kinds{{"map", Operator::MAP},
+                                                                   {"ema", Operator::EMA},
+                                                                   {"min", Operator::MIN},
+                                                                   {"max", Operator::MAX},
+                                                                   {"ratio", Operator::RATIO},
+                                                                   {"clamp", Operator::CLAMP}};
+
+    size_t count = src.inputs.size();
+
+    for (const QJsonValue& v : def.value("ops").toArray())
+    {
+        QJsonObject o   = v.toObject();
+        QString     kop = o.value("op").toString();
+        auto        kit = kinds.find(kop);
+
+        if (kit == kinds.end())
+        {
+            qWarning() << "Unknown operator" << kop << "in derived Data Source" << name;
+            return false;
+        }
+
+        Operator op;
+        op.kind = kit->second;
+
+        switch (op.kind)
+        {
+            case Operator::MAP:
+                op.a = o.value("scale").toDouble(1);
+                op.b = o.value("offset").toDouble(0);
+                break;
+
+            case Operator::EMA:
+                op.a = o.value("alpha").toDouble(0.5);
+
+                if (op.a <= 0 || op.a > 1)
+                {
+                    qWarning() << "Smoothing factor of derived Data Source" << name << "must be in (0, 1]";
+                    return false;
+                }
+                break;
+
+            case Operator::MIN:
+            case Operator::MAX:
+                op.window = std::max(1, o.value("window").toInt(1));
+                break;
+
+            case Operator::RATIO:
+                break;
+
+            case Operator::CLAMP:
+                op.a = o.value("min").toDouble(-std::numeric_limits<double>::infinity());
+                op.b = o.value("max").toDouble(std::numeric_limits<double>::infinity());
+                break;
+        }
+
+        // Ratio combines two values into one, every other operator works on a single value
+        size_t needed = (op.kind == Operator::RATIO) ? 2 : 1;
+
+        if (count != needed)
+        {
+            qWarning() << "Operator" << kop << "of derived Data Source" << name << "takes" << needed << "values, got" << count;
+            return false;
+        }
+
+        count = 1;
+        src.ops.push_back(std::move(op));
+    }
+
+    if (count != 1)
+    {
+        qWarning() << "Derived Data Source" << name << "needs a single value out of its operators, got" << count;
+        return false;
+    }
+
+    return true;
+}
+
+bool DerivedSources::init(DataExtension* extension)
+{
+    m_extension = extension;
+
+    // uids were assigned by the extension in the order of m_datasources
+    for (size_t i = 0; i < m_sources.size(); i++)
+    {
+        m_sourcesbyuid[m_datasources[i].uid] = m_sources[i].get();
+    }
+
+    std::unique_lock<std::shared_mutex> lk(_instancesMtx);
+
+    for (const auto& it : m_sourcesbyuid)
+    {
+        _instances[it.first] = this;
+    }
+
+    return true;
+}
+
+bool DerivedSources::getData(size_t uid, QCborValue* dat)
+{
+    auto it = m_sourcesbyuid.find(uid);
+
+    if (it == m_sourcesbyuid.end())
+    {
+        return false;
+    }
+
+    Source& src = *it->second;
+
+    std::lock_guard<std::mutex> lk(src.mutex);
+
+    // Whatever the rate set for the source, ema, min and max advance once per tick of its timer.
+    // Other calls, such as queries or new subscribers, run the operators on a copy of their state
+    const uint64_t tick    = m_extension->getTickCount(uid);
+    const bool     advance = tick != src.tick;
+
+    std::unordered_map<QString, QCborMap> data;
+
+    if (!fetchInputs(src, data))
+    {
+        qWarning() << "Timed out polling the inputs of derived Data Source" << src.name;
+        return false;
+    }
+
+    std::vector<Value> values(src.inputs.size());
+
+    for (size_t i = 0; i < src.inputs.size(); i++)
+    {
+        const Input& in  = src.inputs[i];
+        QCborValue   val = data[in.extcode].value(in.source);
+
+        // Keys and indexes that do not match the value leave it undefined, which fails below
+        for (int k = 0; k < in.path.size(); k++)
+        {
+            if (val.isArray())
+            {
+                val = (in.indexes[k] >= 0) ? val.toArray().at(in.indexes[k]) : QCborValue();
+            }
+            else
+            {
+                val = val.toMap().value(in.path[k]);
+            }
+        }
+
+        if (!decodeValue(val, values[i]))
+        {
+            qWarning() << "Input" << in.spec << "of derived Data Source" << src.name << "is not a number or an array of numbers";
+            return false;
+        }
+    }
+
+    for (Operator& op : src.ops)
+    {
+        if (advance)
+        {
+            applyOperator(op, values);
+        }
+        else
+        {
+            Operator scratch = op;
+            applyOperator(scratch, values);
+        }
+    }
+
+    if (advance)
+    {
+        src.tick = tick;
+    }
+
+    *dat = encodeValue(values.front());
+
+    return true;
+}
+
+bool DerivedSources::fetchInputs(const Source& src, std::unordered_map<QString, QCborMap>& data)
+{
+    auto pending       = std::make_shared<PendingInputs>();
+    pending->remaining = src.polls.size();
+
+    // Extensions are only ever polled and loaded on the server thread, while get_data runs on a worker
+    QMetaObject::invokeMethod(
+        m_extension,
+        [this, pending, polls = src.polls, widgetName = QString(DERIVED_EXTENSION_NAME) + "/" + src.name] {
+            for (const auto& [extcode, sources] : polls)
+            {
+                auto finish = [pending, extcode = extcode](const QCborMap& dat, const QCborArray&) {
+                    std::lock_guard<std::mutex> lk(pending->mutex);
+                    pending->data[extcode] = dat;
+
+                    if (--pending->remaining == 0)
+                    {
+                        pending->cv.notify_one();
+                    }
+                };
+
+                m_resolve(extcode, [extcode = extcode, sources = sources, widgetName, finish](DataExtension* extn) {
+                    if (!extn)
+                    {
+                        qWarning() << "Unknown extension" << extcode << "requested by derived Data Source" << widgetName;
+                        finish(QCborMap(), QCborArray());
+                        return;
+                    }
+
+                    extn->pollData(sources, nullptr, widgetName, DATA_ENCODING_CBOR, finish);
+                });
+            }
+        },
+        Qt::QueuedConnection);
+
+    std::unique_lock<std::mutex> lk(pending->mutex);
+
+    if (!pending->cv.wait_for(lk, std::chrono::milliseconds(QUASAR_DERIVED_INPUT_TIMEOUT), [&pending] { return pending->remaining == 0; }))
+    {
+        return false;
+    }
+
+    data = std::move(pending->data);
+
+    return true;
+}
+
+bool DerivedSources::decodeValue(const QCborValue& val, Value& out)
+{
+    out.v.clear();
+
+    if (val.isInteger() || val.isDouble())
+    {
+        out.shape = Value::SCALAR;
+        out.v.push_back(val.toDouble());
+        return true;
+    }
+
+    if (val.isArray())
+    {
+        out.shape = Value::ARRAY;
+
+        for (const QCborValue& e : val.toArray())
+        {
+            if (!e.isInteger() && !e.isDouble())
+            {
+                return false;
+            }
+
+            out.v.push_back(e.toDouble());
+        }
+
+        return true;
+    }
+
+    if (val.isTag())
+    {
+        QByteArray bytes = val.taggedValue().toByteArray();
+
+        out.shape = Value::TYPED_ARRAY;
+        out.tag   = static_cast<quint64>(val.tag());
+
+        switch (out.tag)
+        {
+            case QUASAR_TYPED_ARRAY_INT32:
+                appendElements<qint32>(bytes, out.v);
+                return true;
+            case QUASAR_TYPED_ARRAY_FLOAT32:
+                appendElements<float>(bytes, out.v);
+                return true;
+            case QUASAR_TYPED_ARRAY_FLOAT64:
+                appendElements<double>(bytes, out.v);
+                return true;
+        }
+    }
+
+    return false;
+}
+
+QCborValue DerivedSources::encodeValue(const Value& val)
+{
+    switch (val.shape)
+    {
+        case Value::SCALAR:
+            return val.v.empty() ? QCborValue() : QCborValue(val.v.front());
+
+        case Value::ARRAY:
+        {
+            QCborArray arr;
+
+            for (double d : val.v)
+            {
+                arr.append(d);
+            }
+
+            return arr;
+        }
+
+        case Value::TYPED_ARRAY:
+        {
+            if (val.tag == QUASAR_TYPED_ARRAY_FLOAT32)
+            {
+                std::vector<float> f(val.v.begin(), val.v.end());
+                return QCborValue(QCborTag(QUASAR_TYPED_ARRAY_FLOAT32), QByteArray(reinterpret_cast<const char*>(f.data()), static_cast<int>(f.size() * sizeof(float))));
+            }
+
+            // Results are fractional, so integer arrays come out as doubles
+            return QCborValue(QCborTag(QUASAR_TYPED_ARRAY_FLOAT64),
+                              QByteArray(reinterpret_cast<const char*>(val.v.data()), static_cast<int>(val.v.size() * sizeof(double))));
+        }
+    }
+
+    return QCborValue();
+}
+
+void DerivedSources::applyOperator(Operator& op, std::vector<Value>& values)
+{
+    Value&               val = values.front();
+    std::vector<double>& v   = val.v;
+
+    switch (op.kind)
+    {
+        case Operator::MAP:
+            for (double& x : v)
+            {
+                x = x * op.a + op.b;
+            }
+            break;
+
+        case Operator::EMA:
+            // Starts over whenever the number of elements changes
+            if (op.average.size() != v.size())
+            {
+                op.average = v;
+            }
+            else
+            {
+                for (size_t i = 0; i < v.size(); i++)
+                {
+                    op.average[i] += op.a * (v[i] - op.average[i]);
+                }
+            }
+
+            v = op.average;
+            break;
+
+        case Operator::MIN:
+        case Operator::MAX:
+            if (!op.history.empty() && op.history.front().size() != v.size())
+            {
+                op.history.clear();
+            }
+
+            op.history.push_back(v);
+
+            if (op.history.size() > op.window)
+            {
+                op.history.pop_front();
+            }
+
+            for (const auto& h : op.history)
+            {
+                for (size_t i = 0; i < v.size(); i++)
+                {
+                    v[i] = (op.kind == Operator::MIN) ? std::min(v[i], h[i]) : std::max(v[i], h[i]);
+                }
+            }
+            break;
+
+        case Operator::RATIO:
+        {
+            const Value& den = values[1];
+
+            // A scalar divides, or is divided by, every element of an array
+            size_t n = (val.shape == Value::SCALAR) ? den.v.size() : (den.shape == Value::SCALAR) ? v.size() : std::min(v.size(), den.v.size());
+
+            std::vector<double> r(n);
+
+            for (size_t i = 0; i < n; i++)
+            {
+                double x = v[(val.shape == Value::SCALAR) ? 0 : i];
+                double d = den.v[(den.shape == Value::SCALAR) ? 0 : i];
+                r[i]     = (d != 0) ? x / d : 0;
+            }
+
+            if (val.shape == Value::SCALAR)
+            {
+                val.shape = den.shape;
+                val.tag   = den.tag;
+            }
+
+            v = std::move(r);
+            values.pop_back();
+            break;
+        }
+
+        case Operator::CLAMP:
+            for (double& x : v)
+            {
+                x = qBound(op.a, x, op.b);
+            }
+            break;
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <extension_api.h>
+#include <qstring_hash_impl.h>
+
+#include <QCborMap>
+#include <QCborValue>
+#include <QString>
+#include <QStringList>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+QT_FORWARD_DECLARE_CLASS(QJsonObject)
+
+class DataExtension;
+
+// Data Sources computed by the server from the Data Sources of other extensions
+//
+// Declared in QUASAR_DERIVED_SOURCES_FILE and served as a built-in extension, so that they
+// are subscribed to, queried, rate limited and enabled like the Data Sources of any other
+// extension. Derived sources are timer based: each value polls the inputs from their
+// extensions and runs them through the source's operators, once for all of its subscribers.
+// Operator state only advances on timer ticks, queries get a value without changing it.
+class DerivedSources
+{
+    using ExtensionSourcesList = std::vector<std::pair<QString, QString>>;
+
+    // A value flowing through the operators of a derived source, as a list of numbers
+    struct Value
+    {
+        enum Shape
+        {
+            SCALAR,
+            ARRAY,
+            TYPED_ARRAY
+        };
+
+        Shape               shape = SCALAR;
+        quint64             tag   = 0; // tag of the input typed array
+        std::vector<double> v;
+    };
+
+    struct Operator
+    {
+        enum Kind
+        {
+            MAP,
+            EMA,
+            MIN,
+            MAX,
+            RATIO,
+            CLAMP
+        };
+
+        Kind   kind;
+        double a      = 0; // scale, smoothing factor or lower bound
+        double b      = 0; // offset or upper bound
+        size_t window = 1; // number of values looked at by min and max
+
+        std::vector<double>             average; // ema state
+        std::deque<std::vector<double>> history; // min/max state
+    };
+
+    // An input, given as "extension/source" optionally followed by keys or indexes into the source's value
+    struct Input
+    {
+        QString             spec;
+        QString             extcode;
+        QString             source;
+        QStringList         path;
+        std::vector<qint64> indexes; // path as array indexes, -1 for segments that can only be keys
+    };
+
+    struct Source
+    {
+        QString               name;
+        std::vector<Input>    inputs;
+        std::vector<Operator> ops;
+        ExtensionSourcesList  polls;    // inputs grouped by extension, as comma separated sources
+        uint64_t              tick = 0; // timer tick the operator state last advanced on
+        std::mutex            mutex;    // serializes evaluations and guards the fields above
+    };
+
+    using SourceMapType = std::unordered_map<size_t, Source*>;
+
+public:
+    using ResolvedFuncType = std::function<void(DataExtension*)>;
+    using ResolveFuncType  = std::function<void(const QString&, ResolvedFuncType)>;
+
+    // resolve hands the extension with the given code to its callback, nullptr if there is none.
+    // It is only called on the server thread and calls back later if the extension has to be loaded first
+    explicit DerivedSources(ResolveFuncType resolve);
+    ~DerivedSources();
+
+    // Reads the derived source definitions, returns false if there are none
+    bool load(const QString& path);
+
+    // Description of the built-in extension serving the derived sources
+    quasar_ext_info_t* info() { return &m_info; }
+
+    // Implementations of the built-in extension's init() and get_data()
+    bool init(DataExtension* extension);
+    bool getData(size_t uid, QCborValue* dat);
+
+private:
+    bool parseSource(const QString& name, const QJsonObject& def, Source& src);
+    bool fetchInputs(const Source& src, std::unordered_map<QString, QCborMap>& data);
+
+    static bool       decodeValue(const QCborValue& val, Value& out);
+    static QCborValue encodeValue(const Value& val);
+    static void       applyOperator(Operator& op, std::vector<Value>& values);
+
+    ResolveFuncType m_resolve;
+    DataExtension*  m_extension = nullptr; // built-in extension serving the derived sources
+
+    quasar_ext_info_t                    m_info{};
+    quasar_ext_info_fields_t             m_fields{};
+    std::vector<quasar_data_source_t>    m_datasources;
+    std::vector<std::unique_ptr<Source>> m_sources;
+    SourceMapType                        m_sourcesbyuid;
+};
@@ -85,7 +85,8 @@ void msg_handler(QtMsgType type, const QMessageLogContext& context, const QStrin
 
         if (s_logEdit)
         {
-            s_logEdit->append(output);
+            // Messages may be logged from the data server thread, so always append on the GUI thread
+            QMetaObject::invokeMethod(s_logEdit, "append", Qt::AutoConnection, Q_ARG(QString, output));
         }
 
         if (logFile && !s_logFile)
@@ -16,6 +16,7 @@ WebUiDialog::WebUiDialog(DataServer* server, QString title, QUrl url, ClientAcce
     setWindowModality(Qt::WindowModal);
 
     QuasarWebPage* page = new QuasarWebPage(this);
+    page->enableDataChannel(server);
     page->load(url);
 
     QWebEngineView* view = new QWebEngineView(this);
@@ -28,14 +29,8 @@ WebUiDialog::WebUiDialog(DataServer* server, QString title, QUrl url, ClientAcce
 
     connect(page, &QWebEnginePage::windowCloseRequested, [=] { this->close(); });
 
-    QString authcode = server->generateAuthCode(url.toString(), lvl);
-
-    QString gscript = WebWidget::getGlobalScript();
-
-    QSettings settings;
-    quint16   port = settings.value(QUASAR_CONFIG_PORT, QUASAR_DATA_SERVER_DEFAULT_PORT).toUInt();
-
-    QString pageGlobals = gscript.arg(port).arg(authcode);
+    QString authcode    = server->generateAuthCode(url.toString(), lvl);
+    QString pageGlobals = WebWidget::getPageGlobals(authcode);
 
     QWebEngineScript script;
     script.setName("PageGlobals");
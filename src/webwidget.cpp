@@ -1,16 +1,21 @@
 #include "webwidget.h"
 
+#include "dataclients.h"
 #include "dataserver.h"
 #include "widgetdefs.h"
 
 #include <QAction>
 #include <QMenu>
 #include <QMessageBox>
+#include <QTimer>
+#include <QWindow>
+#include <QtWebChannel/QWebChannel>
 #include <QtWebEngineWidgets/QWebEngineCertificateError>
 #include <QtWebEngineWidgets/QWebEngineScriptCollection>
 #include <QtWebEngineWidgets/QWebEngineSettings>
 
 QString WebWidget::PageGlobalScript;
+QString WebWidget::WebChannelScript;
 
 void QuasarWebPage::javaScriptConsoleMessage(JavaScriptConsoleMessageLevel level, const QString& message, int lineNumber, const QString& sourceID)
 {
@@ -47,6 +52,18 @@ bool QuasarWebPage::certificateError(const QWebEngineCertificateError& certifica
     return false;
 }
 
+void QuasarWebPage::enableDataChannel(DataServer* server)
+{
+    QWebChannel*         channel   = new QWebChannel(this);
+    WebChannelTransport* transport = new WebChannelTransport(server, this);
+
+    channel->registerObject(QStringLiteral("quasar"), transport);
+    setWebChannel(channel, QWebEngineScript::MainWorld);
+
+    // A client never outlives the document that opened it
+    connect(this, &QWebEnginePage::loadStarted, transport, &WebChannelTransport::close);
+}
+
 WebWidget::WebWidget(QString widgetName, const QJsonObject& dat, DataServer* serv, QWidget* parent) : QWidget(parent), m_Name(widgetName), server(serv)
 {
     if (m_Name.isEmpty())
@@ -83,6 +100,12 @@ WebWidget::WebWidget(QString widgetName, const QJsonObject& dat, DataServer* ser
     }
 
     QuasarWebPage* page = new QuasarWebPage(this);
+
+    if (data[WGT_DEF_DATASERVER].toBool())
+    {
+        page->enableDataChannel(server);
+    }
+
     page->load(startFile);
     webview->setPage(page);
 
@@ -152,6 +175,12 @@ WebWidget::WebWidget(QString widgetName, const QJsonObject& dat, DataServer* ser
     createContextMenuActions();
     createContextMenu();
 
+    // Widgets are paused once they have been out of sight for a moment, so that brief changes do not churn subscriptions
+    m_pauseTimer = new QTimer(this);
+    m_pauseTimer->setSingleShot(true);
+    m_pauseTimer->setInterval(QUASAR_WIDGET_PAUSE_DELAY);
+    connect(m_pauseTimer, &QTimer::timeout, [this] { setPaused(true); });
+
     // Restore settings
     QSettings settings;
     restoreGeometry(settings.value(getSettingKey("geometry")).toByteArray());
@@ -188,12 +217,8 @@ WebWidget::WebWidget(QString widgetName, const QJsonObject& dat, DataServer* ser
     // Inject global script
     if (data[WGT_DEF_DATASERVER].toBool())
     {
-        QString authcode = server->generateAuthCode(m_Name);
-
-        QString gscript = getGlobalScript();
-        quint16 port    = settings.value(QUASAR_CONFIG_PORT, QUASAR_DATA_SERVER_DEFAULT_PORT).toUInt();
-
-        QString pageGlobals = gscript.arg(port).arg(authcode);
+        QString authcode    = server->generateAuthCode(m_Name);
+        QString pageGlobals = getPageGlobals(authcode);
 
         script.setName("PageGlobals");
         script.setInjectionPoint(QWebEngineScript::DocumentCreation);
@@ -329,6 +354,35 @@ QString WebWidget::getGlobalScript()
     return PageGlobalScript;
 }
 
+QString WebWidget::getWebChannelScript()
+{
+    if (WebChannelScript.isEmpty())
+    {
+        // Provided by the QtWebChannel module
+        QFile file(":/qtwebchannel/qwebchannel.js");
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            qWarning() << "qwebchannel.js load failure, widgets will connect through the WebSocket server";
+            return QString();
+        }
+
+        QTextStream in(&file);
+        WebChannelScript = in.readAll();
+    }
+
+    return WebChannelScript;
+}
+
+QString WebWidget::getPageGlobals(QString authcode)
+{
+    QSettings settings;
+    quint16   port   = settings.value(QUASAR_CONFIG_PORT, QUASAR_DATA_SERVER_DEFAULT_PORT).toUInt();
+    bool      secure = settings.value(QUASAR_CONFIG_SECURE, true).toBool();
+
+    // Appended after arg() so that the channel script is never scanned for placeholders
+    return getGlobalScript().arg(port).arg(authcode).arg(secure ? "wss" : "ws") + "\n" + getWebChannelScript();
+}
+
 QString WebWidget::getFullPath()
 {
     return data[WGT_DEF_FULLPATH].toString();
@@ -362,13 +416,8 @@ void WebWidget::createContextMenuActions()
             webview->page()->scripts().remove(script);
 
             // Insert refreshed script
-            QString authcode = server->generateAuthCode(m_Name);
-            QString gscript  = getGlobalScript();
-
-            QSettings settings;
-            quint16   port = settings.value(QUASAR_CONFIG_PORT, QUASAR_DATA_SERVER_DEFAULT_PORT).toUInt();
-
-            QString pageGlobals = gscript.arg(port).arg(authcode);
+            QString authcode    = server->generateAuthCode(m_Name);
+            QString pageGlobals = getPageGlobals(authcode);
             script.setSourceCode(pageGlobals);
 
             webview->page()->scripts().insert(script);
@@ -437,6 +486,124 @@ void WebWidget::mouseMoveEvent(QMouseEvent* evt)
     }
 }
 
+void WebWidget::showEvent(QShowEvent* evt)
+{
+    QWidget::showEvent(evt);
+
+    // The native window may have been recreated, e.g. by a window flags change
+    if (windowHandle())
+    {
+        windowHandle()->removeEventFilter(this);
+        windowHandle()->installEventFilter(this);
+    }
+
+    updateVisibility();
+}
+
+void WebWidget::hideEvent(QHideEvent* evt)
+{
+    QWidget::hideEvent(evt);
+    updateVisibility();
+}
+
+void WebWidget::changeEvent(QEvent* evt)
+{
+    QWidget::changeEvent(evt);
+
+    if (evt->type() == QEvent::WindowStateChange)
+    {
+        updateVisibility();
+    }
+}
+
+void WebWidget::moveEvent(QMoveEvent* evt)
+{
+    QWidget::moveEvent(evt);
+    updateVisibility();
+}
+
+bool WebWidget::eventFilter(QObject* obj, QEvent* evt)
+{
+    // Exposure changes when the window is covered or uncovered, where the platform reports it
+    if (obj == windowHandle() && evt->type() == QEvent::Expose)
+    {
+        updateVisibility();
+    }
+
+    return QWidget::eventFilter(obj, evt);
+}
+
+bool WebWidget::isOnScreen()
+{
+    const QRect geom = frameGeometry();
+
+    for (QScreen* screen : QGuiApplication::screens())
+    {
+        if (screen->geometry().intersects(geom))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WebWidget::updateVisibility()
+{
+    bool visible = isVisible() && !isMinimized() && isOnScreen() && (!windowHandle() || windowHandle()->isExposed());
+
+    if (visible)
+    {
+        // Resume right away
+        m_pauseTimer->stop();
+        setPaused(false);
+    }
+    else if (!m_paused && !m_pauseTimer->isActive())
+    {
+        m_pauseTimer->start();
+    }
+}
+
+void WebWidget::setPaused(bool paused)
+{
+    if (m_paused == paused)
+    {
+        return;
+    }
+
+    m_paused = paused;
+
+    QWebEnginePage* page = webview->page();
+
+    if (paused)
+    {
+        // Stop data first, so that nothing is queued for a page that cannot run
+        if (data[WGT_DEF_DATASERVER].toBool())
+        {
+            server->setWidgetPaused(m_Name, true);
+        }
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        // Only pages that are not visible can be frozen
+        page->setVisible(false);
+        page->setLifecycleState(QWebEnginePage::LifecycleState::Frozen);
+#endif
+    }
+    else
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        // Thaw the page first, so that it is running when the fresh values arrive
+        page->setLifecycleState(QWebEnginePage::LifecycleState::Active);
+        page->setVisible(true);
+#endif
+
+        if (data[WGT_DEF_DATASERVER].toBool())
+        {
+            server->setWidgetPaused(m_Name, false);
+        }
+    }
+}
+
 void WebWidget::toggleOnTop(bool ontop)
 {
     auto flags = windowFlags();
@@ -7,6 +7,7 @@
 #include <QtWebEngineWidgets/QWebEngineView>
 
 QT_FORWARD_DECLARE_CLASS(QMenu);
+QT_FORWARD_DECLARE_CLASS(QTimer);
 QT_FORWARD_DECLARE_CLASS(DataServer);
 
 // From https://stackoverflow.com/questions/19362455/dark-transparent-layer-over-a-qmainwindow-in-qt
@@ -79,6 +80,9 @@ public:
 
     QuasarWebPage(QWebEngineProfile* profile, QObject* parent = nullptr) : QWebEnginePage{profile, parent} {}
 
+    // Exposes the Data Server to the page through an in-process QWebChannel transport
+    void enableDataChannel(DataServer* server);
+
 protected:
     virtual void javaScriptConsoleMessage(JavaScriptConsoleMessageLevel level, const QString& message, int lineNumber, const QString& sourceID);
     bool         certificateError(const QWebEngineCertificateError& certificateError);
@@ -96,6 +100,8 @@ public:
     static bool    validateWidgetDefinition(const QJsonObject& dat);
     static bool    acceptSecurityWarnings(const QJsonObject& dat);
     static QString getGlobalScript();
+    static QString getWebChannelScript();
+    static QString getPageGlobals(QString authcode);
 
     QJsonObject getData() { return data; }
     QString     getName() { return m_Name; }
@@ -115,6 +121,11 @@ protected:
     // Overrides
     virtual void mousePressEvent(QMouseEvent* evt) override;
     virtual void mouseMoveEvent(QMouseEvent* evt) override;
+    virtual void showEvent(QShowEvent* evt) override;
+    virtual void hideEvent(QHideEvent* evt) override;
+    virtual void changeEvent(QEvent* evt) override;
+    virtual void moveEvent(QMoveEvent* evt) override;
+    virtual bool eventFilter(QObject* obj, QEvent* evt) override;
 
 protected slots:
     void toggleOnTop(bool ontop);
@@ -124,10 +135,20 @@ private:
 
     QString getSettingKey(QString key);
 
+    // Visibility tracking
+    bool isOnScreen();
+    void updateVisibility();
+    void setPaused(bool paused);
+
     static QString PageGlobalScript;
+    static QString WebChannelScript;
 
     bool m_fixedposition = false;
 
+    // Whether data delivery and the page are paused while the widget cannot be seen
+    bool    m_paused = false;
+    QTimer* m_pauseTimer;
+
     QString m_Name;
 
     // Dataserver
@@ -12,10 +12,11 @@
 #define WGT_DEF_OPTIONAL "optional"
 #define WGT_DEF_DATASERVER "dataserver"
 
-#define WGT_PROP_IDENTITY "qsr_identity"
-#define WGT_PROP_USERKEY "qsr_userkey"
-
 #define QUASAR_CONFIG_PORT "global/dataport"
+#define QUASAR_CONFIG_SECURE "global/datasecure"
+#define QUASAR_CONFIG_LOCALSOCKET "global/datalocal"
+#define QUASAR_CONFIG_OUTPOLICY "global/outpolicy"
+#define QUASAR_CONFIG_OUTLIMIT "global/outlimit"
 #define QUASAR_CONFIG_LOADED "global/loaded"
 #define QUASAR_CONFIG_LOGLEVEL "global/loglevel"
 #define QUASAR_CONFIG_LOGFILE "global/logfile"
@@ -24,7 +25,16 @@
 #define QUASAR_CONFIG_LASTPATH "global/lastpath"
 #define QUASAR_CONFIG_LAUNCHERMAP "launcher/map"
 #define QUASAR_CONFIG_USERKEYSMAP "userkeys/map"
+#define QUASAR_CONFIG_EXTCACHE "extensions/cache"
+#define QUASAR_CONFIG_EXTISOLATED "extensions/isolated"
 
 #define QUASAR_CONFIG_DEFAULT_LOGLEVEL QUASAR_LOG_WARNING
 
 #define QUASAR_DATA_SERVER_DEFAULT_PORT 13337
+#define QUASAR_DATA_SERVER_LOCAL_NAME "quasar-dataserver"
+#define QUASAR_WIDGET_PAUSE_DELAY 1000
+#define QUASAR_AUTH_TIMEOUT 10000
+
+#define QUASAR_DERIVED_SOURCES_FILE "extensions/derived.json"
+#define QUASAR_DERIVED_DEFAULT_RATE 1000
+#define QUASAR_DERIVED_INPUT_TIMEOUT 2000
@@ -194,6 +194,9 @@ void WidgetRegistry::closeWebWidget(WebWidget* widget)
 
     qInfo() << "Closing widget " << name << " (" << widget->getFullPath() << ")";
 
+    // A widget loaded again under the same name must not start out paused
+    server->setWidgetPaused(name, false);
+
     std::unique_lock<std::shared_mutex> lk(m_mutex);
 
     // Remove from registry
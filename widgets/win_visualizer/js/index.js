@@ -46,7 +46,7 @@ function bounce(dat) {
 }
 
 function parseMsg(msg) {
-    var data = JSON.parse(msg);
+    var data = quasar_decode(msg);
 
     if ("data" in data && "win_audio_viz" in data["data"] && "band" in data["data"]["win_audio_viz"]) {
         bounce(data["data"]["win_audio_viz"]["band"]);
@@ -65,7 +65,7 @@ $(document).ready(function () {
             websocket.close();
         websocket = quasar_create_websocket();;
         websocket.onopen = function (evt) {
-            quasar_authenticate(websocket);
+            quasar_authenticate(websocket, "cbor");
             subscribe();
         };
         websocket.onmessage = function (evt) {